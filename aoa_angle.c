@@ -37,79 +37,89 @@
 #include "app_log.h"
 #include "aoa_angle.h"
 #include "aoa_angle_config.h"
+#include "aoa_iq.h"
 
 #define CHECK_ERROR(x)           if ((x) != SL_RTL_ERROR_SUCCESS) return (x)
+#define REJECT(reason)           __atomic_add_fetch(&reject_stats.reason, 1, __ATOMIC_RELAXED)
 
 // -----------------------------------------------------------------------------
 // Public variables
 
 float aoa_azimuth_min = AOA_AZIMUTH_MASK_MIN_DEFAULT;
 float aoa_azimuth_max = AOA_AZIMUTH_MASK_MAX_DEFAULT;
+enum sl_rtl_aox_mode aoa_mode = AOX_MODE;
+
+// -----------------------------------------------------------------------------
+// Private types
+
+// Copies the samples of a report into the sample buffers of the thread and
+// returns the number of samples clipped at full scale.
+typedef uint32_t (*get_samples_t)(aoa_iq_report_t *iq_report);
 
 // -----------------------------------------------------------------------------
 // Private variables
 
-static float **ref_i_samples;
-static float **ref_q_samples;
-static float **i_samples;
-static float **q_samples;
+// Sample buffers, every thread estimating angles has its own.
+static _Thread_local aoa_iq_buffer_t ref_i_samples;
+static _Thread_local aoa_iq_buffer_t ref_q_samples;
+static _Thread_local aoa_iq_buffer_t i_samples;
+static _Thread_local aoa_iq_buffer_t q_samples;
+// Sample unpacking for the antenna array, chosen with the buffers.
+static _Thread_local get_samples_t get_samples;
+
+// Reports rejected by the sample check, counted by all threads.
+static aoa_reject_stats_t reject_stats;
+
+// Names of the estimator modes, as in the locator config.
+static const struct {
+  const char *name;
+  enum sl_rtl_aox_mode mode;
+} mode_names[] = {
+  { "ONE_SHOT_BASIC", SL_RTL_AOX_MODE_ONE_SHOT_BASIC },
+  { "ONE_SHOT_BASIC_LIGHTWEIGHT", SL_RTL_AOX_MODE_ONE_SHOT_BASIC_LIGHTWEIGHT },
+  { "ONE_SHOT_FAST_RESPONSE", SL_RTL_AOX_MODE_ONE_SHOT_FAST_RESPONSE },
+  { "ONE_SHOT_HIGH_ACCURACY", SL_RTL_AOX_MODE_ONE_SHOT_HIGH_ACCURACY },
+  { "ONE_SHOT_BASIC_AZIMUTH_ONLY", SL_RTL_AOX_MODE_ONE_SHOT_BASIC_AZIMUTH_ONLY },
+  { "ONE_SHOT_FAST_RESPONSE_AZIMUTH_ONLY", SL_RTL_AOX_MODE_ONE_SHOT_FAST_RESPONSE_AZIMUTH_ONLY },
+  { "ONE_SHOT_HIGH_ACCURACY_AZIMUTH_ONLY", SL_RTL_AOX_MODE_ONE_SHOT_HIGH_ACCURACY_AZIMUTH_ONLY },
+  { "REAL_TIME_FAST_RESPONSE", SL_RTL_AOX_MODE_REAL_TIME_FAST_RESPONSE },
+  { "REAL_TIME_BASIC", SL_RTL_AOX_MODE_REAL_TIME_BASIC },
+  { "REAL_TIME_HIGH_ACCURACY", SL_RTL_AOX_MODE_REAL_TIME_HIGH_ACCURACY }
+};
 
 // -----------------------------------------------------------------------------
 // Private function declarations
 
-static void init_buffers(void);
-static uint32_t allocate_2D_float_buffer(float*** buf, uint32_t rows, uint32_t cols);
+static enum sl_rtl_error_code init_estimator(aoa_state_t *aoa_state,
+                                             enum sl_rtl_aox_mode mode);
+static enum sl_rtl_error_code init_buffers(void);
 static float channel_to_frequency(uint8_t channel);
-static void get_samples(aoa_iq_report_t *iq_report);
+static get_samples_t select_get_samples(void);
+static uint32_t get_samples_any(aoa_iq_report_t *iq_report);
+static bool check_samples(aoa_iq_report_t *iq_report, uint32_t saturated);
 
 /***************************************************************************//**
  * Initialize angle calculation libraries
  ******************************************************************************/
 enum sl_rtl_error_code aoa_init(aoa_state_t *aoa_state)
+{
+  return init_estimator(aoa_state, aoa_mode);
+}
+
+/***************************************************************************//**
+ * Change the estimator mode
+ ******************************************************************************/
+enum sl_rtl_error_code aoa_set_mode(aoa_state_t *aoa_state,
+                                    enum sl_rtl_aox_mode mode)
 {
   enum sl_rtl_error_code ec;
-  // Initialize local buffers
-  init_buffers();
-  // Initialize AoX library
-  ec = sl_rtl_aox_init(&aoa_state->libitem);
-  CHECK_ERROR(ec);
-  // Set the number of snapshots, i.e. how many times the antennas are scanned
-  // during one measurement
-  ec = sl_rtl_aox_set_num_snapshots(&aoa_state->libitem, AOA_NUM_SNAPSHOTS);
-  CHECK_ERROR(ec);
-  // Set the antenna array type
-  ec = sl_rtl_aox_set_array_type(&aoa_state->libitem, AOX_ARRAY_TYPE);
-  CHECK_ERROR(ec);
-  // Select mode (high speed/high accuracy/etc.)
-  ec = sl_rtl_aox_set_mode(&aoa_state->libitem, AOX_MODE);
-  CHECK_ERROR(ec);
-  // Enable IQ sample quality analysis processing
-  ec = sl_rtl_aox_iq_sample_qa_configure(&aoa_state->libitem);
-  CHECK_ERROR(ec);
-  // Add azimuth constraint if min and max values are valid
-  if (!isnan(aoa_azimuth_min) && !isnan(aoa_azimuth_max)) {
-    app_log_info("Disable azimuth values between %f and %f" APP_LOG_NL,
-                 aoa_azimuth_min, aoa_azimuth_max);
-    ec = sl_rtl_aox_add_constraint(&aoa_state->libitem,
-                                   SL_RTL_AOX_CONSTRAINT_TYPE_AZIMUTH,
-                                   aoa_azimuth_min,
-                                   aoa_azimuth_max);
-    CHECK_ERROR(ec);
+
+  if (mode == aoa_state->mode) {
+    return SL_RTL_ERROR_SUCCESS;
   }
-  // Create AoX estimator
-  ec = sl_rtl_aox_create_estimator(&aoa_state->libitem);
+  ec = aoa_deinit(aoa_state);
   CHECK_ERROR(ec);
-  // Initialize an util item
-  ec = sl_rtl_util_init(&aoa_state->util_libitem);
-  CHECK_ERROR(ec);
-  ec = sl_rtl_util_set_parameter(&aoa_state->util_libitem,
-                                 SL_RTL_UTIL_PARAMETER_AMOUNT_OF_FILTERING,
-                                 AOA_FILTERING_AMOUNT);
-  CHECK_ERROR(ec);
-  // Initialize correction timeout counter
-  aoa_state->correction_timeout = 0;
-
-  return ec;
+  return init_estimator(aoa_state, mode);
 }
 
 /***************************************************************************//**
@@ -121,15 +131,25 @@ enum sl_rtl_error_code aoa_calculate(aoa_state_t *aoa_state,
 {
   enum sl_rtl_error_code ec;
   float phase_rotation;
+  uint32_t saturated;
+
+  // Allocate the buffers of this thread on its first report.
+  ec = init_buffers();
+  CHECK_ERROR(ec);
 
   // Copy IQ samples into preallocated buffers.
-  get_samples(iq_report);
+  saturated = get_samples(iq_report);
+
+  // Skip the estimator for reports that cannot give a usable angle.
+  if (!check_samples(iq_report, saturated)) {
+    return AOA_ERROR_SAMPLES_REJECTED;
+  }
 
   // Calculate phase rotation from reference IQ samples.
   ec = sl_rtl_aox_calculate_iq_sample_phase_rotation(&aoa_state->libitem,
                                                      2.0f,
-                                                     ref_i_samples[0],
-                                                     ref_q_samples[0],
+                                                     ref_i_samples.data,
+                                                     ref_q_samples.data,
                                                      AOA_REF_PERIOD_SAMPLES,
                                                      &phase_rotation);
   CHECK_ERROR(ec);
@@ -143,8 +163,8 @@ enum sl_rtl_error_code aoa_calculate(aoa_state_t *aoa_state,
   // sl_rtl_aox_process will return SL_RTL_ERROR_ESTIMATION_IN_PROGRESS
   // until it has received enough packets for angle estimation.
   ec = sl_rtl_aox_process(&aoa_state->libitem,
-                          i_samples,
-                          q_samples,
+                          i_samples.rows,
+                          q_samples.rows,
                           channel_to_frequency(iq_report->channel),
                           &angle->azimuth,
                           &angle->elevation);
@@ -212,38 +232,123 @@ enum sl_rtl_error_code aoa_deinit(aoa_state_t *aoa_state)
   return ec;
 }
 
-// -----------------------------------------------------------------------------
-// Private function declarations
+/***************************************************************************//**
+ * Get the reports rejected by the sample check
+ ******************************************************************************/
+void aoa_get_reject_stats(aoa_reject_stats_t *stats)
+{
+  stats->short_length = __atomic_load_n(&reject_stats.short_length, __ATOMIC_RELAXED);
+  stats->saturated = __atomic_load_n(&reject_stats.saturated, __ATOMIC_RELAXED);
+  stats->amplitude = __atomic_load_n(&reject_stats.amplitude, __ATOMIC_RELAXED);
+  stats->phase = __atomic_load_n(&reject_stats.phase, __ATOMIC_RELAXED);
+}
 
-static void init_buffers(void)
+/***************************************************************************//**
+ * Free the sample buffers of the calling thread
+ ******************************************************************************/
+void aoa_free_buffers(void)
 {
-  static bool initialized = false;
+  aoa_iq_buffer_free(&ref_i_samples);
+  aoa_iq_buffer_free(&ref_q_samples);
+  aoa_iq_buffer_free(&i_samples);
+  aoa_iq_buffer_free(&q_samples);
+}
 
-  if (!initialized) {
-    initialized = true;
-    allocate_2D_float_buffer(&ref_i_samples, AOA_NUM_SNAPSHOTS, AOA_NUM_ARRAY_ELEMENTS);
-    allocate_2D_float_buffer(&ref_q_samples, AOA_NUM_SNAPSHOTS, AOA_NUM_ARRAY_ELEMENTS);
+/***************************************************************************//**
+ * Get the estimator mode of a name
+ ******************************************************************************/
+bool aoa_mode_from_name(const char *name, enum sl_rtl_aox_mode *mode)
+{
+  for (size_t i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+    if (strcmp(name, mode_names[i].name) == 0) {
+      *mode = mode_names[i].mode;
+      return true;
+    }
+  }
+  return false;
+}
 
-    allocate_2D_float_buffer(&i_samples, AOA_NUM_SNAPSHOTS, AOA_NUM_ARRAY_ELEMENTS);
-    allocate_2D_float_buffer(&q_samples, AOA_NUM_SNAPSHOTS, AOA_NUM_ARRAY_ELEMENTS);
+/***************************************************************************//**
+ * Get the name of an estimator mode
+ ******************************************************************************/
+const char *aoa_mode_name(enum sl_rtl_aox_mode mode)
+{
+  for (size_t i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+    if (mode == mode_names[i].mode) {
+      return mode_names[i].name;
+    }
   }
+  return "UNKNOWN";
 }
 
-static uint32_t allocate_2D_float_buffer(float*** buf, uint32_t rows, uint32_t cols)
+// -----------------------------------------------------------------------------
+// Private function declarations
+
+static enum sl_rtl_error_code init_estimator(aoa_state_t *aoa_state,
+                                             enum sl_rtl_aox_mode mode)
 {
-  *buf = malloc(sizeof(float*) * rows);
-  if (*buf == NULL) {
-    return 0;
+  enum sl_rtl_error_code ec;
+
+  // Initialize AoX library
+  ec = sl_rtl_aox_init(&aoa_state->libitem);
+  CHECK_ERROR(ec);
+  // Set the number of snapshots, i.e. how many times the antennas are scanned
+  // during one measurement
+  ec = sl_rtl_aox_set_num_snapshots(&aoa_state->libitem,
+                                    aoa_board.num_snapshots);
+  CHECK_ERROR(ec);
+  // Set the antenna array type
+  ec = sl_rtl_aox_set_array_type(&aoa_state->libitem,
+                                 aoa_board.aox_array_type);
+  CHECK_ERROR(ec);
+  // Select mode (high speed/high accuracy/etc.)
+  ec = sl_rtl_aox_set_mode(&aoa_state->libitem, mode);
+  CHECK_ERROR(ec);
+  // Enable IQ sample quality analysis processing
+  ec = sl_rtl_aox_iq_sample_qa_configure(&aoa_state->libitem);
+  CHECK_ERROR(ec);
+  // Add azimuth constraint if min and max values are valid
+  if (!isnan(aoa_azimuth_min) && !isnan(aoa_azimuth_max)) {
+    app_log_info("Disable azimuth values between %f and %f" APP_LOG_NL,
+                 aoa_azimuth_min, aoa_azimuth_max);
+    ec = sl_rtl_aox_add_constraint(&aoa_state->libitem,
+                                   SL_RTL_AOX_CONSTRAINT_TYPE_AZIMUTH,
+                                   aoa_azimuth_min,
+                                   aoa_azimuth_max);
+    CHECK_ERROR(ec);
   }
+  // Create AoX estimator
+  ec = sl_rtl_aox_create_estimator(&aoa_state->libitem);
+  CHECK_ERROR(ec);
+  // Initialize an util item
+  ec = sl_rtl_util_init(&aoa_state->util_libitem);
+  CHECK_ERROR(ec);
+  ec = sl_rtl_util_set_parameter(&aoa_state->util_libitem,
+                                 SL_RTL_UTIL_PARAMETER_AMOUNT_OF_FILTERING,
+                                 AOA_FILTERING_AMOUNT);
+  CHECK_ERROR(ec);
+  // Initialize correction timeout counter
+  aoa_state->correction_timeout = 0;
+  aoa_state->mode = mode;
+
+  return ec;
+}
 
-  for (uint32_t i = 0; i < rows; i++) {
-    (*buf)[i] = malloc(sizeof(float) * cols);
-    if ((*buf)[i] == NULL) {
-      return 0;
+static enum sl_rtl_error_code init_buffers(void)
+{
+  if (i_samples.block == NULL) {
+    // The reference period is sampled on one antenna, a single row. The
+    // antenna array is set up before the first report and does not change.
+    if (aoa_iq_buffer_alloc(&ref_i_samples, 1, AOA_REF_PERIOD_SAMPLES) != SL_STATUS_OK
+        || aoa_iq_buffer_alloc(&ref_q_samples, 1, AOA_REF_PERIOD_SAMPLES) != SL_STATUS_OK
+        || aoa_iq_buffer_alloc(&i_samples, aoa_board.num_snapshots, aoa_board.num_array_elements) != SL_STATUS_OK
+        || aoa_iq_buffer_alloc(&q_samples, aoa_board.num_snapshots, aoa_board.num_array_elements) != SL_STATUS_OK) {
+      aoa_free_buffers();
+      return SL_RTL_ERROR_OUT_OF_MEMORY;
     }
+    get_samples = select_get_samples();
   }
-
-  return 1;
+  return SL_RTL_ERROR_SUCCESS;
 }
 
 static float channel_to_frequency(uint8_t channel)
@@ -258,35 +363,128 @@ static float channel_to_frequency(uint8_t channel)
   return 2402000000 + 2000000 * logical_to_physical_channel[channel];
 }
 
-static void get_samples(aoa_iq_report_t *iq_report)
+static inline uint32_t unpack_samples(aoa_iq_report_t *iq_report,
+                                      uint32_t count)
 {
-  uint32_t index = 0;
+  const uint32_t ref_length = AOA_REF_PERIOD_SAMPLES * 2;
+  uint32_t ref_saturated;
+  uint32_t saturated;
+
   // Write reference IQ samples into the IQ sample buffer (sampled on one antenna)
-  for (uint32_t sample = 0; sample < AOA_REF_PERIOD_SAMPLES; ++sample) {
-    ref_i_samples[0][sample] = iq_report->samples[index++] / 127.0;
-    if (index == iq_report->length) {
-      break;
-    }
-    ref_q_samples[0][sample] = iq_report->samples[index++] / 127.0;
-    if (index == iq_report->length) {
-      break;
-    }
+  aoa_iq_unpack(iq_report->samples, iq_report->length,
+                ref_i_samples.data, ref_q_samples.data, AOA_REF_PERIOD_SAMPLES,
+                &ref_saturated);
+  if (iq_report->length <= ref_length) {
+    return ref_saturated;
+  }
+  // Write antenna IQ samples into the IQ sample buffer (sampled on all
+  // antennas). The rows of the snapshots are contiguous.
+  aoa_iq_unpack(&iq_report->samples[ref_length], iq_report->length - ref_length,
+                i_samples.data, q_samples.data, count, &saturated);
+  return ref_saturated + saturated;
+}
+
+// Unpacking of the array types with their default number of snapshots. The
+// sample count is a constant in each, so the unpack loops are unrolled for it.
+#define GET_SAMPLES(type)                                                      \
+  static uint32_t get_samples_##type(aoa_iq_report_t *iq_report)               \
+  {                                                                            \
+    return unpack_samples(iq_report,                                           \
+                          ARRAY_##type##_SNAPSHOTS * ARRAY_##type##_ELEMENTS); \
   }
-  index = AOA_REF_PERIOD_SAMPLES * 2;
-  // Write antenna IQ samples into the IQ sample buffer (sampled on all antennas)
-  for (uint32_t snapshot = 0; snapshot < AOA_NUM_SNAPSHOTS; ++snapshot) {
-    for (uint32_t antenna = 0; antenna < AOA_NUM_ARRAY_ELEMENTS; ++antenna) {
-      i_samples[snapshot][antenna] = iq_report->samples[index++] / 127.0;
-      if (index == iq_report->length) {
-        break;
+
+GET_SAMPLES(4x4_URA)
+GET_SAMPLES(3x3_URA)
+GET_SAMPLES(1x4_ULA)
+
+// Unpacking of any other array setup.
+static uint32_t get_samples_any(aoa_iq_report_t *iq_report)
+{
+  return unpack_samples(iq_report,
+                        aoa_board.num_snapshots * aoa_board.num_array_elements);
+}
+
+static get_samples_t select_get_samples(void)
+{
+  uint32_t count = aoa_board.num_snapshots * aoa_board.num_array_elements;
+
+  switch (aoa_board.aox_array_type) {
+    case SL_RTL_AOX_ARRAY_TYPE_4x4_URA:
+      if (count == ARRAY_4x4_URA_SNAPSHOTS * ARRAY_4x4_URA_ELEMENTS) {
+        return get_samples_4x4_URA;
+      }
+      break;
+    case SL_RTL_AOX_ARRAY_TYPE_3x3_URA:
+      if (count == ARRAY_3x3_URA_SNAPSHOTS * ARRAY_3x3_URA_ELEMENTS) {
+        return get_samples_3x3_URA;
       }
-      q_samples[snapshot][antenna] = iq_report->samples[index++] / 127.0;
-      if (index == iq_report->length) {
-        break;
+      break;
+    case SL_RTL_AOX_ARRAY_TYPE_1x4_ULA:
+      if (count == ARRAY_1x4_ULA_SNAPSHOTS * ARRAY_1x4_ULA_ELEMENTS) {
+        return get_samples_1x4_ULA;
       }
-    }
-    if (index == iq_report->length) {
       break;
-    }
+    default:
+      break;
+  }
+  return get_samples_any;
+}
+
+/***************************************************************************//**
+ * Check the samples of a report before they reach the estimator. The report
+ * must cover the antenna array, must not be clipped, and its reference
+ * period, sampled on one antenna, must be a steady tone: a constant amplitude
+ * and a constant phase step between the samples.
+ ******************************************************************************/
+static bool check_samples(aoa_iq_report_t *iq_report, uint32_t saturated)
+{
+  const float *ref_i = ref_i_samples.data;
+  const float *ref_q = ref_q_samples.data;
+  uint32_t length = (AOA_REF_PERIOD_SAMPLES
+                     + aoa_board.num_snapshots * aoa_board.num_array_elements) * 2;
+  float amplitude[AOA_REF_PERIOD_SAMPLES];
+  float amplitude_sum = 0;
+  float power_sum = 0;
+  float step_re = 0;
+  float step_im = 0;
+  float step_sum = 0;
+
+  // The missing samples would be those of the previous report.
+  if (iq_report->length < length) {
+    REJECT(short_length);
+    return false;
+  }
+  if (saturated * 100 > length * AOA_IQ_SATURATED_MAX) {
+    REJECT(saturated);
+    return false;
+  }
+
+  for (uint32_t k = 0; k < AOA_REF_PERIOD_SAMPLES; k++) {
+    float power = ref_i[k] * ref_i[k] + ref_q[k] * ref_q[k];
+    amplitude[k] = sqrtf(power);
+    amplitude_sum += amplitude[k];
+    power_sum += power;
+  }
+  // The squared mean amplitude over the mean power falls below 1 as the
+  // amplitude varies.
+  if (amplitude_sum < AOA_IQ_REF_AMPLITUDE_MIN * AOA_REF_PERIOD_SAMPLES
+      || amplitude_sum * amplitude_sum
+      < AOA_IQ_REF_FLATNESS_MIN * AOA_REF_PERIOD_SAMPLES * power_sum) {
+    REJECT(amplitude);
+    return false;
+  }
+
+  // Phase steps as s[k + 1] * conj(s[k]). Their sum is as long as the sum of
+  // their lengths only if they all point the same way.
+  for (uint32_t k = 0; k + 1 < AOA_REF_PERIOD_SAMPLES; k++) {
+    step_re += ref_i[k + 1] * ref_i[k] + ref_q[k + 1] * ref_q[k];
+    step_im += ref_q[k + 1] * ref_i[k] - ref_i[k + 1] * ref_q[k];
+    step_sum += amplitude[k + 1] * amplitude[k];
+  }
+  if (step_re * step_re + step_im * step_im
+      < AOA_IQ_REF_COHERENCE_MIN * AOA_IQ_REF_COHERENCE_MIN * step_sum * step_sum) {
+    REJECT(phase);
+    return false;
   }
+  return true;
 }
@@ -36,6 +36,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "aoa_types.h"
 #include "sl_rtl_clib_api.h"
 
@@ -46,8 +47,25 @@ typedef struct aoa_state_s {
   sl_rtl_aox_libitem libitem;
   sl_rtl_util_libitem util_libitem;
   uint8_t correction_timeout;
+  enum sl_rtl_aox_mode mode;
 } aoa_state_t;
 
+/***************************************************************************//**
+ * Returned by aoa_calculate for a report rejected by the sample check. The
+ * library itself never returns its number of error codes.
+ ******************************************************************************/
+#define AOA_ERROR_SAMPLES_REJECTED  ((enum sl_rtl_error_code)SL_RTL_ERROR_LAST)
+
+/***************************************************************************//**
+ * Reports rejected by the sample check before the estimator
+ ******************************************************************************/
+typedef struct {
+  uint64_t short_length;  // Fewer samples than the antenna array needs
+  uint64_t saturated;     // Too many samples clipped at full scale
+  uint64_t amplitude;     // Reference period too weak or uneven
+  uint64_t phase;         // Reference period not a steady phase rotation
+} aoa_reject_stats_t;
+
 /***************************************************************************//**
  * Gloabal value for azimuth mask (minimum)
  ******************************************************************************/
@@ -58,6 +76,11 @@ extern float aoa_azimuth_min;
  ******************************************************************************/
 extern float aoa_azimuth_max;
 
+/***************************************************************************//**
+ * Gloabal value for the estimator mode
+ ******************************************************************************/
+extern enum sl_rtl_aox_mode aoa_mode;
+
 /***************************************************************************//**
  * Initialize angle calculation libraries
  * @param[in] aoa_state Angle calculation handler
@@ -66,11 +89,23 @@ extern float aoa_azimuth_max;
 enum sl_rtl_error_code aoa_init(aoa_state_t *aoa_state);
 
 /***************************************************************************//**
- * Estimate angle data from IQ samples
+ * Change the estimator mode. The estimator is created again, so the
+ * filtering starts over and the correction data is cleared.
+ * @param[in] aoa_state Angle calculation handler
+ * @param[in] mode Estimator mode
+ * @return Status returned by the RTL library
+ ******************************************************************************/
+enum sl_rtl_error_code aoa_set_mode(aoa_state_t *aoa_state,
+                                    enum sl_rtl_aox_mode mode);
+
+/***************************************************************************//**
+ * Estimate angle data from IQ samples. The samples are checked first, a
+ * report that fails the check does not reach the estimator.
  * @param[in] aoa_state Angle calculation handler
  * @param[in] iq_report IQ report to convert
  * @param[out] angle Estimated angle data
- * @return Status returned by the RTL library
+ * @return Status returned by the RTL library,
+ *         AOA_ERROR_SAMPLES_REJECTED if the report failed the sample check.
  ******************************************************************************/
 enum sl_rtl_error_code aoa_calculate(aoa_state_t *aoa_state,
                                      aoa_iq_report_t *iq_report,
@@ -92,6 +127,33 @@ enum sl_rtl_error_code aoa_set_correction(aoa_state_t *aoa_state,
  ******************************************************************************/
 enum sl_rtl_error_code aoa_deinit(aoa_state_t *aoa_state);
 
+/***************************************************************************//**
+ * Get the estimator mode of a name
+ * @param[in] name Name of the mode without the prefix, e.g. "REAL_TIME_BASIC"
+ * @param[out] mode Estimator mode
+ * @return true if the name is known
+ ******************************************************************************/
+bool aoa_mode_from_name(const char *name, enum sl_rtl_aox_mode *mode);
+
+/***************************************************************************//**
+ * Get the name of an estimator mode
+ * @param[in] mode Estimator mode
+ * @return Name of the mode without the prefix, "UNKNOWN" if not known
+ ******************************************************************************/
+const char *aoa_mode_name(enum sl_rtl_aox_mode mode);
+
+/***************************************************************************//**
+ * Get the reports rejected by the sample check
+ * @param[out] stats Rejected reports of all threads since the start
+ ******************************************************************************/
+void aoa_get_reject_stats(aoa_reject_stats_t *stats);
+
+/***************************************************************************//**
+ * Free the sample buffers of the calling thread. Every thread calling
+ * aoa_calculate has its own, allocated on its first call.
+ ******************************************************************************/
+void aoa_free_buffers(void);
+
 #ifdef __cplusplus
 };
 #endif
@@ -35,7 +35,8 @@
 #include "sl_rtl_clib_api.h"
 #include "aoa_board.h"
 
-// AoA estimator mode
+// Default AoA estimator mode.
+// Can be overridden with runtime configuration.
 #define AOX_MODE                       SL_RTL_AOX_MODE_REAL_TIME_BASIC
 
 // Reference RSSI value of the asset tag at 1.0 m distance in dBm.
@@ -52,6 +53,24 @@
 // Can be overridden with runtime configuration. Use NAN to disable.
 #define AOA_AZIMUTH_MASK_MAX_DEFAULT   NAN
 
+// Reports with more samples clipped at full scale are rejected before the
+// estimator, in percent of the samples. Use 100 to disable.
+#define AOA_IQ_SATURATED_MAX           10
+
+// Reports whose reference period has a lower mean amplitude are rejected
+// before the estimator, on the scale of the samples (1.0: full scale).
+#define AOA_IQ_REF_AMPLITUDE_MIN       0.03f
+
+// Reports whose reference period amplitude varies more are rejected before
+// the estimator. The squared mean amplitude over the mean power, 1.0 for a
+// constant amplitude. Use 0 to disable.
+#define AOA_IQ_REF_FLATNESS_MIN        0.8f
+
+// Reports whose reference period is not a steady phase rotation are rejected
+// before the estimator. The length of the sum of the phase steps over the sum
+// of their lengths, 1.0 for a constant step. Use 0 to disable.
+#define AOA_IQ_REF_COHERENCE_MIN       0.6f
+
 // Direction correction will be cleared if this amout of IQ reports are received
 // without receiving a correction message.
 #define CORRECTION_TIMEOUT             5
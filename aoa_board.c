@@ -0,0 +1,77 @@
+/***************************************************************************//**
+ * @file
+ * @brief Antenna board configuration.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include "aoa_board.h"
+
+// Initializers of the array types.
+#define ARRAY_4x4_URA  { "4x4_URA", SL_RTL_AOX_ARRAY_TYPE_4x4_URA,         \
+                         ARRAY_4x4_URA_SNAPSHOTS, ARRAY_4x4_URA_ELEMENTS, \
+                         ARRAY_4x4_URA_PATTERN }
+#define ARRAY_3x3_URA  { "3x3_URA", SL_RTL_AOX_ARRAY_TYPE_3x3_URA,         \
+                         ARRAY_3x3_URA_SNAPSHOTS, ARRAY_3x3_URA_ELEMENTS, \
+                         ARRAY_3x3_URA_PATTERN }
+#define ARRAY_1x4_ULA  { "1x4_ULA", SL_RTL_AOX_ARRAY_TYPE_1x4_ULA,         \
+                         ARRAY_1x4_ULA_SNAPSHOTS, ARRAY_1x4_ULA_ELEMENTS, \
+                         ARRAY_1x4_ULA_PATTERN }
+
+// -----------------------------------------------------------------------------
+// Public variables
+
+#if (ARRAY_TYPE == ARRAY_TYPE_4x4_URA)
+aoa_board_t aoa_board = ARRAY_4x4_URA;
+#elif (ARRAY_TYPE == ARRAY_TYPE_3x3_URA)
+aoa_board_t aoa_board = ARRAY_3x3_URA;
+#elif (ARRAY_TYPE == ARRAY_TYPE_1x4_ULA)
+aoa_board_t aoa_board = ARRAY_1x4_ULA;
+#endif
+
+// -----------------------------------------------------------------------------
+// Private variables
+
+static const aoa_board_t array_types[] = {
+  [ARRAY_TYPE_4x4_URA] = ARRAY_4x4_URA,
+  [ARRAY_TYPE_3x3_URA] = ARRAY_3x3_URA,
+  [ARRAY_TYPE_1x4_ULA] = ARRAY_1x4_ULA
+};
+
+/***************************************************************************//**
+ * Load the defaults of an array type.
+ ******************************************************************************/
+sl_status_t aoa_board_set_array_type(aoa_board_t *board, const char *name)
+{
+  for (size_t i = 0; i < sizeof(array_types) / sizeof(array_types[0]); i++) {
+    if (strcmp(name, array_types[i].name) == 0) {
+      *board = array_types[i];
+      return SL_STATUS_OK;
+    }
+  }
+  return SL_STATUS_NOT_FOUND;
+}
@@ -31,33 +31,67 @@
 #ifndef AOA_BOARD_H
 #define AOA_BOARD_H
 
+#include <stdint.h>
+#include "sl_status.h"
+#include "sl_rtl_clib_api.h"
+
 // AoA antenna array type
 #define ARRAY_TYPE_4x4_URA             0
 #define ARRAY_TYPE_3x3_URA             1
 #define ARRAY_TYPE_1x4_ULA             2
 
+// Array type used if the locator config does not select one.
 #ifndef ARRAY_TYPE
 #define ARRAY_TYPE                     ARRAY_TYPE_4x4_URA
 #endif
 
-#if (ARRAY_TYPE == ARRAY_TYPE_4x4_URA)
-#define AOX_ARRAY_TYPE          SL_RTL_AOX_ARRAY_TYPE_4x4_URA
-#define AOA_NUM_SNAPSHOTS       (4)
-#define AOA_NUM_ARRAY_ELEMENTS  (4 * 4)
-#define AOA_REF_PERIOD_SAMPLES  (7)
-#define SWITCHING_PATTERN       { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }
-#elif (ARRAY_TYPE == ARRAY_TYPE_3x3_URA)
-#define AOX_ARRAY_TYPE          SL_RTL_AOX_ARRAY_TYPE_3x3_URA
-#define AOA_NUM_SNAPSHOTS       (4)
-#define AOA_NUM_ARRAY_ELEMENTS  (3 * 3)
-#define AOA_REF_PERIOD_SAMPLES  (7)
-#define SWITCHING_PATTERN       { 1, 2, 3, 5, 6, 7, 9, 10, 11 }
-#elif (ARRAY_TYPE == ARRAY_TYPE_1x4_ULA)
-#define AOX_ARRAY_TYPE          SL_RTL_AOX_ARRAY_TYPE_1x4_ULA
-#define AOA_NUM_SNAPSHOTS       (18)
-#define AOA_NUM_ARRAY_ELEMENTS  (1 * 4)
-#define AOA_REF_PERIOD_SAMPLES  (7)
-#define SWITCHING_PATTERN       { 0, 1, 2, 3 }
-#endif
+// Properties of the array types: default number of snapshots, number of
+// antennas and switching pattern.
+#define ARRAY_4x4_URA_SNAPSHOTS        (4)
+#define ARRAY_4x4_URA_ELEMENTS         (4 * 4)
+#define ARRAY_4x4_URA_PATTERN          { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }
+
+#define ARRAY_3x3_URA_SNAPSHOTS        (4)
+#define ARRAY_3x3_URA_ELEMENTS         (3 * 3)
+#define ARRAY_3x3_URA_PATTERN          { 1, 2, 3, 5, 6, 7, 9, 10, 11 }
+
+#define ARRAY_1x4_ULA_SNAPSHOTS        (18)
+#define ARRAY_1x4_ULA_ELEMENTS         (1 * 4)
+#define ARRAY_1x4_ULA_PATTERN          { 0, 1, 2, 3 }
+
+// Number of IQ samples in the reference period, the same for all types.
+#define AOA_REF_PERIOD_SAMPLES         (7)
+
+// Largest number of antennas of all array types.
+#define AOA_MAX_ARRAY_ELEMENTS         (4 * 4)
+
+// Largest number of antenna IQ samples in a report, snapshots times antennas.
+// The samples of a report are at most UINT8_MAX bytes, the reference period
+// included.
+#define AOA_MAX_ANTENNA_SAMPLES        (UINT8_MAX / 2 - AOA_REF_PERIOD_SAMPLES)
+
+// Antenna array of the locator.
+typedef struct {
+  const char *name;                                  // Name in the locator config
+  enum sl_rtl_aox_array_type aox_array_type;
+  uint32_t num_snapshots;                            // Antenna scans in a report
+  uint32_t num_array_elements;                       // Number of antennas
+  uint8_t switching_pattern[AOA_MAX_ARRAY_ELEMENTS]; // Antenna of every slot
+} aoa_board_t;
+
+/***************************************************************************//**
+ * Antenna array in use. It defaults to ARRAY_TYPE and can be overridden with
+ * runtime configuration before the first tag is seen.
+ ******************************************************************************/
+extern aoa_board_t aoa_board;
+
+/***************************************************************************//**
+ * Load the defaults of an array type.
+ * @param[out] board Antenna array
+ * @param[in] name Name of the array type, e.g. "4x4_URA"
+ * @retval SL_STATUS_OK Defaults loaded
+ * @retval SL_STATUS_NOT_FOUND Unknown array type, board is unchanged.
+ ******************************************************************************/
+sl_status_t aoa_board_set_array_type(aoa_board_t *board, const char *name);
 
 #endif // AOA_BOARD_H
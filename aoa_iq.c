@@ -0,0 +1,70 @@
+/***************************************************************************//**
+ * @file
+ * @brief IQ sample unpacking
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aoa_iq.h"
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+sl_status_t aoa_iq_buffer_alloc(aoa_iq_buffer_t *buffer, uint32_t rows,
+                                uint32_t cols)
+{
+  size_t pointers = rows * sizeof(float *);
+  size_t samples = (size_t)rows * cols * sizeof(float);
+  uintptr_t data;
+
+  // The row pointers first, then the samples from the next aligned address.
+  buffer->block = malloc(pointers + AOA_IQ_ALIGNMENT - 1 + samples);
+  if (buffer->block == NULL) {
+    buffer->data = NULL;
+    buffer->rows = NULL;
+    return SL_STATUS_ALLOCATION_FAILED;
+  }
+  data = ((uintptr_t)buffer->block + pointers + AOA_IQ_ALIGNMENT - 1)
+         & ~(uintptr_t)(AOA_IQ_ALIGNMENT - 1);
+  buffer->rows = (float **)buffer->block;
+  buffer->data = (float *)data;
+  memset(buffer->data, 0, samples);
+  for (uint32_t row = 0; row < rows; row++) {
+    buffer->rows[row] = &buffer->data[(size_t)row * cols];
+  }
+  return SL_STATUS_OK;
+}
+
+void aoa_iq_buffer_free(aoa_iq_buffer_t *buffer)
+{
+  free(buffer->block);
+  buffer->block = NULL;
+  buffer->data = NULL;
+  buffer->rows = NULL;
+}
@@ -0,0 +1,184 @@
+/***************************************************************************//**
+ * @file
+ * @brief IQ sample unpacking header file
+ *
+ * An IQ report carries the samples as interleaved int8 I and Q values: the
+ * reference period first, then the antenna samples of every snapshot. The
+ * estimator takes them as separate float arrays of I and Q values, scaled to
+ * [-1, 1], in rows of one snapshot each.
+ *
+ * The float arrays of a buffer are one contiguous, aligned block, and the row
+ * pointers taken by libaox point into it. The unpacking then runs over all
+ * snapshots at once with SSE2 or NEON, or as a plain loop that the compiler
+ * can vectorize. It counts the samples clipped at full scale on the way, for
+ * the quality check before the estimator.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef AOA_IQ_H
+#define AOA_IQ_H
+
+#include <stdint.h>
+#include "sl_status.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Alignment of the sample buffers in bytes, a cache line.
+#define AOA_IQ_ALIGNMENT  64
+
+// Scale of the int8 samples.
+#define AOA_IQ_SCALE      (1.0f / 127.0f)
+
+// An int8 sample at full scale, clipped by the receiver. Without branches, so
+// that the loops counting them can be vectorized.
+#define AOA_IQ_SATURATED(x)  (((x) >= 127) | ((x) <= -127))
+
+// Rows of float samples in one contiguous, aligned block.
+typedef struct {
+  float *data;      // rows * cols samples, row after row
+  float **rows;     // Pointer to every row, as taken by libaox
+  void *block;      // Allocated block, data and rows point into it
+} aoa_iq_buffer_t;
+
+/**************************************************************************//**
+ * Allocate a sample buffer.
+ *
+ * @param[out] buffer Sample buffer.
+ * @param[in] rows Number of rows.
+ * @param[in] cols Number of samples in a row.
+ *
+ * @retval SL_STATUS_OK Buffer allocated, the samples are zero.
+ * @retval SL_STATUS_ALLOCATION_FAILED Out of memory.
+ *****************************************************************************/
+sl_status_t aoa_iq_buffer_alloc(aoa_iq_buffer_t *buffer, uint32_t rows,
+                                uint32_t cols);
+
+/**************************************************************************//**
+ * Free a sample buffer.
+ *
+ * @param[in] buffer Sample buffer.
+ *****************************************************************************/
+void aoa_iq_buffer_free(aoa_iq_buffer_t *buffer);
+
+/**************************************************************************//**
+ * Split interleaved int8 IQ samples into I and Q floats scaled by
+ * AOA_IQ_SCALE. Only the samples present are written, the rest of the
+ * arrays keep their values. A last I sample without its Q sample is written
+ * to i only. The samples at full scale are counted in the same pass.
+ *
+ * @param[in] samples Interleaved samples: I, Q, I, Q...
+ * @param[in] length Number of int8 samples available.
+ * @param[out] i I samples, count floats.
+ * @param[out] q Q samples, count floats.
+ * @param[in] count Number of IQ pairs wanted.
+ * @param[out] saturated Number of written int8 samples at full scale, see
+ *                       AOA_IQ_SATURATED.
+ *
+ * @return Number of complete IQ pairs written.
+ *
+ * @note The function is inline, so that callers passing a constant count get
+ *       the loops unrolled for it.
+ *****************************************************************************/
+static inline uint32_t aoa_iq_unpack(const int8_t *samples, uint32_t length,
+                                     float *i, float *q, uint32_t count,
+                                     uint32_t *saturated)
+{
+  uint32_t n = 0;
+  uint32_t pairs = length / 2;
+  uint32_t clipped = 0;
+
+  // Bound the loops once instead of checking the length on every sample.
+  if (pairs > count) {
+    pairs = count;
+  }
+
+#if defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps(AOA_IQ_SCALE);
+  const __m128i full = _mm_set1_epi8(126);
+  const __m128i full_neg = _mm_set1_epi8(-126);
+  for (; n + 8 <= pairs; n += 8) {
+    __m128i iq = _mm_loadu_si128((const __m128i *)&samples[2 * n]);
+    // Every 16-bit lane holds an I sample in its low byte and the Q sample in
+    // its high byte. Shift them into place with sign extension.
+    __m128i i16 = _mm_srai_epi16(_mm_slli_epi16(iq, 8), 8);
+    __m128i q16 = _mm_srai_epi16(iq, 8);
+    __m128i i_lo = _mm_srai_epi32(_mm_unpacklo_epi16(i16, i16), 16);
+    __m128i i_hi = _mm_srai_epi32(_mm_unpackhi_epi16(i16, i16), 16);
+    __m128i q_lo = _mm_srai_epi32(_mm_unpacklo_epi16(q16, q16), 16);
+    __m128i q_hi = _mm_srai_epi32(_mm_unpackhi_epi16(q16, q16), 16);
+    _mm_storeu_ps(&i[n], _mm_mul_ps(_mm_cvtepi32_ps(i_lo), scale));
+    _mm_storeu_ps(&i[n + 4], _mm_mul_ps(_mm_cvtepi32_ps(i_hi), scale));
+    _mm_storeu_ps(&q[n], _mm_mul_ps(_mm_cvtepi32_ps(q_lo), scale));
+    _mm_storeu_ps(&q[n + 4], _mm_mul_ps(_mm_cvtepi32_ps(q_hi), scale));
+    // One mask bit for every sample at full scale.
+    clipped += (uint32_t)__builtin_popcount(
+      _mm_movemask_epi8(_mm_or_si128(_mm_cmpgt_epi8(iq, full),
+                                     _mm_cmplt_epi8(iq, full_neg))));
+  }
+#elif defined(__ARM_NEON)
+  const float32x4_t scale = vdupq_n_f32(AOA_IQ_SCALE);
+  const int8x8_t full = vdup_n_s8(127);
+  const uint8x8_t one = vdup_n_u8(1);
+  // Every round adds two at most to a lane. A report has less than 256
+  // samples, so the lanes do not overflow.
+  uint8x8_t clipped8 = vdup_n_u8(0);
+  for (; n + 8 <= pairs; n += 8) {
+    // The structure load splits the I and Q samples.
+    int8x8x2_t iq = vld2_s8(&samples[2 * n]);
+    int16x8_t i16 = vmovl_s8(iq.val[0]);
+    int16x8_t q16 = vmovl_s8(iq.val[1]);
+    vst1q_f32(&i[n], vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(i16))), scale));
+    vst1q_f32(&i[n + 4], vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(i16))), scale));
+    vst1q_f32(&q[n], vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(q16))), scale));
+    vst1q_f32(&q[n + 4], vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(q16))), scale));
+    // The saturating absolute value maps -128 to 127 as well.
+    clipped8 = vadd_u8(clipped8, vand_u8(vcge_s8(vqabs_s8(iq.val[0]), full), one));
+    clipped8 = vadd_u8(clipped8, vand_u8(vcge_s8(vqabs_s8(iq.val[1]), full), one));
+  }
+  clipped = (uint32_t)vget_lane_u64(vpaddl_u32(vpaddl_u16(vpaddl_u8(clipped8))), 0);
+#endif
+
+  // The rest, or all samples without SIMD. The loop has no exits, so the
+  // compiler can vectorize it as well.
+  for (; n < pairs; n++) {
+    i[n] = (float)samples[2 * n] * AOA_IQ_SCALE;
+    q[n] = (float)samples[2 * n + 1] * AOA_IQ_SCALE;
+    clipped += AOA_IQ_SATURATED(samples[2 * n]) + AOA_IQ_SATURATED(samples[2 * n + 1]);
+  }
+  if (pairs < count && 2 * pairs < length) {
+    i[pairs] = (float)samples[2 * pairs] * AOA_IQ_SCALE;
+    clipped += AOA_IQ_SATURATED(samples[2 * pairs]);
+  }
+  *saturated = clipped;
+  return pairs;
+}
+
+#endif // AOA_IQ_H
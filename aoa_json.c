@@ -0,0 +1,158 @@
+/***************************************************************************//**
+ * @file
+ * @brief JSON angle record formatter
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "aoa_json.h"
+
+// Floats below this magnitude are scaled to an exact 64 bit integer.
+#define FAST_FLOAT_LIMIT  1e12
+
+// Two digit strings of 00..99.
+static const char digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324"
+  "25262728293031323334353637383940414243444546474849"
+  "50515253545556575859606162636465666768697071727374"
+  "75767778798081828384858687888990919293949596979899";
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static char *put_text(char *p, const char *text, uint32_t len);
+static char *put_u64(char *p, uint64_t value);
+static char *put_i32(char *p, int32_t value);
+
+// Append a string literal without its terminating null character.
+#define PUT_TEXT(p, text)  put_text(p, text, sizeof(text) - 1)
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+uint32_t aoa_json_encode(const char *locator_id,
+                         uint8_t tag_id,
+                         const aoa_angle_t *angle,
+                         char *buf)
+{
+  char *p = buf;
+  uint32_t i;
+
+  p = PUT_TEXT(p, "{\n\t\"timeStamp\": ");
+  p = put_i32(p, angle->sequence);
+  p = PUT_TEXT(p, ",\n\t\"type\": \"auditory\", ");
+  if (locator_id != NULL) {
+    p = PUT_TEXT(p, "\n\t\"locatorId\": \"");
+    for (i = 0; i < AOA_ID_MAX_SIZE - 1 && locator_id[i] != '\0'; i++) {
+      *p++ = locator_id[i];
+    }
+    p = PUT_TEXT(p, "\",");
+  }
+  p = PUT_TEXT(p, "\n\t\"tagId\": \"");
+  *p++ = hex_digits[tag_id >> 4];
+  *p++ = hex_digits[tag_id & 0x0f];
+  p = PUT_TEXT(p, "\",\n\t\"azimuth\": ");
+  p = aoa_json_put_float(p, angle->azimuth);
+  p = PUT_TEXT(p, ",\n\t\"distance\": ");
+  p = aoa_json_put_float(p, angle->distance);
+  p = PUT_TEXT(p, ",\n\t\"elevation\": ");
+  p = aoa_json_put_float(p, angle->elevation);
+  p = PUT_TEXT(p, ",\n\t\"quality\": ");
+  p = put_u64(p, angle->quality);
+  p = PUT_TEXT(p, "\n}\r\n");
+  *p = '\0';
+  return (uint32_t)(p - buf);
+}
+
+char *aoa_json_put_float(char *p, float value)
+{
+  double x = value;
+  uint64_t scaled;
+  uint32_t fraction;
+
+  // NaN, infinity and very large values are rare, leave them to printf.
+  if (!(fabs(x) < FAST_FLOAT_LIMIT)) {
+    return p + sprintf(p, "%f", x);
+  }
+  // The product of a float and 10^6 fits in the 53 bit mantissa of a double,
+  // so it is exact. Rounding it to the nearest integer, ties to even, gives
+  // the same digits as printf.
+  scaled = (uint64_t)llrint(fabs(x) * 1e6);
+  if (signbit(x)) {
+    *p++ = '-';
+  }
+  p = put_u64(p, scaled / 1000000);
+  fraction = (uint32_t)(scaled % 1000000);
+  *p++ = '.';
+  memcpy(p, &digit_pairs[2 * (fraction / 10000)], 2);
+  memcpy(p + 2, &digit_pairs[2 * (fraction / 100 % 100)], 2);
+  memcpy(p + 4, &digit_pairs[2 * (fraction % 100)], 2);
+  return p + 6;
+}
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+static char *put_text(char *p, const char *text, uint32_t len)
+{
+  memcpy(p, text, len);
+  return p + len;
+}
+
+// Write an unsigned integer in decimal.
+static char *put_u64(char *p, uint64_t value)
+{
+  char digits[20];
+  char *d = digits + sizeof(digits);
+  uint32_t len;
+
+  while (value >= 100) {
+    d -= 2;
+    memcpy(d, &digit_pairs[2 * (value % 100)], 2);
+    value /= 100;
+  }
+  if (value >= 10) {
+    d -= 2;
+    memcpy(d, &digit_pairs[2 * value], 2);
+  } else {
+    *--d = (char)('0' + value);
+  }
+  len = (uint32_t)(digits + sizeof(digits) - d);
+  memcpy(p, d, len);
+  return p + len;
+}
+
+static char *put_i32(char *p, int32_t value)
+{
+  if (value < 0) {
+    *p++ = '-';
+    return put_u64(p, (uint64_t)(-(int64_t)value));
+  }
+  return put_u64(p, (uint64_t)value);
+}
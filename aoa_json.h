@@ -0,0 +1,76 @@
+/***************************************************************************//**
+ * @file
+ * @brief JSON angle record formatter header file
+ *
+ * Writes the JSON text of an angle result without snprintf. The output is
+ * the same as that of the printf format used before:
+ *
+ *   {"timeStamp": %d, "type": "auditory", "locatorId": "%s", "tagId": "%02X",
+ *    "azimuth": %f, "distance": %f, "elevation": %f, "quality": %u}
+ *
+ * with the original tabs, new lines and the closing "\r\n". The angles are
+ * written with 6 decimals, rounded like printf does, and independent of the
+ * locale. Without a locator ID, "locatorId" is left out, as in the output of
+ * a single dev board.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef AOA_JSON_H
+#define AOA_JSON_H
+
+#include <stdint.h>
+#include "aoa_types.h"
+
+// Longest float written: -FLT_MAX with 6 decimals.
+#define AOA_JSON_FLOAT_MAX_LEN  47
+// Longest record: 133 characters of fixed text, the integers (11 + 2 + 10),
+// the locator ID with the terminating null character and the floats.
+#define AOA_JSON_MAX_LEN        (156 + AOA_ID_MAX_SIZE + 3 * AOA_JSON_FLOAT_MAX_LEN)
+
+/**************************************************************************//**
+ * Format an angle result as JSON.
+ * @param[in] locator_id Locator ID, null terminated, or NULL to leave the
+ *                       field out.
+ * @param[in] tag_id Tag ID byte, written as two hexadecimal digits.
+ * @param[in] angle Angle result.
+ * @param[out] buf Buffer of at least AOA_JSON_MAX_LEN bytes.
+ * @return Length of the text, without the terminating null character.
+ *****************************************************************************/
+uint32_t aoa_json_encode(const char *locator_id,
+                         uint8_t tag_id,
+                         const aoa_angle_t *angle,
+                         char *buf);
+
+/**************************************************************************//**
+ * Write a float with 6 decimals, like printf "%f".
+ * @param[out] p Buffer of at least AOA_JSON_FLOAT_MAX_LEN + 1 bytes.
+ * @param[in] value Value to write.
+ * @return Pointer past the last character written, not null terminated.
+ *****************************************************************************/
+char *aoa_json_put_float(char *p, float value);
+
+#endif // AOA_JSON_H
@@ -34,6 +34,9 @@
 #include "cJSON.h"
 #include "aoa_util.h"
 #include "aoa_parse.h"
+#ifdef RTL_LIB
+#include "aoa_angle.h"
+#endif // RTL_LIB
 
 // Helper macro.
 #define CHECK_TYPE(x, t)  if (((x) == NULL) || ((x)->type != (t))) return SL_STATUS_FAIL
@@ -219,6 +222,101 @@ sl_status_t aoa_parse_azimuth(float *min, float *max)
   return SL_STATUS_OK;
 }
 
+/**************************************************************************//**
+ * Parse antenna array configuration.
+ *****************************************************************************/
+sl_status_t aoa_parse_antenna_array(aoa_board_t *board)
+{
+  cJSON *param;
+  cJSON *subparam;
+  cJSON *item;
+  aoa_board_t config;
+  int count;
+
+  // Check preconditions.
+  if (NULL == root) {
+    return SL_STATUS_NOT_INITIALIZED;
+  }
+  if (NULL == board) {
+    return SL_STATUS_NULL_POINTER;
+  }
+
+  param = cJSON_GetObjectItem(root, "antenna_array");
+  if (NULL == param) {
+    // Antenna array configuration is optional.
+    return SL_STATUS_NOT_FOUND;
+  }
+  subparam = cJSON_GetObjectItem(param, "type");
+  CHECK_TYPE(subparam, cJSON_String);
+  if (aoa_board_set_array_type(&config, subparam->valuestring) != SL_STATUS_OK) {
+    return SL_STATUS_INVALID_CONFIGURATION;
+  }
+
+  // The number of snapshots is optional, the default of the type is used.
+  subparam = cJSON_GetObjectItem(param, "snapshots");
+  if (NULL != subparam) {
+    CHECK_TYPE(subparam, cJSON_Number);
+    if ((subparam->valuedouble < 1)
+        || (subparam->valuedouble * config.num_array_elements
+            > AOA_MAX_ANTENNA_SAMPLES)
+        || (subparam->valuedouble != (double)(uint32_t)subparam->valuedouble)) {
+      return SL_STATUS_INVALID_RANGE;
+    }
+    config.num_snapshots = (uint32_t)subparam->valuedouble;
+  }
+
+  // The switching pattern is optional, it must name every antenna.
+  subparam = cJSON_GetObjectItem(param, "switching_pattern");
+  if (NULL != subparam) {
+    CHECK_TYPE(subparam, cJSON_Array);
+    count = cJSON_GetArraySize(subparam);
+    if (count != (int)config.num_array_elements) {
+      return SL_STATUS_INVALID_COUNT;
+    }
+    for (int i = 0; i < count; i++) {
+      item = cJSON_GetArrayItem(subparam, i);
+      CHECK_TYPE(item, cJSON_Number);
+      if ((item->valuedouble < 0) || (item->valuedouble > UINT8_MAX)
+          || (item->valuedouble != (double)(uint8_t)item->valuedouble)) {
+        return SL_STATUS_INVALID_RANGE;
+      }
+      config.switching_pattern[i] = (uint8_t)item->valuedouble;
+    }
+  }
+
+  *board = config;
+  return SL_STATUS_OK;
+}
+
+#ifdef RTL_LIB
+/**************************************************************************//**
+ * Parse estimator mode.
+ *****************************************************************************/
+sl_status_t aoa_parse_estimator_mode(enum sl_rtl_aox_mode *mode)
+{
+  cJSON *param;
+
+  // Check preconditions.
+  if (NULL == root) {
+    return SL_STATUS_NOT_INITIALIZED;
+  }
+  if (NULL == mode) {
+    return SL_STATUS_NULL_POINTER;
+  }
+
+  param = cJSON_GetObjectItem(root, "estimator_mode");
+  if (NULL == param) {
+    // Estimator mode configuration is optional.
+    return SL_STATUS_NOT_FOUND;
+  }
+  CHECK_TYPE(param, cJSON_String);
+  if (!aoa_mode_from_name(param->valuestring, mode)) {
+    return SL_STATUS_INVALID_CONFIGURATION;
+  }
+  return SL_STATUS_OK;
+}
+#endif // RTL_LIB
+
 /**************************************************************************//**
  * Parse next item from the allowlist.
  *****************************************************************************/
@@ -37,6 +37,7 @@
 #include "sl_rtl_clib_api.h"
 #endif // RTL_LIB
 #include "aoa_util.h"
+#include "aoa_board.h"
 
 /**************************************************************************//**
  * Load file into memory.
@@ -84,6 +85,31 @@ sl_status_t aoa_parse_locator(aoa_id_t id,
  *****************************************************************************/
 sl_status_t aoa_parse_azimuth(float *min, float *max);
 
+/**************************************************************************//**
+ * Parse antenna array configuration.
+ *
+ * @param[out] board Antenna array, the defaults of the configured type with
+ *                   the configured snapshots and switching pattern.
+ *
+ * @retval SL_STATUS_NOT_FOUND No antenna array configured, board unchanged.
+ * @retval SL_STATUS_INVALID_CONFIGURATION Unknown array type.
+ * @retval SL_STATUS_INVALID_RANGE Snapshots do not fit in an IQ report.
+ * @retval SL_STATUS_INVALID_COUNT Switching pattern of the wrong length.
+ *****************************************************************************/
+sl_status_t aoa_parse_antenna_array(aoa_board_t *board);
+
+#ifdef RTL_LIB
+/**************************************************************************//**
+ * Parse estimator mode configuration.
+ *
+ * @param[out] mode Estimator mode.
+ *
+ * @retval SL_STATUS_NOT_FOUND No estimator mode configured.
+ * @retval SL_STATUS_INVALID_CONFIGURATION Unknown mode.
+ *****************************************************************************/
+sl_status_t aoa_parse_estimator_mode(enum sl_rtl_aox_mode *mode);
+#endif // RTL_LIB
+
 /**************************************************************************//**
  * Parse next item from the allowlist.
  *
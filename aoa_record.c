@@ -0,0 +1,166 @@
+/***************************************************************************//**
+ * @file
+ * @brief Binary angle record
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "aoa_record.h"
+
+#if defined(POSIX) && POSIX == 1
+#include <time.h>
+#else // defined(POSIX) && POSIX == 1
+#include <windows.h>
+// Difference between the Windows and the Unix epoch in microseconds.
+#define EPOCH_DIFFERENCE_US  11644473600000000ULL
+#endif // defined(POSIX) && POSIX == 1
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value);
+static uint8_t *put_float(uint8_t *p, float value);
+static uint32_t get_u32(const uint8_t *p);
+static float get_float(const uint8_t *p);
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+uint32_t aoa_record_encode(const aoa_record_t *record, uint8_t *frame)
+{
+  uint8_t *p = frame;
+
+  *p++ = (uint8_t)AOA_RECORD_LEN;
+  *p++ = (uint8_t)(AOA_RECORD_LEN >> 8);
+  *p++ = AOA_RECORD_VERSION;
+  *p++ = AOA_RECORD_TYPE_ANGLE;
+  *p++ = record->tag_address_type;
+  *p++ = record->locator_address_type;
+  memcpy(p, record->tag_address, ADR_LEN);
+  p += ADR_LEN;
+  memcpy(p, record->locator_address, ADR_LEN);
+  p += ADR_LEN;
+  p = put_u32(p, (uint32_t)record->angle.sequence);
+  p = put_u32(p, record->angle.quality);
+  p = put_float(p, record->angle.azimuth);
+  p = put_float(p, record->angle.elevation);
+  p = put_float(p, record->angle.distance);
+  p = put_u32(p, (uint32_t)record->timestamp);
+  p = put_u32(p, (uint32_t)(record->timestamp >> 32));
+
+  return (uint32_t)(p - frame);
+}
+
+sl_status_t aoa_record_decode(const uint8_t *frame,
+                              uint32_t len,
+                              aoa_record_t *record,
+                              uint32_t *frame_len)
+{
+  const uint8_t *p = frame + AOA_RECORD_PREFIX_LEN;
+  uint32_t record_len;
+
+  if (len < AOA_RECORD_PREFIX_LEN) {
+    return SL_STATUS_WOULD_BLOCK;
+  }
+  record_len = (uint32_t)frame[0] | (uint32_t)frame[1] << 8;
+  *frame_len = AOA_RECORD_PREFIX_LEN + record_len;
+  if (len < *frame_len) {
+    return SL_STATUS_WOULD_BLOCK;
+  }
+  if (record_len < 2) {
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  record->version = p[0];
+  record->type = p[1];
+  if (record->version != AOA_RECORD_VERSION
+      || record->type != AOA_RECORD_TYPE_ANGLE) {
+    return SL_STATUS_NOT_SUPPORTED;
+  }
+  if (record_len < AOA_RECORD_LEN) {
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  record->tag_address_type = p[2];
+  record->locator_address_type = p[3];
+  memcpy(record->tag_address, &p[4], ADR_LEN);
+  memcpy(record->locator_address, &p[10], ADR_LEN);
+  record->angle.sequence = (int32_t)get_u32(&p[16]);
+  record->angle.quality = get_u32(&p[20]);
+  record->angle.azimuth = get_float(&p[24]);
+  record->angle.elevation = get_float(&p[28]);
+  record->angle.distance = get_float(&p[32]);
+  record->timestamp = (uint64_t)get_u32(&p[36])
+                      | (uint64_t)get_u32(&p[40]) << 32;
+
+  return SL_STATUS_OK;
+}
+
+uint64_t aoa_record_timestamp(void)
+{
+#if defined(POSIX) && POSIX == 1
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#else // defined(POSIX) && POSIX == 1
+  FILETIME ft;
+  uint64_t t;
+  GetSystemTimeAsFileTime(&ft);
+  // 100 ns intervals since 1601.
+  t = (uint64_t)ft.dwHighDateTime << 32 | ft.dwLowDateTime;
+  return t / 10 - EPOCH_DIFFERENCE_US;
+#endif // defined(POSIX) && POSIX == 1
+}
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value)
+{
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+  return p + 4;
+}
+
+static uint8_t *put_float(uint8_t *p, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return put_u32(p, bits);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8
+         | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static float get_float(const uint8_t *p)
+{
+  uint32_t bits = get_u32(p);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
@@ -0,0 +1,113 @@
+/***************************************************************************//**
+ * @file
+ * @brief Binary angle record header file
+ *
+ * Compact alternative to the JSON output of the locator. Every angle result
+ * is sent as one frame: the record length (uint16_t) followed by a fixed size
+ * record. All fields are little endian, Bluetooth addresses are in the same
+ * byte order as in bd_addr (least significant byte first).
+ *
+ *   Offset  Size  Field
+ *        0     1  Version (AOA_RECORD_VERSION)
+ *        1     1  Record type (aoa_record_type_t)
+ *        2     1  Tag address type
+ *        3     1  Locator address type
+ *        4     6  Tag address
+ *       10     6  Locator address
+ *       16     4  Sequence number (int32_t)
+ *       20     4  Quality (uint32_t)
+ *       24     4  Azimuth in degrees (float)
+ *       28     4  Elevation in degrees (float)
+ *       32     4  Distance in meters (float)
+ *       36     8  Receive time in microseconds since the Unix epoch
+ *
+ * Readers must skip frames with an unknown version or type using the length
+ * prefix. Fields may only be appended in later versions.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef AOA_RECORD_H
+#define AOA_RECORD_H
+
+#include <stdint.h>
+#include "aoa_types.h"
+#include "aoa_util.h"
+#include "sl_status.h"
+
+#define AOA_RECORD_VERSION     1
+#define AOA_RECORD_PREFIX_LEN  2
+#define AOA_RECORD_LEN         44
+// Size of one frame on the wire.
+#define AOA_RECORD_FRAME_LEN   (AOA_RECORD_PREFIX_LEN + AOA_RECORD_LEN)
+
+typedef enum {
+  AOA_RECORD_TYPE_ANGLE = 1
+} aoa_record_type_t;
+
+typedef struct {
+  uint8_t version;
+  uint8_t type;
+  uint8_t tag_address_type;
+  uint8_t locator_address_type;
+  uint8_t tag_address[ADR_LEN];
+  uint8_t locator_address[ADR_LEN];
+  aoa_angle_t angle;
+  uint64_t timestamp;
+} aoa_record_t;
+
+/**************************************************************************//**
+ * Serialize a record into a frame, including the length prefix.
+ * @param[in] record Record to serialize, version and type are set here.
+ * @param[out] frame Buffer of at least AOA_RECORD_FRAME_LEN bytes.
+ * @return Number of bytes written to the buffer.
+ *****************************************************************************/
+uint32_t aoa_record_encode(const aoa_record_t *record, uint8_t *frame);
+
+/**************************************************************************//**
+ * Parse a frame.
+ * @param[in] frame Received bytes starting with the length prefix.
+ * @param[in] len Number of received bytes.
+ * @param[out] record Parsed record.
+ * @param[out] frame_len Length of the whole frame, set unless the prefix is
+ *                       incomplete. It tells how many bytes to skip.
+ * @retval SL_STATUS_OK The record is parsed.
+ * @retval SL_STATUS_WOULD_BLOCK The frame is not complete yet.
+ * @retval SL_STATUS_NOT_SUPPORTED Unknown version or type, skip the frame.
+ * @retval SL_STATUS_INVALID_PARAMETER The frame is too short for a record.
+ *****************************************************************************/
+sl_status_t aoa_record_decode(const uint8_t *frame,
+                              uint32_t len,
+                              aoa_record_t *record,
+                              uint32_t *frame_len);
+
+/**************************************************************************//**
+ * Return the current time for the timestamp field.
+ * @return Microseconds since the Unix epoch.
+ *****************************************************************************/
+uint64_t aoa_record_timestamp(void);
+
+#endif // AOA_RECORD_H
@@ -0,0 +1,185 @@
+/***************************************************************************//**
+ * @file
+ * @brief Shared memory ring of angle records
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "aoa_shm.h"
+
+#if defined(POSIX) && POSIX == 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // defined(POSIX) && POSIX == 1
+
+#if defined(POSIX) && POSIX == 1
+static void close_stale(const char *name);
+#endif // defined(POSIX) && POSIX == 1
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+#if defined(POSIX) && POSIX == 1
+int32_t aoa_shm_create(aoa_shm_t *shm, const char *name, uint32_t slot_count)
+{
+  uint32_t count = 1;
+  void *mem;
+  int fd;
+
+  memset(shm, 0, sizeof(*shm));
+  if (strlen(name) >= sizeof(shm->name) || slot_count > AOA_SHM_SLOT_COUNT_MAX) {
+    return -1;
+  }
+  while (count < slot_count) {
+    count <<= 1;
+  }
+  strcpy(shm->name, name);
+  shm->size = AOA_SHM_HEADER_SIZE + count * AOA_SHM_SLOT_SIZE;
+
+  // A new segment, so that the readers of a previous one are not affected.
+  // A writer that crashed left its segment open, close it for its readers.
+  close_stale(name);
+  shm_unlink(name);
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+  if (ftruncate(fd, (off_t)shm->size) != 0) {
+    close(fd);
+    shm_unlink(name);
+    return -1;
+  }
+  mem = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    shm_unlink(name);
+    return -1;
+  }
+
+  // The segment is zero filled, the magic is set last.
+  shm->header = (aoa_shm_header_t *)mem;
+  shm->slots = (aoa_shm_slot_t *)((uint8_t *)mem + AOA_SHM_HEADER_SIZE);
+  shm->header->version = AOA_SHM_VERSION;
+  shm->header->slot_size = AOA_SHM_SLOT_SIZE;
+  shm->header->slot_count = count;
+  __atomic_store_n(&shm->header->magic, AOA_SHM_MAGIC, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void aoa_shm_write(aoa_shm_t *shm, const uint8_t *frame, uint32_t len)
+{
+  uint64_t n = shm->head;
+  aoa_shm_slot_t *slot = &shm->slots[n & (shm->header->slot_count - 1)];
+
+  if (len > sizeof(slot->frame)) {
+    len = sizeof(slot->frame);
+  }
+  // Readers that see the odd counter, or see it change, skip the slot.
+  __atomic_store_n(&slot->sequence, 2 * n + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(slot->frame, frame, len);
+  __atomic_store_n(&slot->sequence, 2 * n + 2, __ATOMIC_RELEASE);
+  shm->head = n + 1;
+  __atomic_store_n(&shm->header->head, shm->head, __ATOMIC_RELEASE);
+}
+
+void aoa_shm_close(aoa_shm_t *shm)
+{
+  if (shm->header == NULL) {
+    return;
+  }
+  __atomic_store_n(&shm->header->closed, 1, __ATOMIC_RELEASE);
+  munmap(shm->header, shm->size);
+  shm_unlink(shm->name);
+  shm->header = NULL;
+  shm->slots = NULL;
+}
+#else // defined(POSIX) && POSIX == 1
+int32_t aoa_shm_create(aoa_shm_t *shm, const char *name, uint32_t slot_count)
+{
+  (void)name;
+  (void)slot_count;
+  memset(shm, 0, sizeof(*shm));
+  fprintf(stderr, "Shared memory output is not supported on this platform.\n");
+  return -1;
+}
+
+void aoa_shm_write(aoa_shm_t *shm, const uint8_t *frame, uint32_t len)
+{
+  (void)shm;
+  (void)frame;
+  (void)len;
+}
+
+void aoa_shm_close(aoa_shm_t *shm)
+{
+  shm->header = NULL;
+}
+#endif // defined(POSIX) && POSIX == 1
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+#if defined(POSIX) && POSIX == 1
+// Mark an existing segment of the name closed, so that its readers stop
+// waiting for records.
+static void close_stale(const char *name)
+{
+  aoa_shm_header_t *header;
+  struct stat st;
+  int fd;
+
+  fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0) {
+    return;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < AOA_SHM_HEADER_SIZE) {
+    close(fd);
+    return;
+  }
+  header = mmap(NULL, AOA_SHM_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+  close(fd);
+  if (header == MAP_FAILED) {
+    return;
+  }
+  if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == AOA_SHM_MAGIC) {
+    __atomic_store_n(&header->closed, 1, __ATOMIC_RELEASE);
+  }
+  munmap(header, AOA_SHM_HEADER_SIZE);
+}
+#endif // defined(POSIX) && POSIX == 1
+
+
+bool aoa_shm_is_open(const aoa_shm_t *shm)
+{
+  return shm->header != NULL;
+}
@@ -0,0 +1,132 @@
+/***************************************************************************//**
+ * @file
+ * @brief Shared memory ring of angle records header file
+ *
+ * The locator publishes the binary angle records (see aoa_record.h) in a
+ * named POSIX shared memory segment, for consumers on the same host. The
+ * segment holds a header followed by a ring of fixed size slots:
+ *
+ *   Offset  Size  Field
+ *        0     4  Magic (AOA_SHM_MAGIC), set once the segment is ready
+ *        4     2  Version (AOA_SHM_VERSION)
+ *        6     2  Slot size (AOA_SHM_SLOT_SIZE)
+ *        8     4  Slot count, a power of 2
+ *       12     4  Closed, set when the locator stops publishing
+ *       64     8  Head: number of records published so far
+ *      128        Slots
+ *
+ * A slot is one cache line: a sequence counter (uint64_t) followed by one
+ * record frame. Record n goes to slot n % slot count. The sequence counter
+ * of its slot is 2n + 1 while the record is written and 2n + 2 once it is
+ * complete. There is a single writer and any number of readers. Readers
+ * only read the segment: a reader checks that the counter is the same
+ * before and after copying a record, and a reader that falls more than a
+ * ring behind loses the records overwritten in the meantime.
+ *
+ * All fields are in host byte order, the segment is not meant to leave the
+ * host.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef AOA_SHM_H
+#define AOA_SHM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aoa_record.h"
+
+#define AOA_SHM_MAGIC               0x4d485341  // "ASHM"
+#define AOA_SHM_VERSION             1
+#define AOA_SHM_SLOT_SIZE           64
+#define AOA_SHM_HEADER_SIZE         128
+// Default and maximum number of slots.
+#define AOA_SHM_SLOT_COUNT_DEFAULT  4096
+#define AOA_SHM_SLOT_COUNT_MAX      65536
+// Default segment name.
+#define AOA_SHM_NAME_DEFAULT        "/aoa_locator"
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t slot_size;
+  uint32_t slot_count;
+  uint32_t closed;
+  uint8_t reserved0[48];
+  // The head is on a cache line of its own.
+  uint64_t head;
+  uint8_t reserved1[56];
+} aoa_shm_header_t;
+
+typedef struct {
+  uint64_t sequence;
+  uint8_t frame[AOA_SHM_SLOT_SIZE - sizeof(uint64_t)];
+} aoa_shm_slot_t;
+
+// Segment being written.
+typedef struct {
+  aoa_shm_header_t *header;
+  aoa_shm_slot_t *slots;
+  uint32_t size;              // Size of the mapping
+  uint64_t head;              // Records published
+  char name[64];
+} aoa_shm_t;
+
+/**************************************************************************//**
+ * Create a segment. An existing segment of the same name is marked closed,
+ * also one left by a writer that crashed, then replaced. Its readers see it
+ * closed.
+ * @param[out] shm Segment state
+ * @param[in] name Name of the segment, starting with '/'.
+ * @param[in] slot_count Number of slots, rounded up to a power of 2.
+ * @return 0 on success, -1 on failure.
+ *****************************************************************************/
+int32_t aoa_shm_create(aoa_shm_t *shm, const char *name, uint32_t slot_count);
+
+/**************************************************************************//**
+ * Publish a record frame. The oldest record is overwritten when the ring is
+ * full, the writer never waits for the readers.
+ * @param[in] shm Segment state
+ * @param[in] frame Record frame, see aoa_record_encode.
+ * @param[in] len Length of the frame, at most the frame size of a slot.
+ *****************************************************************************/
+void aoa_shm_write(aoa_shm_t *shm, const uint8_t *frame, uint32_t len);
+
+/**************************************************************************//**
+ * Mark the segment closed and remove it. Mapped readers keep their mapping
+ * until they close it.
+ * @param[in] shm Segment state
+ *****************************************************************************/
+void aoa_shm_close(aoa_shm_t *shm);
+
+/**************************************************************************//**
+ * Check whether the segment is open.
+ * @param[in] shm Segment state
+ * @return true if the segment is open.
+ *****************************************************************************/
+bool aoa_shm_is_open(const aoa_shm_t *shm);
+
+#endif // AOA_SHM_H
@@ -0,0 +1,129 @@
+/***************************************************************************//**
+ * @file
+ * @brief Shared memory angle record reader
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "aoa_shm_reader.h"
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+int32_t aoa_shm_reader_open(aoa_shm_reader_t *reader, const char *name)
+{
+  const aoa_shm_header_t *header;
+  struct stat st;
+  void *mem;
+  int fd;
+
+  memset(reader, 0, sizeof(*reader));
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size < AOA_SHM_HEADER_SIZE) {
+    close(fd);
+    return -1;
+  }
+  mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    return -1;
+  }
+  header = (const aoa_shm_header_t *)mem;
+  if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != AOA_SHM_MAGIC
+      || header->version != AOA_SHM_VERSION
+      || header->slot_size != AOA_SHM_SLOT_SIZE
+      || (uint64_t)st.st_size < AOA_SHM_HEADER_SIZE
+      + (uint64_t)header->slot_count * AOA_SHM_SLOT_SIZE) {
+    munmap(mem, (size_t)st.st_size);
+    return -1;
+  }
+  reader->header = header;
+  reader->slots = (const aoa_shm_slot_t *)((const uint8_t *)mem
+                                           + AOA_SHM_HEADER_SIZE);
+  reader->size = (uint32_t)st.st_size;
+  reader->next = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+  return 0;
+}
+
+int32_t aoa_shm_reader_read(aoa_shm_reader_t *reader, aoa_record_t *record)
+{
+  const aoa_shm_header_t *header = reader->header;
+  const aoa_shm_slot_t *slot;
+  uint8_t frame[sizeof(slot->frame)];
+  uint32_t frame_len;
+  uint64_t head;
+  uint64_t sequence;
+
+  for (;;) {
+    // Check the closed flag first, so that no record is missed after it.
+    uint32_t closed = __atomic_load_n(&header->closed, __ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    if (reader->next == head) {
+      return closed ? -1 : 0;
+    }
+    if (head - reader->next > header->slot_count) {
+      // Fallen behind by more than a ring.
+      reader->lost += head - header->slot_count - reader->next;
+      reader->next = head - header->slot_count;
+    }
+    slot = &reader->slots[reader->next & (header->slot_count - 1)];
+    sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if (sequence == 2 * reader->next + 2) {
+      memcpy(frame, slot->frame, sizeof(frame));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) {
+        reader->next++;
+        if (aoa_record_decode(frame, sizeof(frame), record, &frame_len)
+            == SL_STATUS_OK) {
+          return 1;
+        }
+        // Not an angle record of this version, skip it.
+        continue;
+      }
+    }
+    // The slot is written again by now, the record is lost.
+    reader->lost++;
+    reader->next++;
+  }
+}
+
+void aoa_shm_reader_close(aoa_shm_reader_t *reader)
+{
+  if (reader->header != NULL) {
+    munmap((void *)reader->header, reader->size);
+    reader->header = NULL;
+    reader->slots = NULL;
+  }
+}
@@ -0,0 +1,87 @@
+/***************************************************************************//**
+ * @file
+ * @brief Shared memory angle record reader header file
+ *
+ * Reader library for the shared memory ring published by the locator, see
+ * aoa_shm.h. Reading a record is a few loads and a copy of one cache line,
+ * without system calls. The library only needs aoa_shm_reader.c and
+ * aoa_record.c, link with -lrt on older C libraries.
+ *
+ * Example:
+ *
+ *   aoa_shm_reader_t reader;
+ *   aoa_record_t record;
+ *
+ *   if (aoa_shm_reader_open(&reader, AOA_SHM_NAME_DEFAULT) == 0) {
+ *     while (aoa_shm_reader_read(&reader, &record) >= 0) {
+ *       ...
+ *     }
+ *     aoa_shm_reader_close(&reader);
+ *   }
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef AOA_SHM_READER_H
+#define AOA_SHM_READER_H
+
+#include <stdint.h>
+#include "aoa_shm.h"
+
+typedef struct {
+  const aoa_shm_header_t *header;
+  const aoa_shm_slot_t *slots;
+  uint32_t size;              // Size of the mapping
+  uint64_t next;              // Number of the next record to read
+  uint64_t lost;              // Records overwritten before they were read
+} aoa_shm_reader_t;
+
+/**************************************************************************//**
+ * Map a segment for reading. The reader starts at the next record
+ * published.
+ * @param[out] reader Reader state
+ * @param[in] name Name of the segment, starting with '/'.
+ * @return 0 on success, -1 if the segment does not exist or is not ready.
+ *****************************************************************************/
+int32_t aoa_shm_reader_open(aoa_shm_reader_t *reader, const char *name);
+
+/**************************************************************************//**
+ * Read the next record without waiting.
+ * @param[in] reader Reader state
+ * @param[out] record Record read.
+ * @return 1 if a record is read, 0 if there is no new record, -1 if the
+ *         segment is closed and all its records are read. Open the segment
+ *         again to follow a restarted locator.
+ *****************************************************************************/
+int32_t aoa_shm_reader_read(aoa_shm_reader_t *reader, aoa_record_t *record);
+
+/**************************************************************************//**
+ * Unmap the segment.
+ * @param[in] reader Reader state
+ *****************************************************************************/
+void aoa_shm_reader_close(aoa_shm_reader_t *reader);
+
+#endif // AOA_SHM_READER_H
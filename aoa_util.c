@@ -34,6 +34,12 @@
 #include <strings.h>
 #include "aoa_util.h"
 
+#if defined(POSIX) && POSIX == 1
+#include <time.h>
+#else // defined(POSIX) && POSIX == 1
+#include <windows.h>
+#endif // defined(POSIX) && POSIX == 1
+
 // Adjust maximal allowlist size if needed.
 #define MAX_ALLOWLIST_SIZE 73
 static uint8_t allowlist[MAX_ALLOWLIST_SIZE][ADR_LEN];
@@ -210,6 +216,25 @@ int32_t aoa_sequence_compare(int32_t seq1, int32_t seq2)
   return (diff < ((UINT16_MAX + 1) / 2)) ? diff : UINT16_MAX + 1 - diff;
 }
 
+/**************************************************************************//**
+ * Get a monotonic timestamp.
+ *****************************************************************************/
+uint64_t aoa_time_us(void)
+{
+#if defined(POSIX) && POSIX == 1
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#else // defined(POSIX) && POSIX == 1
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)(count.QuadPart / frequency.QuadPart * 1000000
+                    + count.QuadPart % frequency.QuadPart * 1000000
+                    / frequency.QuadPart);
+#endif // defined(POSIX) && POSIX == 1
+}
+
 /***************************************************************************//**
  * Find given service UUID in an Advertising or Scan Response packet.
  ******************************************************************************/
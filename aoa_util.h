@@ -59,6 +59,13 @@ void aoa_allowlist_init(void);
  *****************************************************************************/
 int32_t aoa_sequence_compare(int32_t seq1, int32_t seq2);
 
+/**************************************************************************//**
+ * Get a monotonic timestamp, for timeouts and time measurements.
+ *
+ * @return Time in microseconds since an arbitrary start.
+ *****************************************************************************/
+uint64_t aoa_time_us(void);
+
 /***************************************************************************//**
  * Find given service UUID in an Advertising or Scan Response packet.
  *
@@ -33,31 +33,45 @@
 #include <string.h>
 #include <unistd.h>
 #include "sl_bt_api.h"
+#include "sl_bt_ncp_host.h"
 #include "ncp_host.h"
 #include "app_log.h"
 #include "app_log_cli.h"
 #include "app_assert.h"
 #include "app.h"
-#include "tcp.h"
+#include "system.h"
+#include "output.h"
+#include "throttle.h"
+#include "worker.h"
+#include "overload.h"
 
 #include "conn.h"
 #include "aoa_parse.h"
 #include "aoa_util.h"
+#include "aoa_record.h"
+#include "aoa_json.h"
+#if defined(POSIX) && POSIX == 1
+#include "app_poll.h"
+#endif // defined(POSIX) && POSIX == 1
 #ifdef AOA_ANGLE
 #include "aoa_angle.h"
 #endif // AOA_ANGLE
 
 // Optstring argument for getopt.
-#define OPTSTRING      NCP_HOST_OPTSTRING APP_LOG_OPTSTRING "s:c:ph"
+#define OPTSTRING      NCP_HOST_OPTSTRING APP_LOG_OPTSTRING OUTPUT_OPTSTRING THROTTLE_OPTSTRING WORKER_OPTSTRING OVERLOAD_OPTSTRING "s:c:ph"
 
 // Usage info.
-#define USAGE          APP_LOG_NL "%s " NCP_HOST_USAGE APP_LOG_USAGE "[-s <server_address>[:<port>]] [-c <config>] [-p] [-h]" APP_LOG_NL
+#define USAGE          APP_LOG_NL "%s " NCP_HOST_USAGE APP_LOG_USAGE OUTPUT_USAGE THROTTLE_USAGE WORKER_USAGE OVERLOAD_USAGE "[-s <server_address>[:<port>]] [-c <config>] [-p] [-h]" APP_LOG_NL
 
 // Options info.
 #define OPTIONS                                                                  \
   "\nOPTIONS\n"                                                                  \
   NCP_HOST_OPTIONS                                                               \
   APP_LOG_OPTIONS                                                                \
+  OUTPUT_OPTIONS                                                                 \
+  THROTTLE_OPTIONS                                                               \
+  WORKER_OPTIONS                                                                 \
+  OVERLOAD_OPTIONS                                                               \
   "    -s  Socket connection parameters.\n"                                      \
   "        <server_address> Address of the socket server (default: 127.0.0.1)\n" \
   "        <port>           Port of the socket server (default: 8080)\n"         \
@@ -67,20 +81,26 @@
   "    -h  Print this help message.\n"
 
 static void parse_config(char *filename);
-
-// Locator ID
-static aoa_id_t locator_id;
+static void log_statistics(void);
+static void on_angle(conn_properties_t *tag, enum sl_rtl_error_code ec,
+                     aoa_angle_t *angle, uint64_t timestamp);
+static void on_estimate(worker_job_t *job);
+static uint64_t output_key(conn_properties_t *tag);
+static uint32_t ncp_queue_depth(void);
+
+// Locator ID and address of each NCP instance
+static aoa_id_t locator_id[SL_BT_API_MAX_INSTANCES];
+static bd_addr locator_address[SL_BT_API_MAX_INSTANCES];
+static uint8_t locator_address_type[SL_BT_API_MAX_INSTANCES];
+
+// Maximum time to sleep in the main loop in milliseconds. It bounds the
+// shutdown latency if a signal arrives right before going to sleep.
+#define APP_IDLE_TIMEOUT   1000
 
 // Socket
-#define SOCKET_BUFFER_SIZE 1024
+#define SOCKET_BUFFER_SIZE OUTPUT_RESULT_MAX_LEN
 #define PORT_DIGIT_LEN 6
-static char *host, port_str[PORT_DIGIT_LEN] = "8080", payload[SOCKET_BUFFER_SIZE];
-#if defined(POSIX) && POSIX == 1
-static int32_t handle = -1;
-#else // defined(POSIX) && POSIX == 1
-#include <windows.h>
-static SOCKET handle = -1;
-#endif // defined(POSIX) && POSIX == 1
+static char *host, port_str[PORT_DIGIT_LEN] = "8080", payload[AOA_JSON_MAX_LEN];
 
 bool print = false;
 
@@ -128,6 +148,18 @@ void app_init(int argc, char *argv[])
         if (sc == SL_STATUS_NOT_FOUND) {
           sc = app_log_set_option((char)opt, optarg);
         }
+        if (sc == SL_STATUS_NOT_FOUND) {
+          sc = output_set_option((char)opt, optarg);
+        }
+        if (sc == SL_STATUS_NOT_FOUND) {
+          sc = throttle_set_option((char)opt, optarg);
+        }
+        if (sc == SL_STATUS_NOT_FOUND) {
+          sc = worker_set_option((char)opt, optarg);
+        }
+        if (sc == SL_STATUS_NOT_FOUND) {
+          sc = overload_set_option((char)opt, optarg);
+        }
         if (sc != SL_STATUS_OK) {
           app_log(USAGE, argv[0]);
           exit(EXIT_FAILURE);
@@ -145,14 +177,41 @@ void app_init(int argc, char *argv[])
   app_assert_status(sc);
   app_log_info("NCP host initialised." APP_LOG_NL);
   app_log_info("Resetting NCP target..." APP_LOG_NL);
-  // Reset NCP to ensure it gets into a defined state.
-  // Once the chip successfully boots, boot event should be received.
-  sl_bt_system_reset(sl_bt_system_boot_mode_normal);
+  // Reset NCPs to ensure they get into a defined state.
+  // Once a chip successfully boots, boot event should be received.
+  for (uint8_t i = 0; i < sl_bt_api_get_instance_count(); i++) {
+    sl_bt_api_select_instance(i);
+    sl_bt_system_reset(sl_bt_system_boot_mode_normal);
+  }
 
   init_connection();
+
+  // Start the angle estimation workers, if any.
+  sc = worker_init(on_estimate);
+  app_assert_status(sc);
+  overload_init(aoa_mode, worker_get_count());
   app_log_info("Press Crtl+C to quit" APP_LOG_NL APP_LOG_NL);
 }
 
+/**************************************************************************//**
+ * Application Process Action.
+ *****************************************************************************/
+void app_process_action(void)
+{
+  // Send the results of this round before going to sleep.
+  if (!sl_bt_event_pending()) {
+    output_flush();
+  }
+#if defined(POSIX) && POSIX == 1
+  // Sleep until the NCP, the socket or a timer needs attention. Do not sleep
+  // if there is still work left from the previous round.
+  app_poll_wait(sl_bt_event_pending() ? 0 : APP_IDLE_TIMEOUT);
+#else // defined(POSIX) && POSIX == 1
+  // Without a poll loop, the load is checked on every round.
+  overload_poll();
+#endif // defined(POSIX) && POSIX == 1
+}
+
 /**************************************************************************//**
  * Application Deinit.
  *****************************************************************************/
@@ -162,9 +221,10 @@ void app_deinit(void)
   if (!freed) {
     app_log_info("Shutting down." APP_LOG_NL);
     ncp_host_deinit();
-    if (handle != -1) {
-      tcp_close(&handle);
-    }
+    // The estimates still queued go to the output before it is closed.
+    worker_deinit();
+    output_close();
+    log_statistics();
     if (host != NULL) {
       free(host);
     }
@@ -181,7 +241,6 @@ void app_deinit(void)
 void sl_bt_on_event(sl_bt_msg_t *evt)
 {
   sl_status_t sc;
-  int rc;
   bd_addr address;
   uint8_t address_type;
 
@@ -205,13 +264,14 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
                  address.addr[1],
                  address.addr[0]);
 
-    aoa_address_to_id(address.addr, address_type, locator_id);
+    aoa_address_to_id(address.addr, address_type, locator_id[sl_bt_api_get_instance()]);
+    locator_address[sl_bt_api_get_instance()] = address;
+    locator_address_type[sl_bt_api_get_instance()] = address_type;
 
-    // Connect to the socket server
-    rc = tcp_open(&handle, host, port_str);
-    if (rc < 0) {
-      app_deinit();
-      exit(EXIT_FAILURE);
+    // Connect to the socket server, shared by all locators.
+    if (!output_is_open()) {
+      sc = output_open(host, port_str);
+      app_assert_status(sc);
     }
   }
   // ...then call the connection specific event handler.
@@ -223,45 +283,305 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
  *****************************************************************************/
 void app_on_iq_report(conn_properties_t *tag, aoa_iq_report_t *iq_report)
 {
-  // aoa_id_t tag_id;
-  int rc;
   enum sl_rtl_error_code ec;
+  enum sl_rtl_aox_mode mode;
   aoa_angle_t angle;
+  uint64_t timestamp;
+  uint64_t start;
+
+  // Under overload, reports are skipped and the estimator mode is cheaper.
+  if (!overload_admit(&tag->reports, &mode)) {
+    return;
+  }
+
+  // Time of reception, taken before the estimation.
+  timestamp = aoa_record_timestamp();
+
+  if (worker_get_count() > 0) {
+    // The worker of the tag estimates the angle, see on_estimate. A report
+    // dropped with the queue full is counted in the worker statistics.
+    (void)worker_submit(tag, iq_report, mode, timestamp);
+    return;
+  }
+
+  start = aoa_time_us();
+  ec = aoa_set_mode(&tag->aoa_state, mode);
+  if (ec == SL_RTL_ERROR_SUCCESS) {
+    ec = aoa_calculate(&tag->aoa_state, iq_report, &angle);
+  }
+  // The events waiting in the fullest NCP queue are the backlog, so that a
+  // board that falls behind is not hidden by the others.
+  overload_update((uint32_t)(aoa_time_us() - start),
+                  sl_bt_api_get_max_queue_level() * 100 / ncp_queue_depth());
+  on_angle(tag, ec, &angle, timestamp);
+}
+
+/**************************************************************************//**
+ * Estimate handler of the workers.
+ *****************************************************************************/
+static void on_estimate(worker_job_t *job)
+{
+  overload_update(job->estimate_us, worker_get_backlog());
+  on_angle(job->tag, job->ec, &job->angle, job->timestamp);
+}
+
+/**************************************************************************//**
+ * Number of events the NCP event queues can hold, the same for all.
+ *****************************************************************************/
+static uint32_t ncp_queue_depth(void)
+{
+  static uint32_t depth = 0;
+  sl_bt_api_queue_stats_t queue_stats;
+
+  if (depth == 0) {
+    sl_bt_api_get_queue_stats(&queue_stats);
+    depth = (queue_stats.depth > 0) ? queue_stats.depth : 1;
+  }
+  return depth;
+}
 
-  // aoa_address_to_id(tag->address.addr, tag->address_type, tag_id);
+/**************************************************************************//**
+ * Output the estimated angle of a tag.
+ *****************************************************************************/
+static void on_angle(conn_properties_t *tag, enum sl_rtl_error_code ec,
+                     aoa_angle_t *angle, uint64_t timestamp)
+{
+  uint32_t len;
+  sl_status_t sc;
+  aoa_record_t record;
+  uint8_t frame[AOA_RECORD_FRAME_LEN];
+  output_result_t result;
+  uint32_t formats;
 
-  ec = aoa_calculate(&tag->aoa_state, iq_report, &angle);
   if (ec == SL_RTL_ERROR_ESTIMATION_IN_PROGRESS) {
     // No valid angles are available yet.
     return;
   }
+  if (ec == AOA_ERROR_SAMPLES_REJECTED) {
+    // The samples failed the check before the estimator, see the statistics.
+    return;
+  }
   app_assert(ec == SL_RTL_ERROR_SUCCESS,
              "[E: %d] Failed to calculate angle" APP_LOG_NL, ec);
 
   // Store the latest sequence number for the tag.
-  tag->sequence = iq_report->event_counter;
+  tag->sequence = angle->sequence;
 
-  // Compile payload
-  rc = snprintf(payload, SOCKET_BUFFER_SIZE,
-                "{\n\t\"timeStamp\": %d,\n\t\"type\": \"auditory\", \n\t\"tagId\": \"%02X\",\n\t\"azimuth\": %f,\n\t\"distance\": %f,\n\t\"elevation\": %f,\n\t\"quality\": %u\n}\r\n",
-                angle.sequence, tag->address.addr[0], angle.azimuth, angle.distance, angle.elevation, angle.quality);
+  // The estimation runs on every report, the output may be limited.
+  if (!throttle_process(&tag->throttle, angle)) {
+    return;
+  }
 
-  if (rc > SOCKET_BUFFER_SIZE) {
-    app_log_error("Payload is incomplete. Please increase SOCKET_BUFFER_SIZE." APP_LOG_NL);
-    app_deinit();
-    exit(EXIT_FAILURE);
+  // Compile the payloads needed by the sinks, once for all of them.
+  formats = output_get_formats();
+  memset(&result, 0, sizeof(result));
+  result.key = output_key(tag);
+  result.locator_id = locator_id[tag->locator];
+  result.tag_id = tag->id;
+  if (formats & (1u << OUTPUT_FORMAT_BINARY)) {
+    record.tag_address_type = tag->address_type;
+    record.locator_address_type = locator_address_type[tag->locator];
+    memcpy(record.tag_address, tag->address.addr, ADR_LEN);
+    memcpy(record.locator_address, locator_address[tag->locator].addr, ADR_LEN);
+    record.angle = *angle;
+    record.timestamp = timestamp;
+    result.len[OUTPUT_FORMAT_BINARY] = aoa_record_encode(&record, frame);
+    result.data[OUTPUT_FORMAT_BINARY] = frame;
   }
+  if ((formats & (1u << OUTPUT_FORMAT_JSON)) || print) {
+    // The locator ID tells the boards apart. A single board keeps the
+    // format of the results without it.
+    len = aoa_json_encode((sl_bt_api_get_instance_count() > 1)
+                          ? locator_id[tag->locator] : NULL,
+                          tag->address.addr[0], angle, payload);
+
+    if (len > SOCKET_BUFFER_SIZE) {
+      app_log_error("Payload is incomplete. Please increase SOCKET_BUFFER_SIZE." APP_LOG_NL);
+      app_deinit();
+      exit(EXIT_FAILURE);
+    }
+    result.len[OUTPUT_FORMAT_JSON] = len;
+    result.data[OUTPUT_FORMAT_JSON] = (uint8_t *)payload;
 
-  if (print) {
-    printf("%s", payload);
+    if (print) {
+      fwrite(payload, 1, len, stdout);
+    }
   }
 
   // Send message
-  rc = tcp_tx(&handle, strlen(payload), (uint8_t *)&payload);
-  if (rc < 0) {
-    app_log_info("Connection Closed." APP_LOG_NL);
-    app_deinit();
-    exit(EXIT_SUCCESS);
+  sc = output_write(&result);
+  app_assert_status(sc);
+}
+
+/**************************************************************************//**
+ * Output key of a tag: the locator index, the address type and the address.
+ *****************************************************************************/
+static uint64_t output_key(conn_properties_t *tag)
+{
+  uint64_t key = (uint64_t)tag->locator << 56 | (uint64_t)tag->address_type << 48;
+
+  for (uint8_t i = 0; i < ADR_LEN; i++) {
+    key |= (uint64_t)tag->address.addr[i] << (8 * i);
+  }
+  return key;
+}
+
+/**************************************************************************//**
+ * Log runtime statistics.
+ *****************************************************************************/
+static void log_statistics(void)
+{
+  sl_bt_api_rx_stats_t rx_stats;
+  sl_bt_api_queue_stats_t queue_stats;
+  sl_system_dispatch_stats_t dispatch_stats;
+  output_stats_t output_stats;
+  throttle_stats_t throttle_stats;
+  worker_stats_t worker_stats;
+  overload_stats_t overload_stats;
+  aoa_reject_stats_t reject_stats;
+  uint8_t instance;
+  size_t i;
+
+  sl_system_get_dispatch_stats(&dispatch_stats);
+  app_log_info("Dispatch: %llu events in %u passes, %u passes empty, max batch %u, %u passes at budget" APP_LOG_NL,
+               (unsigned long long)dispatch_stats.events,
+               dispatch_stats.passes,
+               dispatch_stats.empty,
+               dispatch_stats.max_batch,
+               dispatch_stats.budget_hits);
+  for (i = 0; i < SL_SYSTEM_BATCH_HIST_BINS; i++) {
+    if (dispatch_stats.histogram[i] == 0) {
+      continue;
+    }
+    if (i == 0) {
+      app_log_info("Dispatch: %u passes with 1 event" APP_LOG_NL,
+                   dispatch_stats.histogram[i]);
+    } else if (i < SL_SYSTEM_BATCH_HIST_BINS - 1) {
+      app_log_info("Dispatch: %u passes with %u-%u events" APP_LOG_NL,
+                   dispatch_stats.histogram[i], 1u << i, (2u << i) - 1);
+    } else {
+      app_log_info("Dispatch: %u passes with %u or more events" APP_LOG_NL,
+                   dispatch_stats.histogram[i], 1u << i);
+    }
+  }
+
+  for (i = 0; i < worker_get_count(); i++) {
+    worker_get_stats((uint32_t)i, &worker_stats);
+    app_log_info("Worker %u: %llu reports, %u dropped, max depth %u/%u" APP_LOG_NL,
+                 (unsigned)i,
+                 (unsigned long long)worker_stats.reports,
+                 worker_stats.dropped,
+                 worker_stats.max_queued,
+                 worker_stats.depth);
+  }
+
+  aoa_get_reject_stats(&reject_stats);
+  app_log_info("Samples: rejected %llu short, %llu saturated, %llu amplitude, %llu phase" APP_LOG_NL,
+               (unsigned long long)reject_stats.short_length,
+               (unsigned long long)reject_stats.saturated,
+               (unsigned long long)reject_stats.amplitude,
+               (unsigned long long)reject_stats.phase);
+
+  overload_get_stats(&overload_stats);
+  if (overload_stats.changes > 0 || overload_stats.decimated > 0) {
+    app_log_info("Overload: level %u, max level %u, %u level changes, %llu reports decimated" APP_LOG_NL,
+                 overload_stats.level,
+                 overload_stats.max_level,
+                 overload_stats.changes,
+                 (unsigned long long)overload_stats.decimated);
+    for (i = 0; i < OVERLOAD_LEVELS; i++) {
+      app_log_info("Overload: %llu intervals at level %u" APP_LOG_NL,
+                   (unsigned long long)overload_stats.intervals[i],
+                   (unsigned)i);
+    }
+  }
+
+  throttle_get_stats(&throttle_stats);
+  app_log_info("Throttle: %llu results, %llu output, %llu rate limited, %llu in deadband, %llu heartbeats" APP_LOG_NL,
+               (unsigned long long)throttle_stats.results,
+               (unsigned long long)throttle_stats.output,
+               (unsigned long long)throttle_stats.rate_limited,
+               (unsigned long long)throttle_stats.deadband,
+               (unsigned long long)throttle_stats.heartbeats);
+
+  for (i = 0; i < output_get_sink_count(); i++) {
+    const char *name = output_get_sink_name((uint32_t)i);
+    output_get_stats((uint32_t)i, &output_stats);
+    app_log_info("Output %s: %llu results, %llu bytes in %u writes, max batch %u" APP_LOG_NL,
+                 name,
+                 (unsigned long long)output_stats.results,
+                 (unsigned long long)output_stats.bytes,
+                 output_stats.writes,
+                 output_stats.max_batch);
+    if (output_stats.writes > 0) {
+      app_log_info("Output %s: %.2f results/write, %u idle, %u size, %u latency flushes" APP_LOG_NL,
+                   name,
+                   (float)output_stats.results / output_stats.writes,
+                   output_stats.flushes[OUTPUT_FLUSH_IDLE],
+                   output_stats.flushes[OUTPUT_FLUSH_SIZE],
+                   output_stats.flushes[OUTPUT_FLUSH_LATENCY]);
+    }
+    app_log_info("Output %s queue: %u results dropped, %u times blocked, max depth %u/%u" APP_LOG_NL,
+                 name,
+                 output_stats.dropped,
+                 output_stats.blocked,
+                 output_stats.max_queued,
+                 output_stats.depth);
+    app_log_info("Output %s connection: %u attempts, %u connects, %u lost" APP_LOG_NL,
+                 name,
+                 output_stats.attempts,
+                 output_stats.connects,
+                 output_stats.disconnects);
+    if (output_stats.dropped_offline > 0 || output_stats.unsent > 0) {
+      app_log_info("Output %s connection: %u results dropped while disconnected, %u not sent at exit" APP_LOG_NL,
+                   name,
+                   output_stats.dropped_offline,
+                   output_stats.unsent);
+    }
+    if (output_stats.acked > 0 || output_stats.resent > 0) {
+      app_log_info("Output %s MQTT: %llu results acknowledged, %u sent again after reconnecting" APP_LOG_NL,
+                   name,
+                   (unsigned long long)output_stats.acked,
+                   output_stats.resent);
+    }
+  }
+
+  for (instance = 0; instance < sl_bt_api_get_instance_count(); instance++) {
+    sl_bt_api_select_instance(instance);
+
+    sl_bt_api_get_rx_stats(&rx_stats);
+    app_log_info("NCP %u RX: %u frames, %llu bytes, %u reads, %u peeks, %u bytes discarded" APP_LOG_NL,
+                 instance,
+                 rx_stats.frames,
+                 (unsigned long long)rx_stats.bytes,
+                 rx_stats.reads,
+                 rx_stats.peeks,
+                 rx_stats.discarded);
+    if (rx_stats.frames > 0) {
+      app_log_info("NCP %u RX: %.2f reads/frame, %.2f peeks/frame" APP_LOG_NL,
+                   instance,
+                   (float)rx_stats.reads / rx_stats.frames,
+                   (float)rx_stats.peeks / rx_stats.frames);
+    }
+
+    sl_bt_api_get_queue_stats(&queue_stats);
+    app_log_info("NCP %u queue: %u events queued, %u dropped, max depth %u/%u" APP_LOG_NL,
+                 instance,
+                 queue_stats.queued,
+                 queue_stats.dropped,
+                 queue_stats.max_depth,
+                 queue_stats.depth);
+    for (i = 0; i < SL_BT_API_DROP_STATS_IDS && queue_stats.drops[i].id != 0; i++) {
+      app_log_info("NCP %u queue: %u events dropped with ID 0x%08x" APP_LOG_NL,
+                   instance,
+                   queue_stats.drops[i].count,
+                   queue_stats.drops[i].id);
+    }
+    if (queue_stats.drops_other > 0) {
+      app_log_info("NCP %u queue: %u events dropped with other IDs" APP_LOG_NL,
+                   instance,
+                   queue_stats.drops_other);
+    }
   }
 }
 
@@ -281,11 +601,23 @@ static void parse_config(char *filename)
   sc = aoa_parse_init(buffer);
   app_assert_status(sc);
 
+  sc = aoa_parse_antenna_array(&aoa_board);
+  app_assert((sc == SL_STATUS_OK) || (sc == SL_STATUS_NOT_FOUND),
+             "[E: 0x%04x] aoa_parse_antenna_array failed" APP_LOG_NL,
+             (int)sc);
+  app_log_info("Antenna array %s, %u snapshots." APP_LOG_NL, aoa_board.name,
+               (unsigned)aoa_board.num_snapshots);
+
 #ifdef AOA_ANGLE
   sc = aoa_parse_azimuth(&aoa_azimuth_min, &aoa_azimuth_max);
   app_assert((sc == SL_STATUS_OK) || (sc == SL_STATUS_NOT_FOUND),
              "[E: 0x%04x] aoa_parse_azimuth failed" APP_LOG_NL,
              (int)sc);
+
+  sc = aoa_parse_estimator_mode(&aoa_mode);
+  app_assert((sc == SL_STATUS_OK) || (sc == SL_STATUS_NOT_FOUND),
+             "[E: 0x%04x] aoa_parse_estimator_mode failed" APP_LOG_NL,
+             (int)sc);
 #endif // AOA_ANGLE
 
   do {
@@ -32,10 +32,15 @@
 #define APP_CONFIG_H
 
 #include "aoa_board.h"
+#include "sl_bt_ncp_host.h"
 
-// Maximum number of asset tags handled by the application.
+// Maximum number of asset tags handled by the application for each locator.
 #define AOA_MAX_TAGS                   8
 
+// Maximum number of locator boards handled by the application, one for each
+// NCP instance. Each tag is tracked separately for each locator.
+#define AOA_MAX_LOCATORS               SL_BT_API_MAX_INSTANCES
+
 // Measurement interval expressed as the number of connection events.
 #define CTE_SAMPLING_INTERVAL          3
 
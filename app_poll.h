@@ -0,0 +1,158 @@
+/***************************************************************************//**
+ * @file
+ * @brief Poll based wait for file descriptors and timers.
+ *******************************************************************************
+ * # License
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef APP_POLL_H
+#define APP_POLL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <poll.h>
+#include "sl_status.h"
+
+// Maximum number of file descriptors that can be watched at the same time.
+#ifndef APP_POLL_MAX_FDS
+#define APP_POLL_MAX_FDS               16
+#endif
+
+// Wait without a time limit.
+#define APP_POLL_INFINITE              (-1)
+
+/**************************************************************************//**
+ * File descriptor event handler.
+ *
+ * @param[in] fd File descriptor that has pending events.
+ * @param[in] revents Events returned by poll().
+ * @param[in] ctx Context pointer given at registration.
+ *****************************************************************************/
+typedef void (*app_poll_fd_handler_t)(int fd, short revents, void *ctx);
+
+struct app_poll_timer_s;
+
+/**************************************************************************//**
+ * Timer expiry handler.
+ *
+ * @param[in] timer Timer that has expired.
+ * @param[in] ctx Context pointer given when the timer was started.
+ *****************************************************************************/
+typedef void (*app_poll_timer_handler_t)(struct app_poll_timer_s *timer, void *ctx);
+
+/**************************************************************************//**
+ * Timer instance. The storage is provided by the user, it has to be zero
+ * initialized before the first use and has to remain valid while the timer is
+ * running.
+ *****************************************************************************/
+typedef struct app_poll_timer_s {
+  struct app_poll_timer_s *next;
+  uint64_t expiry;
+  uint32_t period;
+  app_poll_timer_handler_t handler;
+  void *ctx;
+  bool running;
+} app_poll_timer_t;
+
+/**************************************************************************//**
+ * Start watching a file descriptor.
+ *
+ * @param[in] fd File descriptor to watch.
+ * @param[in] events Events to wait for, see poll().
+ * @param[in] handler Function called when any of the events occur.
+ * @param[in] ctx Context pointer passed to the handler.
+ *
+ * @retval SL_STATUS_OK File descriptor added.
+ * @retval SL_STATUS_ALREADY_EXISTS File descriptor is already watched.
+ * @retval SL_STATUS_FULL No more file descriptors can be watched.
+ *****************************************************************************/
+sl_status_t app_poll_add(int fd, short events, app_poll_fd_handler_t handler,
+                         void *ctx);
+
+/**************************************************************************//**
+ * Change the events to wait for on a watched file descriptor.
+ *
+ * @param[in] fd Watched file descriptor.
+ * @param[in] events Events to wait for, see poll().
+ *
+ * @retval SL_STATUS_OK Events updated.
+ * @retval SL_STATUS_NOT_FOUND File descriptor is not watched.
+ *****************************************************************************/
+sl_status_t app_poll_modify(int fd, short events);
+
+/**************************************************************************//**
+ * Stop watching a file descriptor.
+ *
+ * @param[in] fd Watched file descriptor.
+ *
+ * @retval SL_STATUS_OK File descriptor removed.
+ * @retval SL_STATUS_NOT_FOUND File descriptor is not watched.
+ *****************************************************************************/
+sl_status_t app_poll_remove(int fd);
+
+/**************************************************************************//**
+ * Start a timer. A running timer is restarted.
+ *
+ * @param[in] timer Timer instance.
+ * @param[in] timeout Time until the first expiry in milliseconds.
+ * @param[in] period Period of the subsequent expiries in milliseconds,
+ *                   0 for a one-shot timer.
+ * @param[in] handler Function called on expiry.
+ * @param[in] ctx Context pointer passed to the handler.
+ *****************************************************************************/
+void app_poll_timer_start(app_poll_timer_t *timer, uint32_t timeout,
+                          uint32_t period, app_poll_timer_handler_t handler,
+                          void *ctx);
+
+/**************************************************************************//**
+ * Stop a timer. Stopping a timer that is not running has no effect.
+ *
+ * @param[in] timer Timer instance.
+ *****************************************************************************/
+void app_poll_timer_stop(app_poll_timer_t *timer);
+
+/**************************************************************************//**
+ * Get the monotonic time used by the timers.
+ *
+ * @return Time in milliseconds.
+ *****************************************************************************/
+uint64_t app_poll_time(void);
+
+/**************************************************************************//**
+ * Wait until a watched file descriptor has events, a timer expires or the
+ * timeout elapses, then call the corresponding handlers.
+ *
+ * @param[in] timeout Maximum time to wait in milliseconds, 0 to return
+ *                    immediately or APP_POLL_INFINITE to wait without limit.
+ *****************************************************************************/
+void app_poll_wait(int32_t timeout);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // APP_POLL_H
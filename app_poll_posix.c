@@ -0,0 +1,232 @@
+/***************************************************************************//**
+ * @file
+ * @brief Poll based wait for file descriptors and timers on POSIX platform.
+ *******************************************************************************
+ * # License
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include "aoa_util.h"
+#include "app_poll.h"
+
+// Watched file descriptors and their handlers. The two arrays share indexes.
+static struct pollfd poll_fds[APP_POLL_MAX_FDS];
+static struct {
+  app_poll_fd_handler_t handler;
+  void *ctx;
+} poll_handlers[APP_POLL_MAX_FDS];
+static nfds_t poll_fd_count = 0;
+
+// Running timers in the order of expiry.
+static app_poll_timer_t *timer_list = NULL;
+
+static int find_fd(int fd);
+static void timer_insert(app_poll_timer_t *timer);
+static void timer_process(void);
+
+/**************************************************************************//**
+ * Start watching a file descriptor.
+ *****************************************************************************/
+sl_status_t app_poll_add(int fd, short events, app_poll_fd_handler_t handler,
+                         void *ctx)
+{
+  if (find_fd(fd) >= 0) {
+    return SL_STATUS_ALREADY_EXISTS;
+  }
+  if (poll_fd_count >= APP_POLL_MAX_FDS) {
+    return SL_STATUS_FULL;
+  }
+  poll_fds[poll_fd_count].fd = fd;
+  poll_fds[poll_fd_count].events = events;
+  poll_fds[poll_fd_count].revents = 0;
+  poll_handlers[poll_fd_count].handler = handler;
+  poll_handlers[poll_fd_count].ctx = ctx;
+  poll_fd_count++;
+  return SL_STATUS_OK;
+}
+
+/**************************************************************************//**
+ * Change the events to wait for on a watched file descriptor.
+ *****************************************************************************/
+sl_status_t app_poll_modify(int fd, short events)
+{
+  int i = find_fd(fd);
+
+  if (i < 0) {
+    return SL_STATUS_NOT_FOUND;
+  }
+  poll_fds[i].events = events;
+  return SL_STATUS_OK;
+}
+
+/**************************************************************************//**
+ * Stop watching a file descriptor.
+ *****************************************************************************/
+sl_status_t app_poll_remove(int fd)
+{
+  int i = find_fd(fd);
+
+  if (i < 0) {
+    return SL_STATUS_NOT_FOUND;
+  }
+  // Fill the gap with the last entry.
+  poll_fd_count--;
+  poll_fds[i] = poll_fds[poll_fd_count];
+  poll_handlers[i] = poll_handlers[poll_fd_count];
+  // Make sure that a pending event is not dispatched for the removed entry.
+  poll_fds[poll_fd_count].revents = 0;
+  return SL_STATUS_OK;
+}
+
+/**************************************************************************//**
+ * Start a timer.
+ *****************************************************************************/
+void app_poll_timer_start(app_poll_timer_t *timer, uint32_t timeout,
+                          uint32_t period, app_poll_timer_handler_t handler,
+                          void *ctx)
+{
+  app_poll_timer_stop(timer);
+  timer->expiry = app_poll_time() + timeout;
+  timer->period = period;
+  timer->handler = handler;
+  timer->ctx = ctx;
+  timer_insert(timer);
+}
+
+/**************************************************************************//**
+ * Stop a timer.
+ *****************************************************************************/
+void app_poll_timer_stop(app_poll_timer_t *timer)
+{
+  app_poll_timer_t **t;
+
+  if (!timer->running) {
+    return;
+  }
+  for (t = &timer_list; *t != NULL; t = &(*t)->next) {
+    if (*t == timer) {
+      *t = timer->next;
+      break;
+    }
+  }
+  timer->running = false;
+}
+
+/**************************************************************************//**
+ * Get the monotonic time used by the timers.
+ *****************************************************************************/
+uint64_t app_poll_time(void)
+{
+  return aoa_time_us() / 1000;
+}
+
+/**************************************************************************//**
+ * Wait for events and call the handlers.
+ *****************************************************************************/
+void app_poll_wait(int32_t timeout)
+{
+  int ret;
+  uint64_t now;
+  nfds_t i;
+
+  // Do not sleep past the next timer expiry.
+  if (timer_list != NULL) {
+    now = app_poll_time();
+    if (timer_list->expiry <= now) {
+      timeout = 0;
+    } else if ((timeout < 0) || (timer_list->expiry - now < (uint64_t)timeout)) {
+      timeout = (int32_t)(timer_list->expiry - now);
+    }
+  }
+
+  ret = poll(poll_fds, poll_fd_count, timeout);
+  if (ret < 0) {
+    if (errno != EINTR) {
+      perror("Poll failed");
+    }
+    return;
+  }
+
+  // Handlers may add or remove entries, so the count is checked every time.
+  for (i = 0; (ret > 0) && (i < poll_fd_count); i++) {
+    short revents = poll_fds[i].revents;
+    if (revents != 0) {
+      poll_fds[i].revents = 0;
+      ret--;
+      poll_handlers[i].handler(poll_fds[i].fd, revents, poll_handlers[i].ctx);
+    }
+  }
+
+  timer_process();
+}
+
+// -----------------------------------------------------------------------------
+// Private function definitions
+
+static int find_fd(int fd)
+{
+  nfds_t i;
+
+  for (i = 0; i < poll_fd_count; i++) {
+    if (poll_fds[i].fd == fd) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+static void timer_insert(app_poll_timer_t *timer)
+{
+  app_poll_timer_t **t = &timer_list;
+
+  // Keep the list ordered, timers with equal expiry fire in start order.
+  while ((*t != NULL) && ((*t)->expiry <= timer->expiry)) {
+    t = &(*t)->next;
+  }
+  timer->next = *t;
+  *t = timer;
+  timer->running = true;
+}
+
+static void timer_process(void)
+{
+  app_poll_timer_t *timer;
+  uint64_t now = app_poll_time();
+
+  while ((timer_list != NULL) && (timer_list->expiry <= now)) {
+    timer = timer_list;
+    timer_list = timer->next;
+    timer->running = false;
+    if (timer->period > 0) {
+      // Schedule the next expiry before calling the handler, so that the
+      // handler is able to stop or restart the timer.
+      timer->expiry += timer->period;
+      if (timer->expiry <= now) {
+        timer->expiry = now + timer->period;
+      }
+      timer_insert(timer);
+    }
+    timer->handler(timer, timer->ctx);
+  }
+}
@@ -47,9 +47,6 @@
 #include "aoa_util.h"
 #include "app_config.h"
 
-// Antenna switching pattern
-static const uint8_t antenna_array[AOA_NUM_ARRAY_ELEMENTS] = SWITCHING_PATTERN;
-
 /**************************************************************************//**
  * Connection specific Bluetooth event handler.
  *****************************************************************************/
@@ -94,8 +91,8 @@ void app_bt_on_event(sl_bt_msg_t *evt)
       // Start Silabs CTE
       sc = sl_bt_cte_receiver_enable_silabs_cte(CTE_SLOT_DURATION,
                                                 CTE_COUNT,
-                                                sizeof(antenna_array),
-                                                antenna_array);
+                                                aoa_board.num_array_elements,
+                                                aoa_board.switching_pattern);
 
       app_assert_status(sc);
       break;
@@ -117,16 +114,19 @@ void app_bt_on_event(sl_bt_msg_t *evt)
       }
 
       // Look for this tag.
-      tag = get_connection_by_address(&evt->data.evt_cte_receiver_silabs_iq_report.address);
+      tag = get_connection_by_address(&evt->data.evt_cte_receiver_silabs_iq_report.address,
+                                      sl_bt_api_get_instance());
       // Check if it is a new tag
       if (tag == NULL) {
         // Connection handle parameter unused.
         tag = add_connection(0,
                              &evt->data.evt_cte_receiver_silabs_iq_report.address,
-                             evt->data.evt_cte_receiver_silabs_iq_report.address_type);
+                             evt->data.evt_cte_receiver_silabs_iq_report.address_type,
+                             sl_bt_api_get_instance());
         // Check if we have enough space for hte new tag.
         if (tag == NULL) {
-          app_log_warning("Too many tags in the system." APP_LOG_NL);
+          app_log_warning("Too many tags for locator %d." APP_LOG_NL,
+                          sl_bt_api_get_instance());
           // Don't continue the process. This will save us CPU time.
           break;
         }
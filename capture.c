@@ -0,0 +1,328 @@
+/***************************************************************************//**
+ * @file
+ * @brief NCP byte stream capture and replay
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sl_bt_api.h"
+#include "aoa_util.h"
+#include "capture.h"
+
+#if defined(POSIX) && POSIX == 1
+#include <time.h>
+#else // defined(POSIX) && POSIX == 1
+#include <windows.h>
+#endif // defined(POSIX) && POSIX == 1
+
+// Buffer size of the capture file, so that writes rarely reach the disk from
+// the receive path.
+#define CAPTURE_FILE_BUFFER_SIZE  (64 * 1024)
+
+// Interval of checking whether the command of a held back response is sent.
+#define REPLAY_RESPONSE_POLL_US   1000
+
+// Start time of the capture and of the replay, common to all files.
+static uint64_t capture_epoch_us;
+static uint64_t replay_epoch_us;
+
+static int32_t capture_write_record(capture_t *capture, uint32_t delta,
+                                    uint16_t len, uint8_t *data);
+static void sleep_us(uint64_t us);
+static bool replay_next_record(replay_t *replay);
+static uint32_t replay_scan(replay_t *replay, uint32_t max_len, bool commit);
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+int32_t capture_open(capture_t *capture, const char *path)
+{
+  uint8_t header[CAPTURE_HEADER_LEN] = CAPTURE_MAGIC;
+
+  capture->file = fopen(path, "wb");
+  if (capture->file == NULL) {
+    return -1;
+  }
+  setvbuf(capture->file, NULL, _IOFBF, CAPTURE_FILE_BUFFER_SIZE);
+  header[6] = CAPTURE_VERSION;
+  if (fwrite(header, sizeof(header), 1, capture->file) != 1) {
+    capture_close(capture);
+    return -1;
+  }
+  if (capture_epoch_us == 0) {
+    capture_epoch_us = aoa_time_us();
+  }
+  capture->last_us = capture_epoch_us;
+  return 0;
+}
+
+int32_t capture_write(capture_t *capture, uint32_t data_length, uint8_t *data)
+{
+  uint64_t now = aoa_time_us();
+  uint64_t delta = now - capture->last_us;
+
+  capture->last_us = now;
+  // Carry gaps that do not fit in one record in empty records.
+  while (delta > UINT32_MAX) {
+    if (capture_write_record(capture, UINT32_MAX, 0, NULL) != 0) {
+      return -1;
+    }
+    delta -= UINT32_MAX;
+  }
+  // Split reads that do not fit in one record.
+  while (data_length > 0) {
+    uint16_t len = (data_length > UINT16_MAX) ? UINT16_MAX : (uint16_t)data_length;
+    if (capture_write_record(capture, (uint32_t)delta, len, data) != 0) {
+      return -1;
+    }
+    data += len;
+    data_length -= len;
+    delta = 0;
+  }
+  return 0;
+}
+
+void capture_close(capture_t *capture)
+{
+  if (capture->file != NULL) {
+    fclose(capture->file);
+    capture->file = NULL;
+  }
+}
+
+int32_t replay_open(void *handle, const char *path, float speed)
+{
+  replay_t *replay = (replay_t *)handle;
+  uint8_t header[CAPTURE_HEADER_LEN];
+
+  memset(replay, 0, sizeof(*replay));
+  replay->speed = speed;
+  replay->record = malloc(UINT16_MAX);
+  replay->file = fopen(path, "rb");
+  if (replay->record == NULL || replay->file == NULL) {
+    replay_close(handle);
+    return -1;
+  }
+  if (fread(header, sizeof(header), 1, replay->file) != 1
+      || memcmp(header, CAPTURE_MAGIC, strlen(CAPTURE_MAGIC)) != 0
+      || header[6] != CAPTURE_VERSION) {
+    fprintf(stderr, "Not a capture file: %s\n", path);
+    replay_close(handle);
+    return -1;
+  }
+  if (replay_epoch_us == 0) {
+    replay_epoch_us = aoa_time_us();
+  }
+  return 0;
+}
+
+int32_t replay_tx(void *handle, uint32_t data_length, uint8_t *data)
+{
+  replay_t *replay = (replay_t *)handle;
+  uint32_t header;
+
+  // The system reset command has no response, the boot event follows.
+  memcpy(&header, data, sizeof(header));
+  if (SL_BGAPI_MSG_ID(header) != sl_bt_cmd_system_reset_id) {
+    __atomic_add_fetch(&replay->commands, 1, __ATOMIC_SEQ_CST);
+  }
+  return (int32_t)data_length;
+}
+
+int32_t replay_rx(void *handle, uint32_t data_length, uint8_t *data)
+{
+  replay_t *replay = (replay_t *)handle;
+  uint32_t len;
+
+  if (replay->record_pos == replay->record_len && !replay_next_record(replay)) {
+    return -1;
+  }
+  if (replay->speed > 0) {
+    uint64_t due = replay_epoch_us
+                   + (uint64_t)((double)replay->time_us / replay->speed);
+    uint64_t now;
+    while ((now = aoa_time_us()) < due) {
+      sleep_us(due - now);
+    }
+  }
+  while ((len = replay_scan(replay, data_length, true)) == 0) {
+    // A response is due before its command was sent.
+    sleep_us(REPLAY_RESPONSE_POLL_US);
+  }
+  memcpy(data, &replay->record[replay->record_pos], len);
+  replay->record_pos += len;
+  return (int32_t)len;
+}
+
+int32_t replay_peek(void *handle)
+{
+  replay_t *replay = (replay_t *)handle;
+
+  if (replay->record_pos == replay->record_len && !replay_next_record(replay)) {
+    return 0;
+  }
+  if (replay->speed > 0
+      && replay_epoch_us + (uint64_t)((double)replay->time_us / replay->speed)
+      > aoa_time_us()) {
+    return 0;
+  }
+  return (int32_t)replay_scan(replay, UINT32_MAX, false);
+}
+
+int32_t replay_close(void *handle)
+{
+  replay_t *replay = (replay_t *)handle;
+  int32_t ret = 0;
+
+  if (replay->file != NULL) {
+    ret = fclose(replay->file);
+    replay->file = NULL;
+  }
+  free(replay->record);
+  replay->record = NULL;
+  return ret;
+}
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+// Write one record header and its bytes.
+static int32_t capture_write_record(capture_t *capture, uint32_t delta,
+                                    uint16_t len, uint8_t *data)
+{
+  uint8_t record[CAPTURE_RECORD_LEN];
+
+  record[0] = (uint8_t)delta;
+  record[1] = (uint8_t)(delta >> 8);
+  record[2] = (uint8_t)(delta >> 16);
+  record[3] = (uint8_t)(delta >> 24);
+  record[4] = (uint8_t)len;
+  record[5] = (uint8_t)(len >> 8);
+  if (fwrite(record, sizeof(record), 1, capture->file) != 1
+      || (len > 0 && fwrite(data, len, 1, capture->file) != 1)) {
+    return -1;
+  }
+  return 0;
+}
+
+// Read the next record. Return false at the end of the file.
+static bool replay_next_record(replay_t *replay)
+{
+  uint8_t record[CAPTURE_RECORD_LEN];
+
+  if (replay->done) {
+    return false;
+  }
+  do {
+    if (fread(record, sizeof(record), 1, replay->file) != 1) {
+      replay->done = true;
+      return false;
+    }
+    replay->time_us += (uint32_t)record[0] | (uint32_t)record[1] << 8
+                       | (uint32_t)record[2] << 16 | (uint32_t)record[3] << 24;
+    replay->record_len = (uint32_t)record[4] | (uint32_t)record[5] << 8;
+    replay->record_pos = 0;
+  } while (replay->record_len == 0);
+  if (fread(replay->record, replay->record_len, 1, replay->file) != 1) {
+    replay->done = true;
+    return false;
+  }
+  return true;
+}
+
+/**************************************************************************//**
+ * Follow the BGAPI frames in the current record and return how many of the
+ * next bytes can be read, at most max_len. The bytes stop before a response
+ * whose command has not been sent yet. If commit is true, the frame state
+ * is advanced over the returned bytes.
+ *****************************************************************************/
+static uint32_t replay_scan(replay_t *replay, uint32_t max_len, bool commit)
+{
+  uint32_t commands = __atomic_load_n(&replay->commands, __ATOMIC_SEQ_CST);
+  uint32_t responses = replay->responses;
+  uint8_t header_pos = replay->header_pos;
+  uint16_t frame_len = replay->frame_len;
+  uint16_t frame_left = replay->frame_left;
+  uint32_t len = 0;
+  uint32_t available = replay->record_len - replay->record_pos;
+  const uint8_t *p = &replay->record[replay->record_pos];
+
+  if (max_len > available) {
+    max_len = available;
+  }
+  for (len = 0; len < max_len; len++) {
+    if (frame_left > 0) {
+      frame_left--;
+      continue;
+    }
+    switch (header_pos) {
+      case 0:
+        // First byte of a frame: message type and high bits of the length.
+        if ((p[len] & sl_bgapi_msg_type_evt) == 0) {
+          if (responses == commands) {
+            goto stop;
+          }
+          responses++;
+        }
+        frame_len = (uint16_t)(p[len] & 0x07) << 8;
+        break;
+      case 1:
+        frame_len |= p[len];
+        break;
+      case 3:
+        frame_left = frame_len;
+        break;
+      default:
+        break;
+    }
+    header_pos = (header_pos + 1) % SL_BGAPI_MSG_HEADER_LEN;
+  }
+  stop:
+  if (commit) {
+    replay->responses = responses;
+    replay->header_pos = header_pos;
+    replay->frame_len = frame_len;
+    replay->frame_left = frame_left;
+  }
+  return len;
+}
+
+static void sleep_us(uint64_t us)
+{
+#if defined(POSIX) && POSIX == 1
+  struct timespec ts;
+  ts.tv_sec = (time_t)(us / 1000000);
+  ts.tv_nsec = (long)(us % 1000000 * 1000);
+  // The caller checks the time again if the sleep is interrupted.
+  nanosleep(&ts, NULL);
+#else // defined(POSIX) && POSIX == 1
+  Sleep((DWORD)((us + 999) / 1000));
+#endif // defined(POSIX) && POSIX == 1
+}
@@ -0,0 +1,144 @@
+/***************************************************************************//**
+ * @file
+ * @brief NCP byte stream capture and replay header file
+ *
+ * A capture file starts with an 8 byte header: the magic "NCPCAP", a format
+ * version and a reserved byte. It is followed by one record per read from
+ * the NCP: the time since the previous record in microseconds (uint32_t), the
+ * number of bytes (uint16_t), both little endian, then the bytes themselves.
+ * A longer gap is carried by records without bytes before the next read.
+ * The first record of every file counts from the same start time, so the
+ * files of several NCPs captured together stay aligned on replay.
+ *
+ * Only the received bytes are captured. On replay, a response is held back
+ * until the application has sent the command it answers, because the
+ * application can only take one response at a time.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CAPTURE_MAGIC         "NCPCAP"
+#define CAPTURE_VERSION       1
+#define CAPTURE_HEADER_LEN    8
+#define CAPTURE_RECORD_LEN    6
+
+// Capture file being written.
+typedef struct {
+  FILE *file;
+  uint64_t last_us;     // Time of the previous record
+} capture_t;
+
+// Capture file being replayed.
+typedef struct {
+  FILE *file;
+  float speed;          // Replay speed, 0: as fast as possible
+  uint64_t time_us;     // Capture time of the current record
+  uint8_t *record;      // Data of the current record
+  uint32_t record_len;
+  uint32_t record_pos;  // Bytes of the current record already read
+  uint8_t header_pos;   // Header bytes of the current frame already read
+  uint16_t frame_len;   // Payload length of the current frame
+  uint16_t frame_left;  // Payload bytes of the current frame not read yet
+  uint32_t commands;    // Commands sent that expect a response
+  uint32_t responses;   // Responses read
+  bool done;            // End of file reached
+} replay_t;
+
+/**************************************************************************//**
+ * Create a capture file.
+ * @param[out]  capture Capture state
+ * @param[in]  path Path of the file, an existing file is overwritten.
+ * @return  0 on success, -1 on failure.
+ *****************************************************************************/
+int32_t capture_open(capture_t *capture, const char *path);
+
+/**************************************************************************//**
+ * Append the bytes of one read to the capture file, with the current time.
+ * @param[in]  capture Capture state
+ * @param[in]  data_length The amount of bytes read.
+ * @param[in]  data The bytes read.
+ * @return  0 on success, -1 on failure.
+ *****************************************************************************/
+int32_t capture_write(capture_t *capture, uint32_t data_length, uint8_t *data);
+
+/**************************************************************************//**
+ * Close the capture file.
+ * @param[in]  capture Capture state
+ *****************************************************************************/
+void capture_close(capture_t *capture);
+
+/**************************************************************************//**
+ * Open a capture file for replay.
+ * @param[out]  handle Replay state (replay_t)
+ * @param[in]  path Path of the capture file.
+ * @param[in]  speed 1: original pace, N: N times faster, 0: no pacing.
+ * @return  0 on success, -1 on failure.
+ *****************************************************************************/
+int32_t replay_open(void *handle, const char *path, float speed);
+
+/**************************************************************************//**
+ * Discard a command sent to the replayed NCP. The response is in the capture
+ * and is released by this call.
+ * @param[in]  handle Replay state
+ * @param[in]  data_length The amount of bytes to write.
+ * @param[in]  data Buffer used for storing the data.
+ * @return  The amount of bytes written.
+ *****************************************************************************/
+int32_t replay_tx(void *handle, uint32_t data_length, uint8_t *data);
+
+/**************************************************************************//**
+ * Read captured data. The function blocks until the data of the current
+ * record is due and, for a response, until its command has been sent. It
+ * returns at most the rest of the current record.
+ * @param[in]  handle Replay state
+ * @param[in]  data_length The maximum amount of bytes to read.
+ * @param[out]  data Buffer used for storing the data.
+ * @return  The amount of bytes read or -1 on failure or end of the capture.
+ *****************************************************************************/
+int32_t replay_rx(void *handle, uint32_t data_length, uint8_t *data);
+
+/**************************************************************************//**
+ * Return the number of captured bytes that are due.
+ * @param[in]  handle Replay state
+ * @return  The number of bytes that can be read without blocking.
+ *****************************************************************************/
+int32_t replay_peek(void *handle);
+
+/**************************************************************************//**
+ * Close the replayed capture file.
+ * @param[in]  handle Replay state
+ * @return  0 on success, -1 on failure.
+ *****************************************************************************/
+int32_t replay_close(void *handle);
+
+#endif // CAPTURE_H
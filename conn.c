@@ -33,18 +33,29 @@
 #include "app_assert.h"
 #include "app_log.h"
 #include "conn.h"
+#ifdef AOA_ANGLE
+#include "aoa_util.h"
+#endif // AOA_ANGLE
 
 #define CONNECTION_HANDLE_INVALID     (uint16_t)0xFFFFu
 #define SERVICE_HANDLE_INVALID        (uint32_t)0xFFFFFFFFu
 #define CHARACTERISTIC_HANDLE_INVALID (uint16_t)0xFFFFu
 #define TABLE_INDEX_INVALID           (uint8_t)0xFFu
 
+// Each tag has a separate entry for each locator.
+#define CONN_TABLE_SIZE               (AOA_MAX_TAGS * AOA_MAX_LOCATORS)
+
+// Table indices are stored in 8 bits, 0xFF marks an invalid one.
+#if AOA_MAX_TAGS * AOA_MAX_LOCATORS >= 0xFF
+#error "Too many tags or locators for the connection table."
+#endif
+
 /***************************************************************************************************
  * Static Variable Declarations
  **************************************************************************************************/
 
 // Array for holding properties of multiple (parallel) connections
-static conn_properties_t conn_properties[AOA_MAX_TAGS];
+static conn_properties_t conn_properties[CONN_TABLE_SIZE];
 
 // Counter of active connections
 static uint8_t active_connections_num;
@@ -58,39 +69,53 @@ void init_connection(void)
   active_connections_num = 0;
 
   // Initialize connection state variables
-  for (i = 0; i < AOA_MAX_TAGS; i++) {
+  for (i = 0; i < CONN_TABLE_SIZE; i++) {
     conn_properties[i].connection_handle = CONNECTION_HANDLE_INVALID;
     conn_properties[i].cte_service_handle = SERVICE_HANDLE_INVALID;
     conn_properties[i].cte_enable_char_handle = CHARACTERISTIC_HANDLE_INVALID;
   }
 }
 
-conn_properties_t* add_connection(uint16_t connection, bd_addr *address, uint8_t address_type)
+conn_properties_t* add_connection(uint16_t connection, bd_addr *address, uint8_t address_type, uint8_t locator)
 {
   conn_properties_t* ret = NULL;
+  uint8_t locator_tags = 0;
+
+  // Limit the tags of each locator, so that a busy board cannot take the
+  // slots of the others.
+  for (uint8_t i = 0; i < active_connections_num; i++) {
+    if (conn_properties[i].locator == locator) {
+      locator_tags++;
+    }
+  }
 
   // If there is place to store new connection
-  if (active_connections_num < AOA_MAX_TAGS) {
+  if (active_connections_num < CONN_TABLE_SIZE && locator_tags < AOA_MAX_TAGS) {
     // Store the connection handle, and the server address
     conn_properties[active_connections_num].connection_handle = connection;
     conn_properties[active_connections_num].address = *address;
     conn_properties[active_connections_num].address_type = address_type;
+    conn_properties[active_connections_num].locator = locator;
     conn_properties[active_connections_num].connection_state = DISCOVER_SERVICES;
 #ifdef AOA_ANGLE
     enum sl_rtl_error_code ec = aoa_init(&conn_properties[active_connections_num].aoa_state);
     app_assert(ec == SL_RTL_ERROR_SUCCESS, "[E: %d] aoa_init failed" APP_LOG_NL, ec);
     conn_properties[active_connections_num].sequence = -1; // Invalid sequence
+    conn_properties[active_connections_num].reports = 0;
+    throttle_init(&conn_properties[active_connections_num].throttle, address->addr, address_type);
+    aoa_address_to_id(address->addr, address_type, conn_properties[active_connections_num].id);
 #endif // AOA_ANGLE
     // Entry is now valid
     ret = &conn_properties[active_connections_num];
-    app_log_info("New tag added (%d): %02X:%02X:%02X:%02X:%02X:%02X" APP_LOG_NL,
+    app_log_info("New tag added (%d): %02X:%02X:%02X:%02X:%02X:%02X, locator %d" APP_LOG_NL,
                  active_connections_num,
                  address->addr[5],
                  address->addr[4],
                  address->addr[3],
                  address->addr[2],
                  address->addr[1],
-                 address->addr[0]);
+                 address->addr[0],
+                 locator);
     active_connections_num++;
   }
   return ret;
@@ -133,7 +158,7 @@ uint8_t remove_connection(uint16_t connection)
   }
 
   // Clear the slots we've just removed so no junk values appear
-  for (i = active_connections_num; i < AOA_MAX_TAGS; i++) {
+  for (i = active_connections_num; i < CONN_TABLE_SIZE; i++) {
     conn_properties[i].connection_handle = CONNECTION_HANDLE_INVALID;
     conn_properties[i].cte_service_handle = SERVICE_HANDLE_INVALID;
     conn_properties[i].cte_enable_char_handle = CHARACTERISTIC_HANDLE_INVALID;
@@ -145,7 +170,7 @@ uint8_t remove_connection(uint16_t connection)
 uint8_t is_connection_list_full(void)
 {
   // Return if connection state table is full
-  return (active_connections_num >= AOA_MAX_TAGS);
+  return (active_connections_num >= CONN_TABLE_SIZE);
 }
 
 conn_properties_t* get_connection_by_handle(uint16_t connection_handle)
@@ -163,12 +188,13 @@ conn_properties_t* get_connection_by_handle(uint16_t connection_handle)
   return ret;
 }
 
-conn_properties_t* get_connection_by_address(bd_addr* address)
+conn_properties_t* get_connection_by_address(bd_addr* address, uint8_t locator)
 {
   conn_properties_t* ret = NULL;
   // Find the connection state entry in the table corresponding to the connection address
   for (uint8_t i = 0; i < active_connections_num; i++) {
-    if (0 == memcmp(address, &(conn_properties[i].address), sizeof(bd_addr))) {
+    if ((conn_properties[i].locator == locator)
+        && (0 == memcmp(address, &(conn_properties[i].address), sizeof(bd_addr)))) {
       // Return a pointer to the connection state entry
       ret = &conn_properties[i];
       break;
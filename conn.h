@@ -35,6 +35,8 @@
 #include "sl_bt_api.h"
 #ifdef AOA_ANGLE
 #include "aoa_angle.h"
+#include "throttle.h"
+#include "aoa_types.h"
 #endif // AOA_ANGLE
 
 #ifdef __cplusplus
@@ -72,12 +74,16 @@ typedef struct {
   uint16_t connection_handle;   //This is used for connection handle for connection oriented, and for sync handle for connection less mode
   bd_addr address;
   uint8_t address_type;
+  uint8_t locator;              //Index of the locator board that receives the tag
   uint32_t cte_service_handle;
   uint16_t cte_enable_char_handle;
   connection_state_t connection_state;
 #ifdef AOA_ANGLE
   aoa_state_t aoa_state;
   int32_t sequence;
+  throttle_state_t throttle;
+  aoa_id_t id;                  //Tag ID used in the output
+  uint32_t reports;             //IQ reports received, for the decimation under overload
 #endif // AOA_ANGLE
 } conn_properties_t;
 
@@ -87,14 +93,14 @@ typedef struct {
 
 void init_connection(void);
 
-conn_properties_t* add_connection(uint16_t connection, bd_addr *address, uint8_t address_type);
+conn_properties_t* add_connection(uint16_t connection, bd_addr *address, uint8_t address_type, uint8_t locator);
 
 uint8_t remove_connection(uint16_t connection);
 
 uint8_t is_connection_list_full(void);
 
 conn_properties_t* get_connection_by_handle(uint16_t connection_handle);
-conn_properties_t* get_connection_by_address(bd_addr* address);
+conn_properties_t* get_connection_by_address(bd_addr* address, uint8_t locator);
 
 /** @} (end addtogroup app) */
 /** @} (end addtogroup Application) */
@@ -0,0 +1,306 @@
+/***************************************************************************//**
+ * @file
+ * @brief IQ sample unpacking benchmark.
+ *
+ * Unpacks the same set of random IQ reports for every array type of
+ * aoa_board.h, once with the per sample loop the locator used before, into
+ * rows allocated one by one, and once with aoa_iq_unpack into contiguous
+ * buffers. Checks that both give the same samples, within one unit in the
+ * last place, and prints the time per report of each.
+ *
+ * Usage: iq_bench [-n <reports>] [-r <rounds>]
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "aoa_iq.h"
+
+#define DEFAULT_REPORT_COUNT  1024
+#define DEFAULT_ROUNDS        200
+
+// The array types of aoa_board.h.
+typedef struct {
+  const char *name;
+  uint32_t snapshots;
+  uint32_t elements;
+  uint32_t ref_samples;
+} array_type_t;
+
+static const array_type_t array_types[] = {
+  { "4x4_URA", 4, 4 * 4, 7 },
+  { "3x3_URA", 4, 3 * 3, 7 },
+  { "1x4_ULA", 18, 1 * 4, 7 }
+};
+
+// Buffers of the loop used before, one allocation per row.
+typedef struct {
+  float **ref_i;
+  float **ref_q;
+  float **i;
+  float **q;
+} rows_t;
+
+// Buffers of aoa_iq_unpack.
+typedef struct {
+  aoa_iq_buffer_t ref_i;
+  aoa_iq_buffer_t ref_q;
+  aoa_iq_buffer_t i;
+  aoa_iq_buffer_t q;
+} buffers_t;
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static float **alloc_rows(uint32_t rows, uint32_t cols)
+{
+  float **buf = malloc(sizeof(float *) * rows);
+  for (uint32_t r = 0; r < rows; r++) {
+    buf[r] = calloc(cols, sizeof(float));
+  }
+  return buf;
+}
+
+static void free_rows(float **buf, uint32_t rows)
+{
+  for (uint32_t r = 0; r < rows; r++) {
+    free(buf[r]);
+  }
+  free(buf);
+}
+
+// The loop used before, with its length check after every sample.
+static void unpack_rows(const array_type_t *type, const int8_t *samples,
+                        uint32_t length, rows_t *rows)
+{
+  uint32_t index = 0;
+  for (uint32_t sample = 0; sample < type->ref_samples; ++sample) {
+    rows->ref_i[0][sample] = samples[index++] / 127.0;
+    if (index == length) {
+      break;
+    }
+    rows->ref_q[0][sample] = samples[index++] / 127.0;
+    if (index == length) {
+      break;
+    }
+  }
+  index = type->ref_samples * 2;
+  for (uint32_t snapshot = 0; snapshot < type->snapshots; ++snapshot) {
+    for (uint32_t antenna = 0; antenna < type->elements; ++antenna) {
+      rows->i[snapshot][antenna] = samples[index++] / 127.0;
+      if (index == length) {
+        break;
+      }
+      rows->q[snapshot][antenna] = samples[index++] / 127.0;
+      if (index == length) {
+        break;
+      }
+    }
+    if (index == length) {
+      break;
+    }
+  }
+}
+
+// The unpacking of aoa_angle.c. Return the samples at full scale.
+static uint32_t unpack_buffers(const array_type_t *type, const int8_t *samples,
+                               uint32_t length, buffers_t *buffers)
+{
+  const uint32_t ref_length = type->ref_samples * 2;
+  uint32_t ref_saturated;
+  uint32_t saturated = 0;
+
+  aoa_iq_unpack(samples, length, buffers->ref_i.data, buffers->ref_q.data,
+                type->ref_samples, &ref_saturated);
+  if (length > ref_length) {
+    aoa_iq_unpack(&samples[ref_length], length - ref_length,
+                  buffers->i.data, buffers->q.data,
+                  type->snapshots * type->elements, &saturated);
+  }
+  return ref_saturated + saturated;
+}
+
+// Count the samples at full scale one by one.
+static uint32_t count_saturated(const int8_t *samples, uint32_t length)
+{
+  uint32_t saturated = 0;
+  for (uint32_t n = 0; n < length; n++) {
+    saturated += AOA_IQ_SATURATED(samples[n]);
+  }
+  return saturated;
+}
+
+// Count the samples that differ by more than one unit in the last place.
+static uint32_t compare(const float *expected, const float *actual,
+                        uint32_t count)
+{
+  uint32_t errors = 0;
+  for (uint32_t n = 0; n < count; n++) {
+    if (fabsf(expected[n] - actual[n]) > nextafterf(fabsf(expected[n]), 2.0f)
+        - fabsf(expected[n])) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+static bool check(const array_type_t *type, rows_t *rows, buffers_t *buffers)
+{
+  uint32_t errors = compare(rows->ref_i[0], buffers->ref_i.data, type->ref_samples)
+                    + compare(rows->ref_q[0], buffers->ref_q.data, type->ref_samples);
+  for (uint32_t s = 0; s < type->snapshots; s++) {
+    errors += compare(rows->i[s], buffers->i.rows[s], type->elements);
+    errors += compare(rows->q[s], buffers->q.rows[s], type->elements);
+  }
+  return errors == 0;
+}
+
+// Run one array type. Return false if the results differ.
+static bool run_type(const array_type_t *type, uint32_t count, uint32_t rounds,
+                     double *ns_rows, double *ns_buffers)
+{
+  uint32_t length = (type->ref_samples + type->snapshots * type->elements) * 2;
+  int8_t *reports = malloc((size_t)count * length);
+  rows_t rows;
+  buffers_t buffers;
+  uint64_t start;
+  bool ok = true;
+
+  // The reference rows are as long as the reference period, the rows of the
+  // loop used before were too short for it with the 1x4 ULA.
+  rows.ref_i = alloc_rows(1, type->ref_samples);
+  rows.ref_q = alloc_rows(1, type->ref_samples);
+  rows.i = alloc_rows(type->snapshots, type->elements);
+  rows.q = alloc_rows(type->snapshots, type->elements);
+  aoa_iq_buffer_alloc(&buffers.ref_i, 1, type->ref_samples);
+  aoa_iq_buffer_alloc(&buffers.ref_q, 1, type->ref_samples);
+  aoa_iq_buffer_alloc(&buffers.i, type->snapshots, type->elements);
+  aoa_iq_buffer_alloc(&buffers.q, type->snapshots, type->elements);
+
+  srand(1);
+  for (size_t n = 0; n < (size_t)count * length; n++) {
+    reports[n] = (int8_t)(rand() % 256 - 128);
+  }
+
+  // Full reports, then truncated ones. The loop used before read past the
+  // end of reports shorter than the reference period, those are left out.
+  for (uint32_t n = 0; n < count && ok; n++) {
+    uint32_t ref_length = type->ref_samples * 2;
+    uint32_t len = (n % 2 == 0) ? length
+                   : ref_length + 1 + n % (length - ref_length);
+    uint32_t saturated;
+    unpack_rows(type, &reports[(size_t)n * length], len, &rows);
+    saturated = unpack_buffers(type, &reports[(size_t)n * length], len, &buffers);
+    ok = check(type, &rows, &buffers);
+    if (!ok) {
+      fprintf(stderr, "%s: samples differ for report %u of length %u.\n",
+              type->name, n, len);
+    } else if (saturated != count_saturated(&reports[(size_t)n * length], len)) {
+      fprintf(stderr, "%s: saturated count differs for report %u of length %u.\n",
+              type->name, n, len);
+      ok = false;
+    }
+  }
+
+  start = now_ns();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t n = 0; n < count; n++) {
+      unpack_rows(type, &reports[(size_t)n * length], length, &rows);
+    }
+  }
+  *ns_rows = (double)(now_ns() - start) / ((double)count * rounds);
+
+  start = now_ns();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t n = 0; n < count; n++) {
+      unpack_buffers(type, &reports[(size_t)n * length], length, &buffers);
+    }
+  }
+  *ns_buffers = (double)(now_ns() - start) / ((double)count * rounds);
+
+  free_rows(rows.ref_i, 1);
+  free_rows(rows.ref_q, 1);
+  free_rows(rows.i, type->snapshots);
+  free_rows(rows.q, type->snapshots);
+  aoa_iq_buffer_free(&buffers.ref_i);
+  aoa_iq_buffer_free(&buffers.ref_q);
+  aoa_iq_buffer_free(&buffers.i);
+  aoa_iq_buffer_free(&buffers.q);
+  free(reports);
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t count = DEFAULT_REPORT_COUNT;
+  uint32_t rounds = DEFAULT_ROUNDS;
+  double ns_rows;
+  double ns_buffers;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:r:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        count = (uint32_t)atol(optarg);
+        break;
+      case 'r':
+        rounds = (uint32_t)atol(optarg);
+        break;
+      default:
+        printf("Usage: %s [-n <reports>] [-r <rounds>]\n", argv[0]);
+        return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (count == 0 || rounds == 0) {
+    fprintf(stderr, "The number of reports and rounds must be positive.\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("%-9s %8s %16s %16s %9s\n", "array", "samples", "before [ns]",
+         "aoa_iq [ns]", "speedup");
+  for (size_t t = 0; t < sizeof(array_types) / sizeof(array_types[0]); t++) {
+    const array_type_t *type = &array_types[t];
+    if (!run_type(type, count, rounds, &ns_rows, &ns_buffers)) {
+      return EXIT_FAILURE;
+    }
+    printf("%-9s %8u %16.1f %16.1f %8.2fx\n", type->name,
+           (type->ref_samples + type->snapshots * type->elements) * 2,
+           ns_rows, ns_buffers, ns_rows / ns_buffers);
+  }
+  return EXIT_SUCCESS;
+}
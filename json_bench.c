@@ -0,0 +1,213 @@
+/***************************************************************************//**
+ * @file
+ * @brief JSON formatter benchmark against snprintf.
+ *
+ * Formats the same set of synthetic angle results with the printf format the
+ * locator used before and with aoa_json_encode, checks that both give the
+ * same text and prints the time per result of each. The set mixes realistic
+ * angles with edge cases: zeros, negative zeros, halfway decimals and values
+ * too large for the fast path.
+ *
+ * Usage: json_bench [-n <results>] [-r <rounds>]
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "aoa_json.h"
+
+#define DEFAULT_RESULT_COUNT  4096
+#define DEFAULT_ROUNDS        200
+
+// The printf format of the JSON output with several dev boards.
+#define JSON_FORMAT \
+  "{\n\t\"timeStamp\": %d,\n\t\"type\": \"auditory\", \n\t\"locatorId\": \"%s\",\n\t\"tagId\": \"%02X\",\n\t\"azimuth\": %f,\n\t\"distance\": %f,\n\t\"elevation\": %f,\n\t\"quality\": %u\n}\r\n"
+
+// The printf format of the JSON output with a single dev board.
+#define JSON_FORMAT_SINGLE \
+  "{\n\t\"timeStamp\": %d,\n\t\"type\": \"auditory\", \n\t\"tagId\": \"%02X\",\n\t\"azimuth\": %f,\n\t\"distance\": %f,\n\t\"elevation\": %f,\n\t\"quality\": %u\n}\r\n"
+
+static const char locator_id[] = "ble-pd-000B57FF1325";
+
+static const float edge_values[] = {
+  0.0f, -0.0f, 0.0000005f, -0.0000005f, 0.0000015f, 0.5f, -179.999999f,
+  180.0f, 1e-7f, -1e-7f, 999999.9999995f, 1e11f, 1e12f, -1e20f, FLT_MAX,
+  -FLT_MAX, FLT_MIN, INFINITY, -INFINITY, NAN
+};
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static float random_float(float min, float max)
+{
+  return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+static void make_results(aoa_angle_t *angles, uint32_t count)
+{
+  const uint32_t edge_count = sizeof(edge_values) / sizeof(edge_values[0]);
+
+  srand(1);
+  for (uint32_t i = 0; i < count; i++) {
+    angles[i].azimuth = random_float(-180.0f, 180.0f);
+    angles[i].elevation = random_float(-90.0f, 90.0f);
+    angles[i].distance = random_float(0.0f, 20.0f);
+    angles[i].quality = (uint32_t)rand() % 1000;
+    angles[i].sequence = (i % 7 == 0) ? -(int32_t)i : (int32_t)i;
+    // Every 64th result has edge case angles.
+    if (i % 64 == 0) {
+      angles[i].azimuth = edge_values[(i / 64) % edge_count];
+      angles[i].elevation = edge_values[(i / 64 + 1) % edge_count];
+      angles[i].distance = edge_values[(i / 64 + 2) % edge_count];
+    }
+  }
+}
+
+static uint32_t format_snprintf(const aoa_angle_t *angle, uint8_t tag_id,
+                                char *buf)
+{
+  int rc = snprintf(buf, AOA_JSON_MAX_LEN, JSON_FORMAT, angle->sequence,
+                    locator_id, tag_id, angle->azimuth, angle->distance,
+                    angle->elevation, angle->quality);
+  return (rc < 0) ? 0 : (uint32_t)rc;
+}
+
+static uint32_t format_snprintf_single(const aoa_angle_t *angle,
+                                       uint8_t tag_id, char *buf)
+{
+  int rc = snprintf(buf, AOA_JSON_MAX_LEN, JSON_FORMAT_SINGLE,
+                    angle->sequence, tag_id, angle->azimuth, angle->distance,
+                    angle->elevation, angle->quality);
+  return (rc < 0) ? 0 : (uint32_t)rc;
+}
+
+// Run one formatter over all results. Return the time per result in ns.
+static double run_case(bool fast, const aoa_angle_t *angles, uint32_t count,
+                       uint32_t rounds, uint64_t *bytes)
+{
+  char buf[AOA_JSON_MAX_LEN];
+  uint64_t start;
+  uint64_t total = 0;
+
+  start = now_ns();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (fast) {
+        total += aoa_json_encode(locator_id, (uint8_t)i, &angles[i], buf);
+      } else {
+        total += format_snprintf(&angles[i], (uint8_t)i, buf);
+      }
+    }
+  }
+  *bytes = total;
+  return (double)(now_ns() - start) / ((double)count * rounds);
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t count = DEFAULT_RESULT_COUNT;
+  uint32_t rounds = DEFAULT_ROUNDS;
+  char expected[AOA_JSON_MAX_LEN];
+  char actual[AOA_JSON_MAX_LEN];
+  aoa_angle_t *angles;
+  uint64_t bytes_snprintf;
+  uint64_t bytes_fast;
+  double ns_snprintf;
+  double ns_fast;
+  uint32_t mismatches = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:r:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        count = (uint32_t)atol(optarg);
+        break;
+      case 'r':
+        rounds = (uint32_t)atol(optarg);
+        break;
+      default:
+        printf("Usage: %s [-n <results>] [-r <rounds>]\n", argv[0]);
+        return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (count == 0 || rounds == 0) {
+    fprintf(stderr, "The number of results and rounds must be positive.\n");
+    return EXIT_FAILURE;
+  }
+  angles = malloc(count * sizeof(*angles));
+  if (angles == NULL) {
+    return EXIT_FAILURE;
+  }
+  make_results(angles, count);
+
+  // Both formatters must give the same text, with and without the locator.
+  for (uint32_t i = 0; i < 2 * count; i++) {
+    uint32_t n = i % count;
+    uint32_t len;
+    if (i < count) {
+      len = aoa_json_encode(locator_id, (uint8_t)n, &angles[n], actual);
+      format_snprintf(&angles[n], (uint8_t)n, expected);
+    } else {
+      len = aoa_json_encode(NULL, (uint8_t)n, &angles[n], actual);
+      format_snprintf_single(&angles[n], (uint8_t)n, expected);
+    }
+    if (len != strlen(expected) || strcmp(actual, expected) != 0) {
+      if (mismatches++ < 5) {
+        fprintf(stderr, "Mismatch for result %u:\n%s%s", n, expected, actual);
+      }
+    }
+  }
+  if (mismatches > 0) {
+    fprintf(stderr, "%u of %u results differ.\n", mismatches, 2 * count);
+    free(angles);
+    return EXIT_FAILURE;
+  }
+
+  ns_snprintf = run_case(false, angles, count, rounds, &bytes_snprintf);
+  ns_fast = run_case(true, angles, count, rounds, &bytes_fast);
+  free(angles);
+
+  printf("%-16s %12s %12s\n", "formatter", "ns/result", "MB/s");
+  printf("%-16s %12.1f %12.1f\n", "snprintf", ns_snprintf,
+         (double)bytes_snprintf / rounds / count / ns_snprintf * 1e3);
+  printf("%-16s %12.1f %12.1f\n", "aoa_json_encode", ns_fast,
+         (double)bytes_fast / rounds / count / ns_fast * 1e3);
+  printf("speedup %.2fx, %u results checked\n", ns_snprintf / ns_fast, 2 * count);
+  return EXIT_SUCCESS;
+}
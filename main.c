@@ -41,9 +41,8 @@ static volatile bool run = true;
 static void signal_handler(int sig)
 {
   (void)sig;
+  // Stop the main loop, the application is deinitialized after it returns.
   run = false;
-  // Deinitialize the application.
-  app_deinit();
 }
 
 int main(int argc, char* argv[])
@@ -65,7 +64,13 @@ int main(int argc, char* argv[])
     // Do not remove this call: Silicon Labs components process action routine
     // must be called from the super loop.
     sl_system_process_action();
+
+    // Application process. Waits until there is something to do.
+    app_process_action();
   }
 
+  // Deinitialize the application.
+  app_deinit();
+
   return EXIT_SUCCESS;
 }
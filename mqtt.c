@@ -0,0 +1,187 @@
+/***************************************************************************//**
+ * @file
+ * @brief MQTT 3.1.1 packets
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "mqtt.h"
+
+#define MQTT_PROTOCOL_LEVEL     4
+#define MQTT_FLAG_USERNAME      0x80
+#define MQTT_FLAG_PASSWORD      0x40
+#define MQTT_FLAG_CLEAN_SESSION 0x02
+
+static uint8_t *put_remaining_length(uint8_t *p, uint32_t len);
+static uint8_t *put_string(uint8_t *p, const char *s, uint32_t len);
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+uint32_t mqtt_connect(uint8_t *buf,
+                      const char *client_id,
+                      const char *username,
+                      const char *password,
+                      uint16_t keep_alive)
+{
+  uint32_t client_id_len = (uint32_t)strnlen(client_id, MQTT_CLIENT_ID_MAX_LEN);
+  uint32_t username_len = 0;
+  uint32_t password_len = 0;
+  uint32_t len;
+  uint8_t flags = MQTT_FLAG_CLEAN_SESSION;
+  uint8_t *p = buf;
+
+  // Protocol name, level, flags and keep alive, then the payload.
+  len = 10 + 2 + client_id_len;
+  if (username != NULL) {
+    username_len = (uint32_t)strnlen(username, MQTT_USERNAME_MAX_LEN);
+    len += 2 + username_len;
+    flags |= MQTT_FLAG_USERNAME;
+    if (password != NULL) {
+      password_len = (uint32_t)strnlen(password, MQTT_PASSWORD_MAX_LEN);
+      len += 2 + password_len;
+      flags |= MQTT_FLAG_PASSWORD;
+    }
+  }
+
+  *p++ = MQTT_CONNECT;
+  p = put_remaining_length(p, len);
+  p = put_string(p, "MQTT", 4);
+  *p++ = MQTT_PROTOCOL_LEVEL;
+  *p++ = flags;
+  *p++ = (uint8_t)(keep_alive >> 8);
+  *p++ = (uint8_t)keep_alive;
+  p = put_string(p, client_id, client_id_len);
+  if (flags & MQTT_FLAG_USERNAME) {
+    p = put_string(p, username, username_len);
+  }
+  if (flags & MQTT_FLAG_PASSWORD) {
+    p = put_string(p, password, password_len);
+  }
+  return (uint32_t)(p - buf);
+}
+
+uint32_t mqtt_publish_header(uint8_t *buf,
+                             uint8_t qos,
+                             uint16_t packet_id,
+                             const char *topic,
+                             uint32_t topic_len,
+                             uint32_t payload_len)
+{
+  uint8_t *p = buf;
+  uint32_t len = 2 + topic_len + payload_len;
+
+  if (qos > 0) {
+    len += 2;
+  }
+  *p++ = (uint8_t)(MQTT_PUBLISH | (qos << 1));
+  p = put_remaining_length(p, len);
+  p = put_string(p, topic, topic_len);
+  if (qos > 0) {
+    *p++ = (uint8_t)(packet_id >> 8);
+    *p++ = (uint8_t)packet_id;
+  }
+  return (uint32_t)(p - buf);
+}
+
+uint32_t mqtt_empty_packet(uint8_t *buf, uint8_t type)
+{
+  buf[0] = type;
+  buf[1] = 0;
+  return 2;
+}
+
+int32_t mqtt_parse(const uint8_t *buf, uint32_t len, mqtt_packet_t *packet)
+{
+  uint32_t remaining = 0;
+  uint32_t pos = 1;
+  uint32_t shift = 0;
+
+  if (len < 2) {
+    return 0;
+  }
+  // Remaining length, 7 bits per byte, least significant first.
+  do {
+    if (pos == len) {
+      return 0;
+    }
+    if (pos > 4) {
+      return -1;
+    }
+    remaining |= (uint32_t)(buf[pos] & 0x7f) << shift;
+    shift += 7;
+  } while (buf[pos++] & 0x80);
+  if (len - pos < remaining) {
+    return 0;
+  }
+
+  memset(packet, 0, sizeof(*packet));
+  packet->type = buf[0] & 0xf0;
+  packet->flags = buf[0] & 0x0f;
+  switch (packet->type) {
+    case MQTT_CONNACK:
+      if (remaining != 2) {
+        return -1;
+      }
+      packet->return_code = buf[pos + 1];
+      break;
+    case MQTT_PUBACK:
+      if (remaining != 2) {
+        return -1;
+      }
+      packet->packet_id = (uint16_t)(buf[pos] << 8 | buf[pos + 1]);
+      break;
+    default:
+      break;
+  }
+  return (int32_t)(pos + remaining);
+}
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+static uint8_t *put_remaining_length(uint8_t *p, uint32_t len)
+{
+  do {
+    uint8_t byte = (uint8_t)(len & 0x7f);
+    len >>= 7;
+    if (len > 0) {
+      byte |= 0x80;
+    }
+    *p++ = byte;
+  } while (len > 0);
+  return p;
+}
+
+static uint8_t *put_string(uint8_t *p, const char *s, uint32_t len)
+{
+  *p++ = (uint8_t)(len >> 8);
+  *p++ = (uint8_t)len;
+  memcpy(p, s, len);
+  return p + len;
+}
@@ -0,0 +1,132 @@
+/***************************************************************************//**
+ * @file
+ * @brief MQTT 3.1.1 packets header file
+ *
+ * Encoding and parsing of the MQTT 3.1.1 control packets that a publishing
+ * client needs: CONNECT, PUBLISH, PINGREQ and DISCONNECT are written,
+ * CONNACK, PUBACK and PINGRESP are read. The functions work on buffers
+ * only, the connection is handled by the output module.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MQTT_PORT_DEFAULT        "1883"
+
+// Control packet types, in the upper nibble of the first byte.
+#define MQTT_CONNECT             0x10
+#define MQTT_CONNACK             0x20
+#define MQTT_PUBLISH             0x30
+#define MQTT_PUBACK              0x40
+#define MQTT_PINGREQ             0xc0
+#define MQTT_PINGRESP            0xd0
+#define MQTT_DISCONNECT          0xe0
+
+// Flag of a PUBLISH packet sent again.
+#define MQTT_PUBLISH_DUP         0x08
+
+// Length of the packets without payload.
+#define MQTT_PINGREQ_LEN         2
+#define MQTT_DISCONNECT_LEN      2
+
+// Longest PUBLISH header: fixed header with a 4 byte remaining length,
+// topic length and packet identifier, without the topic itself.
+#define MQTT_PUBLISH_HEADER_LEN  9
+
+// Longest strings of a CONNECT packet written here, and the longest packet:
+// fixed header, protocol name, level, flags, keep alive and the strings.
+#define MQTT_CLIENT_ID_MAX_LEN   64
+#define MQTT_USERNAME_MAX_LEN    64
+#define MQTT_PASSWORD_MAX_LEN    64
+#define MQTT_CONNECT_MAX_LEN     (3 + 10 + 6 + MQTT_CLIENT_ID_MAX_LEN + MQTT_USERNAME_MAX_LEN \
+                                  + MQTT_PASSWORD_MAX_LEN)
+
+// Packet received from the broker.
+typedef struct {
+  uint8_t type;             // Packet type, e.g. MQTT_CONNACK
+  uint8_t flags;            // Lower nibble of the first byte
+  uint8_t return_code;      // CONNACK: 0 if the connection is accepted
+  uint16_t packet_id;       // PUBACK: identifier of the PUBLISH
+} mqtt_packet_t;
+
+/**************************************************************************//**
+ * Write a CONNECT packet with a clean session.
+ * @param[out] buf Buffer of at least MQTT_CONNECT_MAX_LEN bytes.
+ * @param[in] client_id Client identifier.
+ * @param[in] username User name or NULL.
+ * @param[in] password Password or NULL, only used with a user name.
+ * @param[in] keep_alive Keep alive interval in seconds.
+ * @return Length of the packet.
+ *****************************************************************************/
+uint32_t mqtt_connect(uint8_t *buf,
+                      const char *client_id,
+                      const char *username,
+                      const char *password,
+                      uint16_t keep_alive);
+
+/**************************************************************************//**
+ * Write the header of a PUBLISH packet, the payload follows it.
+ * @param[out] buf Buffer of at least MQTT_PUBLISH_HEADER_LEN + topic_len
+ *                 bytes.
+ * @param[in] qos Quality of service, 0 or 1.
+ * @param[in] packet_id Packet identifier, not used with QoS 0.
+ * @param[in] topic Topic name.
+ * @param[in] topic_len Length of the topic name.
+ * @param[in] payload_len Length of the payload.
+ * @return Length of the header.
+ *****************************************************************************/
+uint32_t mqtt_publish_header(uint8_t *buf,
+                             uint8_t qos,
+                             uint16_t packet_id,
+                             const char *topic,
+                             uint32_t topic_len,
+                             uint32_t payload_len);
+
+/**************************************************************************//**
+ * Write a packet without variable header and payload.
+ * @param[out] buf Buffer of at least 2 bytes.
+ * @param[in] type Packet type, MQTT_PINGREQ or MQTT_DISCONNECT.
+ * @return Length of the packet.
+ *****************************************************************************/
+uint32_t mqtt_empty_packet(uint8_t *buf, uint8_t type);
+
+/**************************************************************************//**
+ * Parse a received packet.
+ * @param[in] buf Received bytes.
+ * @param[in] len Number of received bytes.
+ * @param[out] packet Parsed packet.
+ * @return Length of the packet, 0 if it is not complete yet, -1 if it is
+ *         malformed. Packets of other types are returned with their type
+ *         only, to be skipped.
+ *****************************************************************************/
+int32_t mqtt_parse(const uint8_t *buf, uint32_t len, mqtt_packet_t *packet);
+
+#endif // MQTT_H
@@ -0,0 +1,503 @@
+/***************************************************************************//**
+ * @file
+ * @brief BGAPI NCP emulator streaming synthetic CTE IQ reports over TCP.
+ *
+ * Listens on the NCP TCP port and behaves like a locator board to the extent
+ * the application needs: it answers the commands sent at boot and, once
+ * Silabs CTE reception is enabled, sends silabs IQ report events of the
+ * configured tags. The IQ samples describe a plane wave arriving from the
+ * configured direction, so the full pipeline from the NCP host to the angle
+ * estimation can be load tested without boards or tags.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "sl_bt_api.h"
+
+// Optstring argument for getopt.
+#define OPTSTRING      "p:n:r:c:a:A:E:w:N:h"
+
+// Usage info.
+#define USAGE          "\n%s [-p <port>] [-n <tags>] [-r <rate>] [-c <count>] [-a <array_type>] [-A <azimuth>] [-E <elevation>] [-w <sweep>] [-N <noise>] [-h]\n"
+
+// Options info.
+#define OPTIONS                                                                               \
+  "\nOPTIONS\n"                                                                               \
+  "    -p  TCP port to listen on.\n"                                                          \
+  "        <port>           Port number, default: 4901\n"                                     \
+  "    -n  Number of emulated tags.\n"                                                        \
+  "        <tags>           Tag count, default: 4\n"                                          \
+  "    -r  IQ report rate of each tag.\n"                                                     \
+  "        <rate>           Reports per second, default: 50\n"                                \
+  "    -c  Number of IQ reports per tag after which the stream stops.\n"                      \
+  "        <count>          Report count, default: 0 (unlimited)\n"                           \
+  "    -a  Antenna array type, must match the array of the locator.\n"                        \
+  "        <array_type>     4x4 (default), 3x3 or 1x4\n"                                      \
+  "    -A  Azimuth of the first tag. Further tags are spread evenly around it.\n"             \
+  "        <azimuth>        Azimuth in degrees, default: 0\n"                                 \
+  "    -E  Elevation of all tags.\n"                                                          \
+  "        <elevation>      Elevation in degrees, default: 45\n"                              \
+  "    -w  Rotate the tags around the locator.\n"                                             \
+  "        <sweep>          Azimuth change in degrees per second, default: 0\n"               \
+  "    -N  Amplitude of the uniform noise added to the samples.\n"                            \
+  "        <noise>          Noise amplitude, default: 2, max: 255 (signal is 100)\n"          \
+  "    -h  Print this help message.\n"
+
+#define DEFAULT_PORT                  4901
+#define DEFAULT_TAG_COUNT             4
+#define DEFAULT_RATE                  50.0
+#define DEFAULT_ELEVATION             45.0
+#define DEFAULT_NOISE                 2
+#define MAX_TAGS                      256
+// Noise spanning the whole sample range, more would only be clipped.
+#define MAX_NOISE                     (INT8_MAX - INT8_MIN)
+
+// Signal amplitude of the IQ samples.
+#define IQ_AMPLITUDE                  100.0
+// Element spacing of the antenna arrays in meters.
+#define ARRAY_ELEMENT_SPACING         0.04
+#define SPEED_OF_LIGHT                299792458.0
+// Phase advance of the 250 kHz CTE tone between samples taken 1 us apart.
+#define CTE_PHASE_STEP                (M_PI / 2)
+#define REF_PERIOD_SAMPLES            7
+// Reports sent late by more than this are skipped instead of sent in a burst.
+#define MAX_LAG_NS                    1000000000ULL
+
+// BGAPI response header for a command ID and payload length.
+#define BGAPI_HEADER(id, len)         ((id) | (((len) & 0xff) << 8) | (((len) >> 8) & 0x7))
+
+typedef struct {
+  const char *name;
+  uint8_t rows;
+  uint8_t columns;
+  uint8_t snapshots;
+} array_type_t;
+
+static const array_type_t array_types[] = {
+  { "4x4", 4, 4, 4 },
+  { "3x3", 3, 3, 4 },
+  { "1x4", 1, 4, 18 },
+};
+
+// Configuration.
+static uint16_t port = DEFAULT_PORT;
+static uint32_t tag_count = DEFAULT_TAG_COUNT;
+static double rate = DEFAULT_RATE;
+static uint32_t count = 0;
+static const array_type_t *array_type = &array_types[0];
+static double azimuth = 0.0;
+static double elevation = DEFAULT_ELEVATION;
+static double sweep = 0.0;
+static int noise = DEFAULT_NOISE;
+
+// Runtime state.
+static volatile bool run = true;
+static bool streaming = false;
+static uint64_t stream_start;
+static uint64_t reports_due;
+static uint64_t reports_sent;
+static uint16_t packet_counter[MAX_TAGS];
+
+static void signal_handler(int sig)
+{
+  (void)sig;
+  run = false;
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**************************************************************************//**
+ * Send a complete buffer. Returns false if the host disconnected.
+ *****************************************************************************/
+static bool send_all(int fd, const void *data, size_t len)
+{
+  const uint8_t *p = data;
+
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+static bool send_msg(int fd, uint32_t id, const void *payload, uint16_t len)
+{
+  uint8_t buf[SL_BGAPI_MSG_HEADER_LEN + SL_BGAPI_MAX_PAYLOAD_SIZE];
+  uint32_t header = BGAPI_HEADER(id, len);
+
+  memcpy(buf, &header, sizeof(header));
+  memcpy(&buf[SL_BGAPI_MSG_HEADER_LEN], payload, len);
+  return send_all(fd, buf, SL_BGAPI_MSG_HEADER_LEN + len);
+}
+
+static float channel_to_frequency(uint8_t channel)
+{
+  static const uint8_t logical_to_physical_channel[40] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 14, 15, 16, 17, 18, 19, 20, 21,
+    22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38,
+    0, 12, 39
+  };
+
+  return 2402000000 + 2000000 * logical_to_physical_channel[channel];
+}
+
+/**************************************************************************//**
+ * Add noise to a sample value and clip it to the range of the samples.
+ *****************************************************************************/
+static int8_t noisy_sample(double value)
+{
+  long sample = lrint(value) + rand() % (2 * noise + 1) - noise;
+
+  if (sample > INT8_MAX) {
+    return INT8_MAX;
+  }
+  if (sample < INT8_MIN) {
+    return INT8_MIN;
+  }
+  return (int8_t)sample;
+}
+
+/**************************************************************************//**
+ * Fill in the IQ samples of a plane wave arriving from the given direction.
+ *
+ * The reference period is sampled on the first antenna every microsecond,
+ * then the antennas are sampled in order every other microsecond. The phase
+ * of each antenna sample is the tone phase at that time plus the path
+ * difference to the element. The axes are those of the angle estimation:
+ * azimuth 0 points against the column direction of the array.
+ *****************************************************************************/
+static uint8_t fill_samples(int8_t *samples, double az, double el,
+                            uint8_t channel)
+{
+  double k = 2 * M_PI * channel_to_frequency(channel) / SPEED_OF_LIGHT;
+  double ux = -cos(el) * cos(az);
+  double uy = cos(el) * sin(az);
+  double phase = 2 * M_PI * rand() / RAND_MAX;
+  uint8_t elements = array_type->rows * array_type->columns;
+  uint8_t len = 0;
+
+  for (uint8_t i = 0; i < REF_PERIOD_SAMPLES; i++) {
+    samples[len++] = noisy_sample(IQ_AMPLITUDE * cos(phase));
+    samples[len++] = noisy_sample(IQ_AMPLITUDE * sin(phase));
+    phase += CTE_PHASE_STEP;
+  }
+  for (uint8_t s = 0; s < array_type->snapshots; s++) {
+    for (uint8_t e = 0; e < elements; e++) {
+      double x = (e % array_type->columns) * ARRAY_ELEMENT_SPACING;
+      double y = (e / array_type->columns) * ARRAY_ELEMENT_SPACING;
+      double p = phase + k * (x * ux + y * uy);
+      samples[len++] = noisy_sample(IQ_AMPLITUDE * cos(p));
+      samples[len++] = noisy_sample(IQ_AMPLITUDE * sin(p));
+      phase += 2 * CTE_PHASE_STEP;
+    }
+  }
+  return len;
+}
+
+static bool send_iq_report(int fd, uint32_t tag, double t)
+{
+  sl_bt_msg_t msg;
+  sl_bt_evt_cte_receiver_silabs_iq_report_t *evt =
+    &msg.data.evt_cte_receiver_silabs_iq_report;
+  double az = azimuth + 360.0 * tag / tag_count + sweep * t;
+  uint16_t len;
+
+  evt->status = 0;
+  // Tag addresses 00:0B:57:00:TT:TT.
+  evt->address.addr[0] = (uint8_t)tag;
+  evt->address.addr[1] = (uint8_t)(tag >> 8);
+  evt->address.addr[2] = 0x00;
+  evt->address.addr[3] = 0x57;
+  evt->address.addr[4] = 0x0b;
+  evt->address.addr[5] = 0x00;
+  evt->address_type = 0;
+  evt->phy = 1;
+  evt->channel = packet_counter[tag] % 37;
+  evt->rssi = -50;
+  evt->rssi_antenna_id = 0;
+  evt->cte_type = 0;
+  evt->slot_durations = 1;
+  evt->packet_counter = packet_counter[tag]++;
+  evt->samples.len = fill_samples((int8_t *)evt->samples.data,
+                                  fmod(az, 360.0) * M_PI / 180.0,
+                                  elevation * M_PI / 180.0,
+                                  evt->channel);
+  len = sizeof(*evt) + evt->samples.len;
+  return send_msg(fd, sl_bt_evt_cte_receiver_silabs_iq_report_id,
+                  evt, len);
+}
+
+/**************************************************************************//**
+ * Send the IQ reports that are due. Returns false if the host disconnected.
+ *****************************************************************************/
+static bool send_due_reports(int fd)
+{
+  uint64_t now = now_ns();
+  uint64_t period = (uint64_t)(1e9 / rate);
+  uint64_t due = (now - stream_start) / period + 1;
+
+  if (count != 0 && due > count) {
+    due = count;
+  }
+  if (due > reports_due + MAX_LAG_NS / period) {
+    // The host did not keep up, do not try to catch up.
+    reports_due = due - 1;
+  }
+  while (reports_due < due) {
+    double t = (double)(reports_due * period) / 1e9;
+    for (uint32_t tag = 0; tag < tag_count; tag++) {
+      if (!send_iq_report(fd, tag, t)) {
+        return false;
+      }
+      reports_sent++;
+    }
+    reports_due++;
+  }
+  return true;
+}
+
+/**************************************************************************//**
+ * Answer a command of the host. Returns false if the host disconnected.
+ *****************************************************************************/
+static bool handle_command(int fd, uint32_t header, const uint8_t *payload)
+{
+  uint32_t id = SL_BGAPI_MSG_ID(header);
+  uint8_t rsp[16] = { 0 };
+
+  (void)payload;
+  switch (id) {
+    case sl_bt_cmd_system_reset_id:
+    {
+      // No response, the board reboots.
+      sl_bt_evt_system_boot_t boot = { 3, 2, 0, 0, 0, 0, 0 };
+      streaming = false;
+      printf("Reset, sending boot event.\n");
+      return send_msg(fd, sl_bt_evt_system_boot_id, &boot, sizeof(boot));
+    }
+    case sl_bt_cmd_system_get_identity_address_id:
+      // Result, then address 00:0B:57:FF:PP:PP derived from the port, so
+      // that emulators on different ports have different locator IDs.
+      rsp[2] = (uint8_t)port;
+      rsp[3] = (uint8_t)(port >> 8);
+      rsp[4] = 0xff;
+      rsp[5] = 0x57;
+      rsp[6] = 0x0b;
+      rsp[7] = 0x00;
+      rsp[8] = 0;
+      return send_msg(fd, id, rsp, 9);
+    case sl_bt_cmd_cte_receiver_enable_silabs_cte_id:
+      streaming = true;
+      stream_start = now_ns();
+      reports_due = 0;
+      printf("Silabs CTE enabled, streaming %u tags at %.1f Hz.\n",
+             tag_count, rate);
+      return send_msg(fd, id, rsp, sizeof(uint16_t));
+    default:
+      // Event filter, scanner setup and anything else simply succeed.
+      return send_msg(fd, id, rsp, sizeof(uint16_t));
+  }
+}
+
+/**************************************************************************//**
+ * Serve one host connection until it disconnects.
+ *****************************************************************************/
+static void serve(int fd)
+{
+  uint8_t buf[4096];
+  size_t len = 0;
+  int one = 1;
+
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  memset(packet_counter, 0, sizeof(packet_counter));
+  streaming = false;
+
+  while (run) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int timeout = -1;
+
+    if (streaming && (count == 0 || reports_due < count)) {
+      uint64_t period = (uint64_t)(1e9 / rate);
+      uint64_t next = stream_start + (reports_due + 1) * period;
+      uint64_t now = now_ns();
+      timeout = (next > now) ? (int)((next - now + 999999) / 1000000) : 0;
+    }
+    if (poll(&pfd, 1, timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (pfd.revents != 0) {
+      ssize_t n = recv(fd, &buf[len], sizeof(buf) - len, 0);
+      if (n <= 0) {
+        break;
+      }
+      len += (size_t)n;
+      // Handle every complete command.
+      while (len >= SL_BGAPI_MSG_HEADER_LEN) {
+        uint32_t header;
+        size_t frame_len;
+        memcpy(&header, buf, sizeof(header));
+        frame_len = SL_BGAPI_MSG_HEADER_LEN + SL_BGAPI_MSG_LEN(header);
+        if (len < frame_len) {
+          break;
+        }
+        if (!handle_command(fd, header, &buf[SL_BGAPI_MSG_HEADER_LEN])) {
+          return;
+        }
+        memmove(buf, &buf[frame_len], len - frame_len);
+        len -= frame_len;
+      }
+    }
+    if (streaming && !send_due_reports(fd)) {
+      break;
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  struct sockaddr_in addr = { 0 };
+  struct sigaction sa = { 0 };
+  int srv;
+  int opt;
+  int one = 1;
+
+  while ((opt = getopt(argc, argv, OPTSTRING)) != -1) {
+    switch (opt) {
+      case 'p':
+        port = (uint16_t)atoi(optarg);
+        break;
+      case 'n':
+        tag_count = (uint32_t)atol(optarg);
+        break;
+      case 'r':
+        rate = atof(optarg);
+        break;
+      case 'c':
+        count = (uint32_t)atol(optarg);
+        break;
+      case 'a':
+        array_type = NULL;
+        for (size_t i = 0; i < sizeof(array_types) / sizeof(array_types[0]); i++) {
+          if (strcmp(optarg, array_types[i].name) == 0) {
+            array_type = &array_types[i];
+          }
+        }
+        if (array_type == NULL) {
+          fprintf(stderr, "Unknown array type: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'A':
+        azimuth = atof(optarg);
+        break;
+      case 'E':
+        elevation = atof(optarg);
+        break;
+      case 'w':
+        sweep = atof(optarg);
+        break;
+      case 'N':
+        noise = atoi(optarg);
+        break;
+      case 'h':
+        printf(USAGE, argv[0]);
+        printf(OPTIONS);
+        exit(EXIT_SUCCESS);
+      default:
+        printf(USAGE, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+  if (tag_count == 0 || tag_count > MAX_TAGS || rate <= 0 || noise < 0
+      || noise > MAX_NOISE) {
+    fprintf(stderr, "Invalid tag count, rate or noise.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // No SA_RESTART, so that a signal interrupts accept and poll.
+  sa.sa_handler = signal_handler;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  srv = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (srv < 0 || bind(srv, (struct sockaddr *)&addr, sizeof(addr)) < 0
+      || listen(srv, 1) < 0) {
+    perror("Failed to listen");
+    exit(EXIT_FAILURE);
+  }
+  printf("Listening on port %u, %u tags, %s array.\n", port, tag_count,
+         array_type->name);
+
+  while (run) {
+    uint64_t start;
+    int fd = accept(srv, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    printf("Host connected.\n");
+    reports_sent = 0;
+    start = now_ns();
+    serve(fd);
+    close(fd);
+    printf("Host disconnected, %llu IQ reports sent, %.1f reports/s.\n",
+           (unsigned long long)reports_sent,
+           reports_sent * 1e9 / (double)(now_ns() - start));
+  }
+  close(srv);
+  return EXIT_SUCCESS;
+}
@@ -34,20 +34,37 @@
 #include "sl_status.h"
 
 // Optstring argument for getopt.
-#define NCP_HOST_OPTSTRING "t:u:b:f"
+#define NCP_HOST_OPTSTRING "t:u:r:b:fLq:Q:B:w:R:"
 
 // Usage info.
-#define NCP_HOST_USAGE "-t <tcp_address> | -u <serial_port> [-b <baud_rate>] [-f]"
+#define NCP_HOST_USAGE "-t <tcp_address> | -u <serial_port> | -r <capture_file> [-R <speed>] [-w <capture_file>] [-b <baud_rate>] [-f] [-L] [-q <queue_depth>] [-Q <policy>] [-B <budget>]"
 
 // Options info.
 #define NCP_HOST_OPTIONS                                                                                                       \
-  "    -t  TCP/IP connection option.\n"                                                                                        \
-  "        <tcp_address>    TCP/IP address of the dev board.\n"                                                                \
-  "    -u  UART serial connection option.\n"                                                                                   \
+  "    -t  TCP/IP connection option. Can be repeated together with -u to use several dev boards.\n"                            \
+  "        <tcp_address>    TCP/IP address of the dev board, optionally followed by :<port> (default: 4901).\n"                \
+  "    -u  UART serial connection option. Can be repeated together with -t to use several dev boards.\n"                       \
   "        <serial_port>    Serial port assigned to the dev board by the host system. (COM# on Windows, /dev/tty# on POSIX)\n" \
+  "        With several dev boards, the JSON results carry the \"locatorId\" of their board.\n"                                \
+  "    -r  Replay a capture file instead of connecting to a dev board. Can be repeated like -t and -u.\n"                      \
+  "        <capture_file>   File written with -w\n"                                                                            \
+  "    -R  Replay speed.\n"                                                                                                    \
+  "        <speed>          1: original pace (default), N: N times faster, 0: as fast as possible\n"                           \
+  "    -w  Capture the data received from the dev boards with timestamps.\n"                                                   \
+  "        <capture_file>   Output file, .0, .1, ... is appended if there are several dev boards\n"                            \
   "    -b  Baud rate of the serial connection.\n"                                                                              \
-  "        <baud_rate>      Baud rate, default: 115200\n"                                                                      \
-  "    -f  Disable flow control (RTS/CTS), default: enabled\n"
+  "        <baud_rate>      Baud rate, e.g. 115200 (default), 921600, 2000000\n"                                               \
+  "    -f  Disable flow control (RTS/CTS), default: enabled\n"                                                                 \
+  "    -L  Low latency serial mode: read received bytes as soon as they arrive, default: disabled\n"                           \
+  "    -q  Number of events that can be queued while the application is busy.\n"                                               \
+  "        <queue_depth>    Queue depth, default: 29\n"                                                                        \
+  "    -Q  What to drop when the event queue is full.\n"                                                                       \
+  "        <policy>         newest: drop the received event (default)\n"                                                       \
+  "                         oldest: drop the oldest queued event\n"                                                            \
+  "                         boot:   drop the received event unless it is a boot event\n"                                       \
+  "                         wait:   stop reading until there is room (default with -R 0)\n"                                    \
+  "    -B  Maximum number of events handled in one pass of the main loop.\n"                                                   \
+  "        <budget>         Event budget, default: 32\n"
 
 /**************************************************************************//**
  * Initialize NCP connection.
@@ -1,6 +1,6 @@
 /***************************************************************************//**
  * @file
- * @brief NCP host application module without threading.
+ * @brief NCP host application module.
  *******************************************************************************
  * # License
  * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
@@ -32,96 +32,218 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
 #include "uart.h"
 #include "tcp.h"
+#include "capture.h"
 #include "app_assert.h"
 #include "app_log.h"
 #include "sl_bt_ncp_host.h"
 #include "ncp_host.h"
+#include "system.h"
 
-#if !(defined(POSIX) && POSIX == 1)
+#if defined(POSIX) && POSIX == 1
+#include <unistd.h>
+#include "app_poll.h"
+#else // defined(POSIX) && POSIX == 1
 #include <windows.h>
-#endif
+#endif // defined(POSIX) && POSIX == 1
 
 // Default parameter values.
-#define DEFAULT_UART_PORT             ""
 #define DEFAULT_UART_BAUD_RATE        115200
 #define DEFAULT_UART_FLOW_CONTROL     1
 #define DEFAULT_UART_TIMEOUT          100
-#define DEFAUKT_TCP_ADDRESS           ""
 #define DEFAULT_TCP_PORT              "4901"
+#define DEFAULT_QUEUE_DEPTH           (SL_BT_API_QUEUE_LEN - 1)
+#define DEFAULT_REPLAY_SPEED          1.0f
+#define REPLAY_DRAIN_POLL_US          1000
 #define MAX_OPT_LEN                   255
 
 #define IS_EMPTY_STRING(s)            ((s)[0] == '\0')
 #define HANDLE_VALUE_MIN              0
 
-// UART serial port options.
-static char uart_port[MAX_OPT_LEN] = DEFAULT_UART_PORT;
+// UART serial port options, common to all serial connections.
 static uint32_t uart_baud_rate = DEFAULT_UART_BAUD_RATE;
 static uint32_t uart_flow_control = DEFAULT_UART_FLOW_CONTROL;
+static bool uart_low_latency = false;
 
-// TCP/IP address.
-static char tcp_address[MAX_OPT_LEN] = DEFAUKT_TCP_ADDRESS;
+// Event queue options.
+static uint32_t queue_depth = DEFAULT_QUEUE_DEPTH;
+static bool overflow_policy_set = false;
 
+// Capture and replay options, common to all connections.
+static char capture_path[MAX_OPT_LEN];
+static float replay_speed = DEFAULT_REPLAY_SPEED;
+static uint8_t replays_running = 0;
+
+// Connection to one NCP, in the order of the command line options.
+typedef struct {
+  char uart_port[MAX_OPT_LEN];
+  char tcp_address[MAX_OPT_LEN];
+  char replay_path[MAX_OPT_LEN];
+  replay_t replay;
+  capture_t capture;
 #if defined(POSIX) && POSIX == 1
-static int32_t handle = -1;
+  int32_t handle;
 #else // defined(POSIX) && POSIX == 1
-static HANDLE serial_handle;
-static SOCKET socket_handle;
+  HANDLE serial_handle;
+  SOCKET socket_handle;
 #endif // defined(POSIX) && POSIX == 1
+  void *handle_ptr;
+  int32_t (*tx_ptr)(void *handle, uint32_t len, uint8_t *data);
+  int32_t (*rx_ptr)(void *handle, uint32_t len, uint8_t *data);
+  int32_t (*peek_ptr)(void *handle);
+} ncp_host_conn_t;
 
-static void *handle_ptr;
-static int32_t (*tx_ptr)(void *handle, uint32_t len, uint8_t *data);
-static int32_t (*rx_ptr)(void *handle, uint32_t len, uint8_t *data);
-static int32_t (*peek_ptr)(void *handle);
+static ncp_host_conn_t conns[SL_BT_API_MAX_INSTANCES];
+static uint8_t conn_count = 0;
 
+static sl_status_t ncp_host_open(ncp_host_conn_t *conn);
+static void ncp_host_close(ncp_host_conn_t *conn);
 static void ncp_host_tx(uint32_t len, uint8_t *data);
 static int32_t ncp_host_rx(uint32_t len, uint8_t *data);
+static void ncp_host_on_replay_end(ncp_host_conn_t *conn);
+
+#if defined(POSIX) && POSIX == 1
+static void ncp_host_on_event(int fd, short revents, void *ctx);
+#else // defined(POSIX) && POSIX == 1
 static int32_t ncp_host_peek(void);
+#endif // defined(POSIX) && POSIX == 1
 
 /**************************************************************************//**
  * Initialize NCP connection.
  *****************************************************************************/
 sl_status_t ncp_host_init(void)
+{
+  sl_status_t sc;
+  uint8_t i;
+
+  if (queue_depth != DEFAULT_QUEUE_DEPTH) {
+    sc = sl_bt_api_set_queue_depth(queue_depth);
+    if (sc != SL_STATUS_OK) {
+      app_log_error("Failed to set event queue depth to %u." APP_LOG_NL,
+                    queue_depth);
+      return sc;
+    }
+  }
+
+  if (conn_count == 0) {
+    app_log_error("Either UART serial port, TCP/IP address or capture file is mandatory."
+                  APP_LOG_NL);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+
+  for (i = 0; i < conn_count; i++) {
+    sc = ncp_host_open(&conns[i]);
+    if (sc != SL_STATUS_OK) {
+      return sc;
+    }
+#if defined(POSIX) && POSIX == 1
+    sc = sl_bt_api_initialize(ncp_host_tx, ncp_host_rx);
+#else // defined(POSIX) && POSIX == 1
+    sc = sl_bt_api_initialize_nonblock(ncp_host_tx, ncp_host_rx, ncp_host_peek);
+#endif // defined(POSIX) && POSIX == 1
+    if (sc != SL_STATUS_OK) {
+      return sc;
+    }
+  }
+
+  if (replays_running > 0 && replay_speed == 0 && !overflow_policy_set) {
+    // Replaying as fast as possible must not drop events.
+    sl_bt_api_set_overflow_policy(SL_BT_API_OVERFLOW_WAIT);
+  }
+
+#if defined(POSIX) && POSIX == 1
+  // The NCPs are read by dedicated threads, so that the input is drained
+  // while the main loop is busy with angle estimation. The main loop sleeps
+  // until a thread queues events.
+  sc = sl_bt_api_start_rx_thread();
+  if (sc != SL_STATUS_OK) {
+    return sc;
+  }
+  return app_poll_add(sl_bt_api_get_event_fd(), POLLIN, ncp_host_on_event, NULL);
+#else // defined(POSIX) && POSIX == 1
+  return SL_STATUS_OK;
+#endif // defined(POSIX) && POSIX == 1
+}
+
+/**************************************************************************//**
+ * Open the connection to one NCP.
+ *****************************************************************************/
+static sl_status_t ncp_host_open(ncp_host_conn_t *conn)
 {
   int32_t status;
+  char address[MAX_OPT_LEN];
+  char path[MAX_OPT_LEN + 4];
+  char *port;
 
-  if (!IS_EMPTY_STRING(uart_port)) {
+  if (!IS_EMPTY_STRING(conn->replay_path)) {
+    // Replay a capture file instead of talking to an NCP.
+    conn->handle_ptr = &conn->replay;
+    conn->tx_ptr = replay_tx;
+    conn->rx_ptr = replay_rx;
+    conn->peek_ptr = replay_peek;
+    status = replay_open(conn->handle_ptr, conn->replay_path, replay_speed);
+    app_assert(status == 0,
+               "[E: %d] Failed to open capture file %s" APP_LOG_NL,
+               status, conn->replay_path);
+    replays_running++;
+  } else if (!IS_EMPTY_STRING(conn->uart_port)) {
     // Initialise UART serial connection.
 #if defined(POSIX) && POSIX == 1
-    handle_ptr = &handle;
+    conn->handle_ptr = &conn->handle;
 #else // defined(POSIX) && POSIX == 1
-    handle_ptr = &serial_handle;
+    conn->handle_ptr = &conn->serial_handle;
 #endif // defined(POSIX) && POSIX == 1
-    tx_ptr = uartTx;
-    rx_ptr = uartRx;
-    peek_ptr = uartRxPeek;
-    status = uartOpen(handle_ptr, (int8_t *)uart_port, uart_baud_rate,
+    conn->tx_ptr = uartTx;
+    conn->rx_ptr = uartRxNonBlocking;
+    conn->peek_ptr = uartRxPeek;
+    status = uartOpen(conn->handle_ptr, (int8_t *)conn->uart_port, uart_baud_rate,
                       uart_flow_control, DEFAULT_UART_TIMEOUT);
     app_assert(status >= HANDLE_VALUE_MIN,
                "[E: %d] Failed to open UART serial connection"
                APP_LOG_NL, status);
-  } else if (!IS_EMPTY_STRING(tcp_address)) {
+    if (uart_low_latency && (uartSetLowLatency(conn->handle_ptr) != 0)) {
+      app_log_warning("Failed to set low latency mode on %s" APP_LOG_NL,
+                      conn->uart_port);
+    }
+  } else {
     // Initialise TCP/IP connection.
 #if defined(POSIX) && POSIX == 1
-    handle_ptr = &handle;
+    conn->handle_ptr = &conn->handle;
 #else // defined(POSIX) && POSIX == 1
-    handle_ptr = &socket_handle;
+    conn->handle_ptr = &conn->socket_handle;
 #endif // defined(POSIX) && POSIX == 1
-    tx_ptr = tcp_tx;
-    rx_ptr = tcp_rx;
-    peek_ptr = tcp_rx_peek;
-    status = tcp_open(handle_ptr, tcp_address, DEFAULT_TCP_PORT);
+    conn->tx_ptr = tcp_tx;
+    conn->rx_ptr = tcp_rx_partial;
+    conn->peek_ptr = tcp_rx_peek;
+    // The port is optional after the address.
+    strcpy(address, conn->tcp_address);
+    strtok(address, ":");
+    port = strtok(NULL, ":");
+    status = tcp_open(conn->handle_ptr, address,
+                      (port != NULL) ? port : DEFAULT_TCP_PORT);
     app_assert(status == HANDLE_VALUE_MIN,
                "[E: %d] Failed to open TCP/IP connection" APP_LOG_NL,
                status);
-  } else {
-    app_log_error("Either UART serial port or TCP/IP address is mandatory."
-                  APP_LOG_NL);
-    return SL_STATUS_INVALID_PARAMETER;
   }
 
-  return sl_bt_api_initialize_nonblock(ncp_host_tx, ncp_host_rx, ncp_host_peek);
+  if (!IS_EMPTY_STRING(capture_path)) {
+    // Each connection is captured into its own file, numbered if there are
+    // several of them.
+    if (conn_count > 1) {
+      snprintf(path, sizeof(path), "%s.%u", capture_path,
+               (unsigned)(conn - conns));
+    } else {
+      strcpy(path, capture_path);
+    }
+    status = capture_open(&conn->capture, path);
+    app_assert(status == 0,
+               "[E: %d] Failed to create capture file %s" APP_LOG_NL,
+               status, path);
+  }
+  return SL_STATUS_OK;
 }
 
 /**************************************************************************//**
@@ -134,11 +256,21 @@ sl_status_t ncp_host_set_option(char option, char *value)
   switch (option) {
     // TCP/IP address.
     case 't':
-      strncpy(tcp_address, value, MAX_OPT_LEN);
-      break;
     // UART serial port.
     case 'u':
-      strncpy(uart_port, value, MAX_OPT_LEN);
+    // Capture file to replay.
+    case 'r':
+      if (conn_count == SL_BT_API_MAX_INSTANCES) {
+        app_log_error("At most %d NCP connections are supported." APP_LOG_NL,
+                      SL_BT_API_MAX_INSTANCES);
+        sc = SL_STATUS_FULL;
+        break;
+      }
+      memset(&conns[conn_count], 0, sizeof(conns[conn_count]));
+      strncpy((option == 't') ? conns[conn_count].tcp_address
+              : (option == 'u') ? conns[conn_count].uart_port
+              : conns[conn_count].replay_path, value, MAX_OPT_LEN - 1);
+      conn_count++;
       break;
     // UART baud rate.
     case 'b':
@@ -148,6 +280,46 @@ sl_status_t ncp_host_set_option(char option, char *value)
     case 'f':
       uart_flow_control = 0;
       break;
+    // UART low latency mode.
+    case 'L':
+      uart_low_latency = true;
+      break;
+    // Event queue depth.
+    case 'q':
+      queue_depth = atol(value);
+      break;
+    // Event queue overflow policy.
+    case 'Q':
+      overflow_policy_set = true;
+      if (strcmp(value, "newest") == 0) {
+        sl_bt_api_set_overflow_policy(SL_BT_API_OVERFLOW_DROP_NEWEST);
+      } else if (strcmp(value, "oldest") == 0) {
+        sl_bt_api_set_overflow_policy(SL_BT_API_OVERFLOW_DROP_OLDEST);
+      } else if (strcmp(value, "boot") == 0) {
+        sl_bt_api_set_overflow_policy(SL_BT_API_OVERFLOW_KEEP_BOOT);
+      } else if (strcmp(value, "wait") == 0) {
+        sl_bt_api_set_overflow_policy(SL_BT_API_OVERFLOW_WAIT);
+      } else {
+        app_log_error("Unknown event queue policy: %s" APP_LOG_NL, value);
+        sc = SL_STATUS_INVALID_PARAMETER;
+      }
+      break;
+    // Capture the received data.
+    case 'w':
+      strncpy(capture_path, value, MAX_OPT_LEN - 1);
+      break;
+    // Replay speed.
+    case 'R':
+      replay_speed = (float)atof(value);
+      if (replay_speed < 0) {
+        app_log_error("Invalid replay speed: %s" APP_LOG_NL, value);
+        sc = SL_STATUS_INVALID_PARAMETER;
+      }
+      break;
+    // Event dispatch budget.
+    case 'B':
+      sl_system_set_event_budget(atol(value));
+      break;
     // Unknown option.
     default:
       sc = SL_STATUS_NOT_FOUND;
@@ -161,19 +333,43 @@ sl_status_t ncp_host_set_option(char option, char *value)
  *****************************************************************************/
 void ncp_host_deinit(void)
 {
-  if (!IS_EMPTY_STRING(uart_port)) {
-    uartClose(handle_ptr);
-  } else if (!IS_EMPTY_STRING(tcp_address)) {
-    tcp_close(handle_ptr);
+#if defined(POSIX) && POSIX == 1
+  app_poll_remove(sl_bt_api_get_event_fd());
+  sl_bt_api_stop_rx_thread();
+#endif // defined(POSIX) && POSIX == 1
+  for (uint8_t i = 0; i < conn_count; i++) {
+    ncp_host_close(&conns[i]);
   }
 }
 
+/**************************************************************************//**
+ * Close the connection to one NCP.
+ *****************************************************************************/
+static void ncp_host_close(ncp_host_conn_t *conn)
+{
+  if (conn->handle_ptr == NULL) {
+    // Not opened.
+    return;
+  }
+  capture_close(&conn->capture);
+  if (!IS_EMPTY_STRING(conn->replay_path)) {
+    replay_close(conn->handle_ptr);
+  } else if (!IS_EMPTY_STRING(conn->uart_port)) {
+    uartClose(conn->handle_ptr);
+  } else {
+    tcp_close(conn->handle_ptr);
+  }
+  conn->handle_ptr = NULL;
+}
+
 /**************************************************************************//**
  * BGAPI TX wrapper.
  *****************************************************************************/
 static void ncp_host_tx(uint32_t len, uint8_t* data)
 {
-  if (tx_ptr(handle_ptr, len, data) < 0) {
+  ncp_host_conn_t *conn = &conns[sl_bt_api_get_instance()];
+
+  if (conn->tx_ptr(conn->handle_ptr, len, data) < 0) {
     ncp_host_deinit();
     app_assert(false, "Failed to write data\n");
   }
@@ -184,17 +380,84 @@ static void ncp_host_tx(uint32_t len, uint8_t* data)
  *****************************************************************************/
 static int32_t ncp_host_rx(uint32_t len, uint8_t* data)
 {
-  return rx_ptr(handle_ptr, len, data);
+  ncp_host_conn_t *conn = &conns[sl_bt_api_get_instance()];
+  int32_t ret;
+
+  ret = conn->rx_ptr(conn->handle_ptr, len, data);
+  if (ret > 0 && conn->capture.file != NULL) {
+    if (capture_write(&conn->capture, (uint32_t)ret, data) != 0) {
+      app_log_warning("Failed to write capture file, capture stopped." APP_LOG_NL);
+      capture_close(&conn->capture);
+    }
+  }
+  if (ret < 0) {
+    if (conn->replay.done) {
+      ncp_host_on_replay_end(conn);
+      return 0;
+    }
+    if (errno == EINTR) {
+      // Interrupted by a signal, nothing has been read.
+      return 0;
+    }
+#if defined(POSIX) && POSIX == 1
+    // Called from the receive thread, which cannot stop itself. The process
+    // is aborted anyway.
+    app_assert(false, "Failed to read data\n");
+#else // defined(POSIX) && POSIX == 1
+    ncp_host_deinit();
+    app_assert(false, "Failed to read data\n");
+#endif // defined(POSIX) && POSIX == 1
+  }
+  return ret;
 }
 
+/**************************************************************************//**
+ * End of a replayed capture file.
+ *****************************************************************************/
+static void ncp_host_on_replay_end(ncp_host_conn_t *conn)
+{
+  if (conn->replay.file == NULL) {
+    // Already handled.
+    return;
+  }
+  app_log_info("Replay of %s finished." APP_LOG_NL, conn->replay_path);
+  replay_close(conn->handle_ptr);
+#if defined(POSIX) && POSIX == 1
+  // Let the application process the events read so far.
+  while (sl_bt_api_get_queue_level() > 0) {
+    usleep(REPLAY_DRAIN_POLL_US);
+  }
+#endif // defined(POSIX) && POSIX == 1
+  if (__atomic_sub_fetch(&replays_running, 1, __ATOMIC_SEQ_CST) == 0) {
+    // Shut down as if the user pressed Ctrl+C, so that statistics are logged.
+#if defined(POSIX) && POSIX == 1
+    // The receive threads block signals, so it must go to the process.
+    kill(getpid(), SIGINT);
+#else // defined(POSIX) && POSIX == 1
+    raise(SIGINT);
+#endif // defined(POSIX) && POSIX == 1
+  }
+#if defined(POSIX) && POSIX == 1
+  // Nothing more to read, the receive thread waits for cancellation.
+  for (;;) {
+    pause();
+  }
+#endif // defined(POSIX) && POSIX == 1
+}
+
+#if !defined(POSIX) || POSIX != 1
 /**************************************************************************//**
  * BGAPI peek wrapper.
  *****************************************************************************/
 static int32_t ncp_host_peek(void)
 {
+  ncp_host_conn_t *conn = &conns[sl_bt_api_get_instance()];
   int32_t sc;
 
-  sc = peek_ptr(handle_ptr);
+  sc = conn->peek_ptr(conn->handle_ptr);
+  if (sc == 0 && conn->replay.done) {
+    ncp_host_on_replay_end(conn);
+  }
   if (sc < 0) {
     ncp_host_deinit();
     app_assert(false,
@@ -203,3 +466,22 @@ static int32_t ncp_host_peek(void)
   }
   return sc;
 }
+#endif // !defined(POSIX) || POSIX != 1
+
+#if defined(POSIX) && POSIX == 1
+/**************************************************************************//**
+ * Wakeup handler of the receive thread.
+ *****************************************************************************/
+static void ncp_host_on_event(int fd, short revents, void *ctx)
+{
+  uint8_t bytes[16];
+
+  (void)revents;
+  (void)ctx;
+  // The queued events are processed by the main loop, and the wakeup is
+  // reset when the queue is found empty. Drain the non-blocking pipe anyway,
+  // so that a byte written after the reset does not keep the fd readable.
+  while (read(fd, bytes, sizeof(bytes)) > 0) {
+  }
+}
+#endif // defined(POSIX) && POSIX == 1
@@ -0,0 +1,133 @@
+/***************************************************************************//**
+ * @file
+ * @brief Multi-instance test of the NCP host without receive threads.
+ *
+ * Sets up two NCP instances on in-memory input buffers, leaves the first one
+ * selected and puts a boot event on the input of the second one only. The
+ * event has to be seen as pending and borrowed from the second instance, as
+ * happens on platforms where the input is polled with the peek function.
+ *
+ * Usage: ncp_host_test
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sl_bt_ncp_host.h"
+
+#define INSTANCES 2
+
+#define CHECK(cond)                                             \
+  do {                                                          \
+    if (!(cond)) {                                              \
+      fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, \
+              #cond);                                           \
+      exit(EXIT_FAILURE);                                       \
+    }                                                           \
+  } while (0)
+
+// Input bytes waiting on each instance.
+static struct {
+  uint8_t data[SL_BGAPI_MSG_HEADER_LEN + SL_BGAPI_MAX_PAYLOAD_SIZE];
+  uint32_t len;
+  uint32_t pos;
+} input[INSTANCES];
+
+static void test_tx(uint32_t len, uint8_t *data)
+{
+  (void)len;
+  (void)data;
+}
+
+static int32_t test_rx(uint32_t len, uint8_t *data)
+{
+  uint8_t i = sl_bt_api_get_instance();
+  uint32_t available = input[i].len - input[i].pos;
+
+  if (len > available) {
+    len = available;
+  }
+  memcpy(data, &input[i].data[input[i].pos], len);
+  input[i].pos += len;
+  return (int32_t)len;
+}
+
+static int32_t test_peek(void)
+{
+  uint8_t i = sl_bt_api_get_instance();
+
+  return (int32_t)(input[i].len - input[i].pos);
+}
+
+int main(void)
+{
+  uint32_t header = sl_bt_evt_system_boot_id
+                    | (uint32_t)sizeof(sl_bt_evt_system_boot_t) << 8;
+  sl_bt_api_rx_stats_t stats;
+  sl_bt_msg_t *event;
+
+  for (uint8_t i = 0; i < INSTANCES; i++) {
+    CHECK(sl_bt_api_initialize_nonblock(test_tx, test_rx, test_peek) == SL_STATUS_OK);
+  }
+
+  // Nothing on any input.
+  CHECK(sl_bt_api_select_instance(0) == SL_STATUS_OK);
+  CHECK(!sl_bt_event_pending());
+  CHECK(sl_bt_borrow_event(&event) == SL_STATUS_WOULD_BLOCK);
+
+  // A boot event on the input of the instance that is not selected.
+  memset(input[1].data, 0, sizeof(input[1].data));
+  memcpy(input[1].data, &header, sizeof(header));
+  input[1].len = SL_BGAPI_MSG_HEADER_LEN + sizeof(sl_bt_evt_system_boot_t);
+  CHECK(sl_bt_api_select_instance(0) == SL_STATUS_OK);
+  CHECK(sl_bt_event_pending());
+  CHECK(sl_bt_api_get_instance() == 0);
+
+  // The event is borrowed from its own instance, which is then selected.
+  CHECK(sl_bt_borrow_event(&event) == SL_STATUS_OK);
+  CHECK(SL_BT_MSG_ID(event->header) == sl_bt_evt_system_boot_id);
+  CHECK(sl_bt_api_get_instance() == 1);
+
+  // The borrowed event stays in the queue of the second instance.
+  CHECK(sl_bt_api_select_instance(0) == SL_STATUS_OK);
+  CHECK(sl_bt_api_get_queue_level() == 0);
+  CHECK(sl_bt_api_get_max_queue_level() == 1);
+  CHECK(sl_bt_api_select_instance(1) == SL_STATUS_OK);
+  sl_bt_release_event();
+  CHECK(sl_bt_api_get_max_queue_level() == 0);
+  CHECK(!sl_bt_event_pending());
+
+  // The peeks are counted for the instance that was peeked.
+  sl_bt_api_get_rx_stats(&stats);
+  CHECK(stats.peeks > 0);
+  CHECK(stats.frames == 1);
+
+  printf("OK\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,1419 @@
+/***************************************************************************//**
+ * @file
+ * @brief Output of the results to sinks
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_log.h"
+#include "aoa_util.h"
+#include "tcp.h"
+#include "aoa_shm.h"
+#include "mqtt.h"
+#include "output.h"
+
+#if defined(POSIX) && POSIX == 1
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "app_poll.h"
+#else // defined(POSIX) && POSIX == 1
+#include <windows.h>
+#endif // defined(POSIX) && POSIX == 1
+
+// Default port of TCP and UDP sinks.
+#define OUTPUT_DEFAULT_PORT  "8080"
+#define OUTPUT_PORT_LEN      8
+
+// Kind of a sink.
+typedef enum {
+  SINK_TCP,
+  SINK_UDP,
+  SINK_LOCAL,
+  SINK_FILE,
+  SINK_SHM,
+  SINK_MQTT
+} sink_type_t;
+
+// State of the connection to a sink.
+typedef enum {
+  STATE_CLOSED,       // output_open not called yet, or closed
+  STATE_WAITING,      // Waiting to try to connect again
+  STATE_CONNECTING,   // Connection in progress
+  STATE_SESSION,      // MQTT: connected, waiting for the CONNACK
+  STATE_CONNECTED
+} state_t;
+
+// Settings given in the sink option, the rest comes from the other options.
+#define SINK_SET_FORMAT   0x01
+#define SINK_SET_LATENCY  0x02
+#define SINK_SET_DEPTH    0x04
+#define SINK_SET_POLICY   0x08
+
+// Result waiting to be sent. The size of the data depends on the sink.
+typedef struct {
+  uint64_t key;
+  uint32_t len;
+  uint8_t data[];
+} entry_t;
+
+// Entry of a sink by index.
+#define ENTRY(sink, index) \
+  ((entry_t *)((uint8_t *)(sink)->entries + (size_t)(index) * (sink)->entry_size))
+
+typedef struct {
+  // Settings
+  sink_type_t type;
+  char name[OUTPUT_SINK_NAME_LEN];
+  char address[OUTPUT_SINK_NAME_LEN];   // Host or path
+  char port[OUTPUT_PORT_LEN];
+  uint8_t set;
+  output_format_t format;
+  uint32_t max_latency_us;
+  uint32_t queue_depth;
+  output_queue_policy_t queue_policy;
+
+  // Connection
+  state_t state;
+#if defined(POSIX) && POSIX == 1
+  int32_t handle;
+  app_poll_timer_t reconnect_timer;
+#else // defined(POSIX) && POSIX == 1
+  SOCKET handle;
+  uint64_t reconnect_us;
+#endif // defined(POSIX) && POSIX == 1
+  FILE *file;
+  aoa_shm_t shm;
+  // Time to wait before the next connection attempt in milliseconds.
+  uint32_t backoff;
+
+  // MQTT settings and session
+  uint8_t qos;
+  char topic[OUTPUT_MQTT_PREFIX_LEN];
+  char client_id[MQTT_CLIENT_ID_MAX_LEN + 1];
+  char username[MQTT_USERNAME_MAX_LEN + 1];
+  char password[MQTT_PASSWORD_MAX_LEN + 1];
+  uint16_t packet_id;       // Identifier of the last PUBLISH with QoS 1
+  // PUBLISH packets with QoS 1 sent and not acknowledged yet, in order.
+  uint16_t *inflight;
+  uint32_t inflight_count;
+  uint32_t inflight_max;
+  uint8_t rx[DEFAULT_BUFLEN];
+  uint32_t rx_len;
+  uint64_t last_write_us;   // Time of the last write, for the keep alive
+#if defined(POSIX) && POSIX == 1
+  app_poll_timer_t keep_alive_timer;
+#endif // defined(POSIX) && POSIX == 1
+
+  // Queue of the results not sent yet, in order. The entries are taken from
+  // a pool, so that dropping a result from the middle only moves indices.
+  entry_t *entries;
+  uint32_t entry_size;
+  uint16_t *queue;
+  uint32_t queue_count;
+  uint16_t *free_entries;
+  uint32_t free_count;
+  tcp_buf_t *queue_bufs;
+  // Set of the keys seen while dropping superseded results. A slot is in
+  // the set if its generation is the current one.
+  uint64_t *seen_keys;
+  uint32_t *seen_generations;
+  uint32_t seen_generation;
+  uint32_t seen_mask;
+  // Bytes of the first result already sent.
+  uint32_t sent_offset;
+  // The sink did not take the whole queue, wait until it is writable.
+  bool blocked;
+
+  // Results added since the queue was last written
+  uint32_t batch_count;
+  uint32_t batch_bytes;
+  uint64_t batch_start_us;
+
+  output_stats_t stats;
+} sink_t;
+
+// Defaults of the sink settings
+static output_format_t default_format = OUTPUT_FORMAT_JSON;
+static uint32_t default_latency_us = OUTPUT_MAX_LATENCY_DEFAULT * 1000;
+static uint32_t default_depth = OUTPUT_QUEUE_DEPTH_DEFAULT;
+static output_queue_policy_t default_policy = OUTPUT_QUEUE_DROP_OLDEST;
+
+static sink_t sinks[OUTPUT_MAX_SINKS];
+static uint32_t sink_count;
+static bool opened;
+
+static sl_status_t parse_sink(char *spec);
+static sl_status_t parse_format(char *value, output_format_t *format);
+static sl_status_t parse_latency(char *value, uint32_t *latency_us);
+static sl_status_t parse_depth(char *value, uint32_t *depth);
+static sl_status_t parse_policy(char *value, output_queue_policy_t *policy);
+static sl_status_t parse_string(char *value, char *setting, size_t size);
+static void sink_write(sink_t *sink, const output_result_t *result);
+static sl_status_t queue_alloc(sink_t *sink);
+static void queue_free(sink_t *sink);
+static void queue_remove(sink_t *sink, uint32_t pos);
+static bool queue_make_room(sink_t *sink, uint64_t key);
+static bool seen_insert(sink_t *sink, uint64_t key);
+static void flush(sink_t *sink, output_flush_reason_t reason);
+static void write_queue(sink_t *sink);
+static int32_t send_datagrams(sink_t *sink, tcp_buf_t *bufs, uint32_t count);
+static int32_t write_file(sink_t *sink, tcp_buf_t *bufs, uint32_t count);
+static void connect_start(sink_t *sink);
+static void connect_finish(sink_t *sink, int32_t rc);
+static void connection_lost(sink_t *sink);
+static void close_sink(sink_t *sink);
+static void update_poll(sink_t *sink);
+static void mqtt_start_session(sink_t *sink);
+static void mqtt_receive(sink_t *sink);
+static void mqtt_on_connack(sink_t *sink, uint8_t return_code);
+static void mqtt_on_puback(sink_t *sink, uint16_t packet_id);
+static void mqtt_keep_alive(sink_t *sink);
+static int32_t mqtt_send(sink_t *sink, uint8_t *packet, uint32_t len);
+static void sleep_ms(uint32_t ms);
+#if defined(POSIX) && POSIX == 1
+static void on_socket_event(int fd, short revents, void *ctx);
+static void on_reconnect_timer(app_poll_timer_t *timer, void *ctx);
+static void on_keep_alive_timer(app_poll_timer_t *timer, void *ctx);
+#endif // defined(POSIX) && POSIX == 1
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+sl_status_t output_set_option(char option, char *value)
+{
+  sl_status_t sc;
+
+  switch (option) {
+    // Output sink.
+    case 'O':
+      sc = parse_sink(value);
+      break;
+    // Output format.
+    case 'o':
+      sc = parse_format(value, &default_format);
+      break;
+    // Maximum latency.
+    case 'm':
+      sc = parse_latency(value, &default_latency_us);
+      break;
+    // Queue depth.
+    case 'd':
+      sc = parse_depth(value, &default_depth);
+      break;
+    // Queue policy.
+    case 'D':
+      sc = parse_policy(value, &default_policy);
+      break;
+    // Unknown option.
+    default:
+      sc = SL_STATUS_NOT_FOUND;
+      break;
+  }
+  return sc;
+}
+
+sl_status_t output_open(char *host, char *port)
+{
+  sl_status_t sc;
+  sink_t *sink;
+  uint32_t i;
+
+  if (opened) {
+    return SL_STATUS_INVALID_STATE;
+  }
+
+  // The socket server given with -s.
+  if (host != NULL || sink_count == 0) {
+    if (sink_count == OUTPUT_MAX_SINKS) {
+      return SL_STATUS_FULL;
+    }
+    sink = &sinks[sink_count++];
+    memset(sink, 0, sizeof(*sink));
+    sink->type = SINK_TCP;
+    if (host == NULL) {
+      host = "127.0.0.1";
+    }
+    snprintf(sink->address, sizeof(sink->address), "%s", host);
+    snprintf(sink->port, sizeof(sink->port), "%s", port);
+    snprintf(sink->name, sizeof(sink->name), "tcp:%s:%s", host, port);
+  }
+
+  for (i = 0; i < sink_count; i++) {
+    sink = &sinks[i];
+    if (!(sink->set & SINK_SET_FORMAT)) {
+      sink->format = default_format;
+    }
+    if (!(sink->set & SINK_SET_LATENCY)) {
+      sink->max_latency_us = default_latency_us;
+    }
+    if (!(sink->set & SINK_SET_DEPTH)) {
+      sink->queue_depth = default_depth;
+    }
+    if (!(sink->set & SINK_SET_POLICY)) {
+      sink->queue_policy = default_policy;
+    }
+    sink->handle = -1;
+    sink->stats.depth = sink->queue_depth;
+    // A shared memory ring never blocks, it needs no queue.
+    sc = (sink->type == SINK_SHM) ? SL_STATUS_OK : queue_alloc(sink);
+    if (sc != SL_STATUS_OK) {
+      while (i-- > 0) {
+        queue_free(&sinks[i]);
+      }
+      return sc;
+    }
+  }
+
+  opened = true;
+  for (i = 0; i < sink_count; i++) {
+    connect_start(&sinks[i]);
+  }
+  return SL_STATUS_OK;
+}
+
+bool output_is_open(void)
+{
+  return opened;
+}
+
+uint32_t output_get_formats(void)
+{
+  uint32_t formats = 0;
+
+  for (uint32_t i = 0; i < sink_count; i++) {
+    formats |= 1u << sinks[i].format;
+  }
+  return formats;
+}
+
+sl_status_t output_write(const output_result_t *result)
+{
+  sink_t *sink;
+  uint32_t i;
+
+  if (!opened) {
+    return SL_STATUS_INVALID_STATE;
+  }
+  for (i = 0; i < sink_count; i++) {
+    sink = &sinks[i];
+    if (result->data[sink->format] == NULL) {
+      return SL_STATUS_INVALID_PARAMETER;
+    }
+    if (result->len[sink->format] > OUTPUT_RESULT_MAX_LEN) {
+      return SL_STATUS_WOULD_OVERFLOW;
+    }
+    if (sink->type == SINK_MQTT
+        && (result->locator_id == NULL || result->tag_id == NULL)) {
+      return SL_STATUS_INVALID_PARAMETER;
+    }
+  }
+  for (i = 0; i < sink_count; i++) {
+    sink_write(&sinks[i], result);
+  }
+  return SL_STATUS_OK;
+}
+
+void output_flush(void)
+{
+  sink_t *sink;
+
+  for (uint32_t i = 0; i < sink_count && opened; i++) {
+    sink = &sinks[i];
+#if defined(POSIX) && POSIX == 1
+    flush(sink, OUTPUT_FLUSH_IDLE);
+#else // defined(POSIX) && POSIX == 1
+    // Without a poll loop, the sockets and the reconnect times are checked
+    // whenever the loop is idle.
+    if (sink->state == STATE_WAITING && aoa_time_us() >= sink->reconnect_us) {
+      connect_start(sink);
+    } else if (sink->state == STATE_CONNECTING) {
+      int32_t rc = tcp_connect_finish(&sink->handle);
+      if (rc <= 0) {
+        connect_finish(sink, rc);
+      }
+    } else if (sink->state == STATE_SESSION) {
+      mqtt_receive(sink);
+      if (sink->state == STATE_SESSION && aoa_time_us() >= sink->reconnect_us) {
+        app_log_warning("Output %s: no CONNACK from the broker." APP_LOG_NL,
+                        sink->name);
+        connect_finish(sink, -1);
+      }
+    } else if (sink->state == STATE_CONNECTED) {
+      if (sink->type == SINK_MQTT) {
+        mqtt_receive(sink);
+        mqtt_keep_alive(sink);
+      }
+      if (sink->state == STATE_CONNECTED && sink->blocked) {
+        write_queue(sink);
+      }
+    }
+    flush(sink, OUTPUT_FLUSH_IDLE);
+#endif // defined(POSIX) && POSIX == 1
+  }
+}
+
+void output_close(void)
+{
+  uint64_t deadline = aoa_time_us() + (uint64_t)OUTPUT_CLOSE_TIMEOUT * 1000;
+  bool pending;
+  sink_t *sink;
+  uint32_t i;
+
+  if (!opened) {
+    return;
+  }
+  for (i = 0; i < sink_count; i++) {
+    flush(&sinks[i], OUTPUT_FLUSH_IDLE);
+  }
+  // Give the servers some time to take the rest of the queues.
+  do {
+    pending = false;
+    for (i = 0; i < sink_count; i++) {
+      sink = &sinks[i];
+      if (sink->state != STATE_CONNECTED) {
+        continue;
+      }
+      if (sink->type == SINK_MQTT) {
+        // Collect the acknowledgements of the broker as well.
+        mqtt_receive(sink);
+      }
+      if (sink->state == STATE_CONNECTED && sink->queue_count > 0) {
+        write_queue(sink);
+      }
+      pending |= (sink->state == STATE_CONNECTED
+                  && (sink->queue_count > 0 || sink->inflight_count > 0));
+    }
+    if (pending) {
+      sleep_ms(1);
+    }
+  } while (pending && aoa_time_us() < deadline);
+
+  for (i = 0; i < sink_count; i++) {
+    sink = &sinks[i];
+    if (sink->type == SINK_MQTT && sink->state == STATE_CONNECTED
+        && sink->sent_offset == 0) {
+      uint8_t packet[MQTT_DISCONNECT_LEN];
+      mqtt_send(sink, packet, mqtt_empty_packet(packet, MQTT_DISCONNECT));
+    }
+    sink->stats.unsent += sink->queue_count + sink->inflight_count;
+#if defined(POSIX) && POSIX == 1
+    app_poll_timer_stop(&sink->reconnect_timer);
+#endif // defined(POSIX) && POSIX == 1
+    close_sink(sink);
+    queue_free(sink);
+    sink->state = STATE_CLOSED;
+  }
+  opened = false;
+}
+
+uint32_t output_get_sink_count(void)
+{
+  return sink_count;
+}
+
+const char *output_get_sink_name(uint32_t sink)
+{
+  if (sink >= sink_count) {
+    return NULL;
+  }
+  return sinks[sink].name;
+}
+
+sl_status_t output_get_stats(uint32_t sink, output_stats_t *stats)
+{
+  if (sink >= sink_count) {
+    return SL_STATUS_NOT_FOUND;
+  }
+  *stats = sinks[sink].stats;
+  return SL_STATUS_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+/**************************************************************************//**
+ * Parse a sink option: <type>:<address>[,<setting>=<value>]...
+ *****************************************************************************/
+static sl_status_t parse_sink(char *spec)
+{
+  sl_status_t sc = SL_STATUS_OK;
+  sink_t *sink;
+  char *settings;
+  char *address;
+  char *setting;
+  char *value;
+  char *port;
+
+  if (sink_count == OUTPUT_MAX_SINKS) {
+    app_log_error("At most %d output sinks are supported." APP_LOG_NL,
+                  OUTPUT_MAX_SINKS);
+    return SL_STATUS_FULL;
+  }
+  sink = &sinks[sink_count];
+  memset(sink, 0, sizeof(*sink));
+
+  settings = strchr(spec, ',');
+  if (settings != NULL) {
+    *settings++ = '\0';
+  } else {
+    // No settings, strtok must not continue from a previous sink.
+    settings = "";
+  }
+  snprintf(sink->name, sizeof(sink->name), "%s", spec);
+  address = strchr(spec, ':');
+  if (address == NULL || address[1] == '\0'
+      || strlen(address + 1) >= sizeof(sink->address)) {
+    app_log_error("Invalid output sink: %s" APP_LOG_NL, spec);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  *address++ = '\0';
+
+  if (strcmp(spec, "tcp") == 0) {
+    sink->type = SINK_TCP;
+  } else if (strcmp(spec, "udp") == 0) {
+    sink->type = SINK_UDP;
+  } else if (strcmp(spec, "unix") == 0) {
+    sink->type = SINK_LOCAL;
+  } else if (strcmp(spec, "file") == 0) {
+    sink->type = SINK_FILE;
+  } else if (strcmp(spec, "shm") == 0) {
+    sink->type = SINK_SHM;
+  } else if (strcmp(spec, "mqtt") == 0) {
+    sink->type = SINK_MQTT;
+  } else {
+    app_log_error("Unknown output sink type: %s" APP_LOG_NL, spec);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+
+  snprintf(sink->port, sizeof(sink->port), "%s",
+           (sink->type == SINK_MQTT) ? MQTT_PORT_DEFAULT : OUTPUT_DEFAULT_PORT);
+  snprintf(sink->topic, sizeof(sink->topic), "%s", OUTPUT_MQTT_TOPIC_DEFAULT);
+  if (sink->type == SINK_TCP || sink->type == SINK_UDP
+      || sink->type == SINK_MQTT) {
+    port = strrchr(address, ':');
+    if (port != NULL) {
+      *port++ = '\0';
+      if (strlen(port) >= sizeof(sink->port)) {
+        app_log_error("Invalid port: %s" APP_LOG_NL, port);
+        return SL_STATUS_INVALID_PARAMETER;
+      }
+      strcpy(sink->port, port);
+    }
+  }
+  strcpy(sink->address, address);
+
+  for (setting = strtok(settings, ","); setting != NULL && sc == SL_STATUS_OK;
+       setting = strtok(NULL, ",")) {
+    value = strchr(setting, '=');
+    if (value == NULL) {
+      sc = SL_STATUS_INVALID_PARAMETER;
+      break;
+    }
+    *value++ = '\0';
+    if (strcmp(setting, "format") == 0) {
+      sc = parse_format(value, &sink->format);
+      sink->set |= SINK_SET_FORMAT;
+    } else if (strcmp(setting, "latency") == 0) {
+      sc = parse_latency(value, &sink->max_latency_us);
+      sink->set |= SINK_SET_LATENCY;
+    } else if (strcmp(setting, "depth") == 0) {
+      sc = parse_depth(value, &sink->queue_depth);
+      sink->set |= SINK_SET_DEPTH;
+    } else if (strcmp(setting, "policy") == 0) {
+      sc = parse_policy(value, &sink->queue_policy);
+      sink->set |= SINK_SET_POLICY;
+    } else if (sink->type == SINK_MQTT && strcmp(setting, "qos") == 0) {
+      if (strcmp(value, "0") == 0 || strcmp(value, "1") == 0) {
+        sink->qos = (uint8_t)(value[0] - '0');
+      } else {
+        app_log_error("MQTT QoS must be 0 or 1." APP_LOG_NL);
+        sc = SL_STATUS_INVALID_PARAMETER;
+      }
+    } else if (sink->type == SINK_MQTT && strcmp(setting, "topic") == 0) {
+      sc = parse_string(value, sink->topic, sizeof(sink->topic));
+    } else if (sink->type == SINK_MQTT && strcmp(setting, "client") == 0) {
+      sc = parse_string(value, sink->client_id, sizeof(sink->client_id));
+    } else if (sink->type == SINK_MQTT && strcmp(setting, "user") == 0) {
+      sc = parse_string(value, sink->username, sizeof(sink->username));
+    } else if (sink->type == SINK_MQTT && strcmp(setting, "password") == 0) {
+      sc = parse_string(value, sink->password, sizeof(sink->password));
+    } else {
+      app_log_error("Unknown output sink setting: %s" APP_LOG_NL, setting);
+      sc = SL_STATUS_INVALID_PARAMETER;
+    }
+  }
+  if (sc == SL_STATUS_OK && sink->type == SINK_SHM) {
+    // The slots hold binary records, published at once.
+    if ((sink->set & SINK_SET_FORMAT) && sink->format != OUTPUT_FORMAT_BINARY) {
+      app_log_error("Shared memory sinks only take the binary format." APP_LOG_NL);
+      sc = SL_STATUS_INVALID_PARAMETER;
+    } else if (sink->address[0] != '/') {
+      app_log_error("Shared memory name must start with '/': %s" APP_LOG_NL,
+                    sink->address);
+      sc = SL_STATUS_INVALID_PARAMETER;
+    }
+    sink->format = OUTPUT_FORMAT_BINARY;
+    sink->set |= SINK_SET_FORMAT;
+    if (!(sink->set & SINK_SET_DEPTH)) {
+      sink->queue_depth = AOA_SHM_SLOT_COUNT_DEFAULT;
+      sink->set |= SINK_SET_DEPTH;
+    }
+  }
+  if (sc == SL_STATUS_OK) {
+    sink_count++;
+  }
+  return sc;
+}
+
+// Copy a string setting.
+static sl_status_t parse_string(char *value, char *setting, size_t size)
+{
+  if (strlen(value) >= size) {
+    app_log_error("Output sink setting is too long: %s" APP_LOG_NL, value);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  strcpy(setting, value);
+  return SL_STATUS_OK;
+}
+
+static sl_status_t parse_format(char *value, output_format_t *format)
+{
+  if (strcmp(value, "json") == 0) {
+    *format = OUTPUT_FORMAT_JSON;
+  } else if (strcmp(value, "binary") == 0) {
+    *format = OUTPUT_FORMAT_BINARY;
+  } else {
+    app_log_error("Unknown output format: %s" APP_LOG_NL, value);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  return SL_STATUS_OK;
+}
+
+static sl_status_t parse_latency(char *value, uint32_t *latency_us)
+{
+  char *end;
+  unsigned long latency = strtoul(value, &end, 0);
+
+  if (*end != '\0' || latency > UINT32_MAX / 1000) {
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  *latency_us = (uint32_t)latency * 1000;
+  return SL_STATUS_OK;
+}
+
+static sl_status_t parse_depth(char *value, uint32_t *depth)
+{
+  char *end;
+  unsigned long number = strtoul(value, &end, 0);
+
+  if (*end != '\0' || number == 0 || number > UINT16_MAX) {
+    app_log_error("Output queue depth must be between 1 and %u." APP_LOG_NL,
+                  UINT16_MAX);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  *depth = (uint32_t)number;
+  return SL_STATUS_OK;
+}
+
+static sl_status_t parse_policy(char *value, output_queue_policy_t *policy)
+{
+  if (strcmp(value, "oldest") == 0) {
+    *policy = OUTPUT_QUEUE_DROP_OLDEST;
+  } else if (strcmp(value, "latest") == 0) {
+    *policy = OUTPUT_QUEUE_KEEP_LATEST;
+  } else {
+    app_log_error("Unknown output queue policy: %s" APP_LOG_NL, value);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  return SL_STATUS_OK;
+}
+
+// Add a result to the queue of a sink and send the batch if it is due.
+static void sink_write(sink_t *sink, const output_result_t *result)
+{
+  const uint8_t *data = result->data[sink->format];
+  uint32_t len = result->len[sink->format];
+  uint64_t key = result->key;
+  entry_t *entry;
+  uint64_t now;
+
+  if (sink->type == SINK_SHM) {
+    if (sink->state == STATE_CONNECTED) {
+      aoa_shm_write(&sink->shm, data, len);
+      sink->stats.results++;
+      sink->stats.bytes += len;
+      sink->stats.writes++;
+      sink->stats.max_batch = 1;
+    } else {
+      sink->stats.dropped++;
+      sink->stats.dropped_offline++;
+    }
+    return;
+  }
+
+  if (sink->free_count == 0) {
+    uint32_t dropped = sink->stats.dropped;
+    bool room = queue_make_room(sink, key);
+    if (!room) {
+      // Only a partially sent result is queued, drop the new one.
+      sink->stats.dropped++;
+    }
+    if (sink->state != STATE_CONNECTED) {
+      sink->stats.dropped_offline += sink->stats.dropped - dropped;
+    }
+    if (!room) {
+      return;
+    }
+  }
+
+  sink->queue[sink->queue_count] = sink->free_entries[--sink->free_count];
+  entry = ENTRY(sink, sink->queue[sink->queue_count++]);
+  entry->key = key;
+  entry->len = 0;
+  if (sink->type == SINK_MQTT) {
+    // The entry holds the whole PUBLISH packet, the topic is
+    // <prefix>/<locator>/<tag>.
+    char topic[OUTPUT_MQTT_TOPIC_MAX_LEN];
+    uint32_t topic_len = (uint32_t)snprintf(topic, sizeof(topic), "%s/%.*s/%.*s",
+                                            sink->topic,
+                                            OUTPUT_MQTT_ID_MAX_LEN, result->locator_id,
+                                            OUTPUT_MQTT_ID_MAX_LEN, result->tag_id);
+    if (sink->qos > 0 && ++sink->packet_id == 0) {
+      sink->packet_id = 1;
+    }
+    entry->len = mqtt_publish_header(entry->data, sink->qos, sink->packet_id,
+                                     topic, topic_len, len);
+  }
+  memcpy(&entry->data[entry->len], data, len);
+  entry->len += len;
+  len = entry->len;
+  if (sink->queue_count > sink->stats.max_queued) {
+    sink->stats.max_queued = sink->queue_count;
+  }
+
+  now = aoa_time_us();
+  if (sink->batch_count == 0) {
+    sink->batch_start_us = now;
+  }
+  sink->batch_count++;
+  sink->batch_bytes += len;
+
+  if (sink->batch_count >= OUTPUT_BATCH_COUNT
+      || sink->batch_bytes >= OUTPUT_BATCH_BYTES) {
+    flush(sink, OUTPUT_FLUSH_SIZE);
+  } else if (now - sink->batch_start_us >= sink->max_latency_us) {
+    flush(sink, OUTPUT_FLUSH_LATENCY);
+  }
+}
+
+static sl_status_t queue_alloc(sink_t *sink)
+{
+  uint32_t depth = sink->queue_depth;
+  uint32_t data_len = OUTPUT_RESULT_MAX_LEN;
+
+  if (sink->type == SINK_MQTT) {
+    data_len += MQTT_PUBLISH_HEADER_LEN + OUTPUT_MQTT_TOPIC_MAX_LEN;
+    // Leave room in the queue for new results while waiting for the broker.
+    sink->inflight_max = (sink->qos > 0) ? OUTPUT_MQTT_INFLIGHT_MAX : 0;
+    if (sink->inflight_max > (depth + 1) / 2) {
+      sink->inflight_max = (depth + 1) / 2;
+    }
+    sink->inflight = malloc((sink->inflight_max + 1) * sizeof(*sink->inflight));
+    if (sink->inflight == NULL) {
+      return SL_STATUS_ALLOCATION_FAILED;
+    }
+  }
+  // Keep the keys of the entries aligned.
+  sink->entry_size = (uint32_t)((offsetof(entry_t, data) + data_len + 7) & ~7u);
+  sink->entries = malloc((size_t)depth * sink->entry_size);
+  sink->queue = malloc(depth * sizeof(*sink->queue));
+  sink->free_entries = malloc(depth * sizeof(*sink->free_entries));
+  sink->queue_bufs = malloc(depth * sizeof(*sink->queue_bufs));
+  // At most half of the key set is used.
+  sink->seen_mask = 1;
+  while (sink->seen_mask < 2 * depth) {
+    sink->seen_mask <<= 1;
+  }
+  sink->seen_keys = malloc(sink->seen_mask * sizeof(*sink->seen_keys));
+  sink->seen_generations = calloc(sink->seen_mask,
+                                  sizeof(*sink->seen_generations));
+  sink->seen_mask--;
+  if (sink->entries == NULL || sink->queue == NULL
+      || sink->free_entries == NULL || sink->queue_bufs == NULL
+      || sink->seen_keys == NULL || sink->seen_generations == NULL) {
+    queue_free(sink);
+    return SL_STATUS_ALLOCATION_FAILED;
+  }
+  for (sink->free_count = 0; sink->free_count < depth; sink->free_count++) {
+    sink->free_entries[sink->free_count] = (uint16_t)sink->free_count;
+  }
+  sink->queue_count = 0;
+  return SL_STATUS_OK;
+}
+
+static void queue_free(sink_t *sink)
+{
+  free(sink->entries);
+  free(sink->queue);
+  free(sink->free_entries);
+  free(sink->queue_bufs);
+  free(sink->seen_keys);
+  free(sink->seen_generations);
+  free(sink->inflight);
+  sink->inflight = NULL;
+  sink->inflight_count = 0;
+  sink->entries = NULL;
+  sink->queue = NULL;
+  sink->free_entries = NULL;
+  sink->queue_bufs = NULL;
+  sink->seen_keys = NULL;
+  sink->seen_generations = NULL;
+  sink->queue_count = 0;
+  sink->free_count = 0;
+}
+
+// Remove the result at the given position of the queue.
+static void queue_remove(sink_t *sink, uint32_t pos)
+{
+  sink->free_entries[sink->free_count++] = sink->queue[pos];
+  sink->queue_count--;
+  memmove(&sink->queue[pos], &sink->queue[pos + 1],
+          (sink->queue_count - pos) * sizeof(*sink->queue));
+}
+
+/**************************************************************************//**
+ * Drop results from the full queue to make room for a result with the given
+ * key. The oldest result is dropped if the policy finds nothing to drop.
+ * A partially sent result is never dropped.
+ *
+ * @return true if there is room for the new result.
+ *****************************************************************************/
+static bool queue_make_room(sink_t *sink, uint64_t key)
+{
+  uint32_t first = (sink->sent_offset > 0) ? 1 : 0;
+  uint32_t pos;
+  uint32_t count = sink->queue_count;
+
+  if (sink->queue_policy == OUTPUT_QUEUE_DROP_OLDEST) {
+    for (pos = first; pos < sink->queue_count; pos++) {
+      if (ENTRY(sink, sink->queue[pos])->key == key) {
+        queue_remove(sink, pos);
+        break;
+      }
+    }
+  } else {
+    // Keep the latest result of every tag. The new result replaces the
+    // queued ones of its own tag. Walk from the newest result backwards.
+    if (++sink->seen_generation == 0) {
+      memset(sink->seen_generations, 0,
+             (sink->seen_mask + 1) * sizeof(*sink->seen_generations));
+      sink->seen_generation = 1;
+    }
+    seen_insert(sink, key);
+    for (pos = sink->queue_count; pos-- > first; ) {
+      if (!seen_insert(sink, ENTRY(sink, sink->queue[pos])->key)) {
+        queue_remove(sink, pos);
+      }
+    }
+  }
+  if (sink->queue_count == count && sink->queue_count > first) {
+    queue_remove(sink, first);
+  }
+  sink->stats.dropped += count - sink->queue_count;
+  return sink->queue_count < count;
+}
+
+// Add a key to the set. Return false if it is already in the set.
+static bool seen_insert(sink_t *sink, uint64_t key)
+{
+  uint32_t slot = (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> 32)
+                  & sink->seen_mask;
+
+  while (sink->seen_generations[slot] == sink->seen_generation) {
+    if (sink->seen_keys[slot] == key) {
+      return false;
+    }
+    slot = (slot + 1) & sink->seen_mask;
+  }
+  sink->seen_generations[slot] = sink->seen_generation;
+  sink->seen_keys[slot] = key;
+  return true;
+}
+
+static void flush(sink_t *sink, output_flush_reason_t reason)
+{
+  if (sink->batch_count == 0) {
+    return;
+  }
+  sink->stats.flushes[reason]++;
+  sink->batch_count = 0;
+  sink->batch_bytes = 0;
+  // A blocked queue is written when the socket becomes writable, the queue
+  // is kept while there is no connection.
+  if (sink->state == STATE_CONNECTED && !sink->blocked) {
+    write_queue(sink);
+  }
+}
+
+/**************************************************************************//**
+ * Write as much of the queue as the sink takes without blocking.
+ *****************************************************************************/
+static void write_queue(sink_t *sink)
+{
+  int32_t rc;
+  uint32_t i;
+  uint32_t sent;
+  uint32_t count = sink->queue_count;
+  bool blocked;
+  entry_t *entry;
+
+  // With QoS 1, only as many packets as there is room for in flight.
+  if (sink->inflight_max > 0 && count > sink->inflight_max - sink->inflight_count) {
+    count = sink->inflight_max - sink->inflight_count;
+  }
+  if (count == 0) {
+    // Nothing to wait for until the broker acknowledges.
+    if (sink->blocked) {
+      sink->blocked = false;
+      update_poll(sink);
+    }
+    return;
+  }
+  for (i = 0; i < count; i++) {
+    sink->queue_bufs[i].data = ENTRY(sink, sink->queue[i])->data;
+    sink->queue_bufs[i].len = ENTRY(sink, sink->queue[i])->len;
+  }
+  sink->queue_bufs[0].data += sink->sent_offset;
+  sink->queue_bufs[0].len -= sink->sent_offset;
+
+  switch (sink->type) {
+    case SINK_UDP:
+      rc = send_datagrams(sink, sink->queue_bufs, count);
+      break;
+    case SINK_FILE:
+      rc = write_file(sink, sink->queue_bufs, count);
+      break;
+    default:
+      rc = tcp_txv(&sink->handle, sink->queue_bufs, count);
+      break;
+  }
+  if (rc < 0) {
+    connection_lost(sink);
+    return;
+  }
+
+  sink->stats.writes++;
+  sink->stats.bytes += (uint32_t)rc;
+  if (rc > 0) {
+    sink->last_write_us = aoa_time_us();
+  }
+  // Release the results sent, or keep them until they are acknowledged.
+  for (sent = 0; sent < count; sent++) {
+    entry = ENTRY(sink, sink->queue[sent]);
+    if ((uint32_t)rc < entry->len - sink->sent_offset) {
+      sink->sent_offset += (uint32_t)rc;
+      break;
+    }
+    rc -= (int32_t)(entry->len - sink->sent_offset);
+    sink->sent_offset = 0;
+    if (sink->inflight_max > 0) {
+      sink->inflight[sink->inflight_count++] = sink->queue[sent];
+    } else {
+      sink->free_entries[sink->free_count++] = sink->queue[sent];
+    }
+  }
+  sink->queue_count -= sent;
+  memmove(sink->queue, &sink->queue[sent],
+          sink->queue_count * sizeof(*sink->queue));
+  sink->stats.results += sent;
+  if (sent > sink->stats.max_batch) {
+    sink->stats.max_batch = sent;
+  }
+
+  // Waiting for acknowledgements is not blocking.
+  blocked = (sent < count);
+  if (sink->blocked != blocked) {
+    sink->blocked = blocked;
+    if (blocked) {
+      sink->stats.blocked++;
+    }
+    update_poll(sink);
+  }
+}
+
+/**************************************************************************//**
+ * Send the buffers in datagrams of at most OUTPUT_DATAGRAM_MAX_LEN bytes.
+ * A buffer is never split, a longer buffer is sent in a datagram of its own.
+ *
+ * @return The number of bytes sent or -1 on failure.
+ *****************************************************************************/
+static int32_t send_datagrams(sink_t *sink, tcp_buf_t *bufs, uint32_t count)
+{
+  int32_t total = 0;
+  int32_t rc;
+  uint32_t n;
+  uint32_t len;
+
+  while (count > 0) {
+    len = bufs[0].len;
+    for (n = 1; n < count && n < UDP_TXV_MAX_BUFS
+         && len + bufs[n].len <= OUTPUT_DATAGRAM_MAX_LEN; n++) {
+      len += bufs[n].len;
+    }
+    rc = udp_txv(&sink->handle, bufs, n);
+    if (rc < 0) {
+      return -1;
+    }
+    if (rc == 0) {
+      break;
+    }
+    total += (int32_t)len;
+    bufs += n;
+    count -= n;
+  }
+  return total;
+}
+
+// Append the buffers to the file of the sink.
+static int32_t write_file(sink_t *sink, tcp_buf_t *bufs, uint32_t count)
+{
+  int32_t total = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (fwrite(bufs[i].data, 1, bufs[i].len, sink->file) != bufs[i].len) {
+      return -1;
+    }
+    total += (int32_t)bufs[i].len;
+  }
+  if (fflush(sink->file) != 0) {
+    return -1;
+  }
+  return total;
+}
+
+/**************************************************************************//**
+ * Start opening a sink. A socket is watched for the result of the
+ * connection, or for the server closing the connection later.
+ *****************************************************************************/
+static void connect_start(sink_t *sink)
+{
+  int32_t rc;
+
+  sink->stats.attempts++;
+  switch (sink->type) {
+    case SINK_TCP:
+    case SINK_MQTT:
+      rc = tcp_connect_start(&sink->handle, sink->address, sink->port);
+      break;
+    case SINK_LOCAL:
+      rc = tcp_connect_start_local(&sink->handle, sink->address);
+      break;
+    case SINK_UDP:
+      rc = udp_open(&sink->handle, sink->address, sink->port);
+      break;
+    case SINK_SHM:
+      rc = aoa_shm_create(&sink->shm, sink->address, sink->queue_depth);
+      break;
+    default:
+      sink->file = fopen(sink->address, "ab");
+      rc = (sink->file != NULL) ? 0 : -1;
+      break;
+  }
+  if (rc == 1) {
+    sink->state = STATE_CONNECTING;
+    update_poll(sink);
+  } else {
+    connect_finish(sink, rc);
+  }
+}
+
+/**************************************************************************//**
+ * Handle the result of opening a sink: send the queued results, or
+ * schedule the next attempt with exponential backoff.
+ *****************************************************************************/
+static void connect_finish(sink_t *sink, int32_t rc)
+{
+  if (rc == 0 && sink->type == SINK_MQTT) {
+    mqtt_start_session(sink);
+    return;
+  }
+  if (rc == 0) {
+    sink->state = STATE_CONNECTED;
+    sink->stats.connects++;
+    sink->backoff = 0;
+    app_log_info("Output %s connected, %u results queued." APP_LOG_NL,
+                 sink->name, sink->queue_count);
+    update_poll(sink);
+    write_queue(sink);
+    return;
+  }
+
+  close_sink(sink);
+  if (sink->backoff == 0) {
+    sink->backoff = OUTPUT_RECONNECT_MIN;
+  } else if (sink->backoff < OUTPUT_RECONNECT_MAX / 2) {
+    sink->backoff *= 2;
+  } else {
+    sink->backoff = OUTPUT_RECONNECT_MAX;
+  }
+  sink->state = STATE_WAITING;
+  app_log_warning("Failed to open output %s, retrying in %u ms." APP_LOG_NL,
+                  sink->name, sink->backoff);
+#if defined(POSIX) && POSIX == 1
+  app_poll_timer_start(&sink->reconnect_timer, sink->backoff, 0,
+                       on_reconnect_timer, sink);
+#else // defined(POSIX) && POSIX == 1
+  sink->reconnect_us = aoa_time_us() + (uint64_t)sink->backoff * 1000;
+#endif // defined(POSIX) && POSIX == 1
+}
+
+/**************************************************************************//**
+ * Close the lost connection and connect again. The queued results are kept.
+ * A result that was sent partially is sent again from its start.
+ *****************************************************************************/
+static void connection_lost(sink_t *sink)
+{
+  if (sink->state == STATE_SESSION) {
+    // The broker closed the connection before accepting it, retry later.
+    connect_finish(sink, -1);
+    return;
+  }
+  app_log_warning("Output %s lost." APP_LOG_NL, sink->name);
+  sink->stats.disconnects++;
+  close_sink(sink);
+  connect_start(sink);
+}
+
+static void close_sink(sink_t *sink)
+{
+  if (sink->handle != -1) {
+#if defined(POSIX) && POSIX == 1
+    app_poll_remove(sink->handle);
+#endif // defined(POSIX) && POSIX == 1
+    tcp_close(&sink->handle);
+    sink->handle = -1;
+  }
+  if (sink->file != NULL) {
+    fclose(sink->file);
+    sink->file = NULL;
+  }
+  aoa_shm_close(&sink->shm);
+#if defined(POSIX) && POSIX == 1
+  app_poll_timer_stop(&sink->keep_alive_timer);
+#endif // defined(POSIX) && POSIX == 1
+  sink->rx_len = 0;
+  sink->sent_offset = 0;
+  sink->blocked = false;
+}
+
+/**************************************************************************//**
+ * Watch the socket of a sink for the events its state needs: the end of a
+ * connection attempt, room in the send buffer while blocked, and for stream
+ * sockets the server closing the connection.
+ *****************************************************************************/
+static void update_poll(sink_t *sink)
+{
+#if defined(POSIX) && POSIX == 1
+  short events;
+
+  if (sink->handle == -1) {
+    return;
+  }
+  if (sink->state == STATE_CONNECTING) {
+    events = POLLOUT;
+  } else {
+    events = (sink->type == SINK_UDP) ? 0 : POLLIN;
+    if (sink->blocked) {
+      events |= POLLOUT;
+    }
+  }
+  if (events == 0) {
+    app_poll_remove(sink->handle);
+  } else if (app_poll_modify(sink->handle, events) == SL_STATUS_NOT_FOUND
+             && app_poll_add(sink->handle, events, on_socket_event, sink)
+             != SL_STATUS_OK) {
+    app_log_error("Cannot watch output %s." APP_LOG_NL, sink->name);
+  }
+#else // defined(POSIX) && POSIX == 1
+  (void)sink;
+#endif // defined(POSIX) && POSIX == 1
+}
+
+#if defined(POSIX) && POSIX == 1
+/**************************************************************************//**
+ * Socket event handler.
+ *****************************************************************************/
+static void on_socket_event(int fd, short revents, void *ctx)
+{
+  sink_t *sink = (sink_t *)ctx;
+  uint8_t buf[DEFAULT_BUFLEN];
+  ssize_t size;
+
+  if (sink->state == STATE_CONNECTING) {
+    connect_finish(sink, tcp_connect_finish(&sink->handle) == 0 ? 0 : -1);
+    return;
+  }
+  // A pending error of a UDP socket is cleared by the next send.
+  if ((revents & POLLOUT) || sink->type == SINK_UDP) {
+    write_queue(sink);
+    if (sink->state != STATE_CONNECTED || sink->type == SINK_UDP) {
+      return;
+    }
+  }
+  if (sink->type == SINK_MQTT) {
+    mqtt_receive(sink);
+  } else if (revents & (POLLIN | POLLHUP | POLLERR)) {
+    // The server is not expected to send anything, discard the data. Reading
+    // zero bytes or an error means that the connection is gone.
+    size = read(fd, buf, sizeof(buf));
+    if (size == 0 || (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      connection_lost(sink);
+    }
+  }
+}
+
+static void on_reconnect_timer(app_poll_timer_t *timer, void *ctx)
+{
+  sink_t *sink = (sink_t *)ctx;
+
+  (void)timer;
+  if (sink->state == STATE_SESSION) {
+    app_log_warning("Output %s: no CONNACK from the broker." APP_LOG_NL,
+                    sink->name);
+    connect_finish(sink, -1);
+  } else {
+    connect_start(sink);
+  }
+}
+
+static void on_keep_alive_timer(app_poll_timer_t *timer, void *ctx)
+{
+  (void)timer;
+  mqtt_keep_alive((sink_t *)ctx);
+}
+#endif // defined(POSIX) && POSIX == 1
+
+/**************************************************************************//**
+ * Send the CONNECT packet on a new connection to an MQTT broker and wait for
+ * the CONNACK.
+ *****************************************************************************/
+static void mqtt_start_session(sink_t *sink)
+{
+  uint8_t packet[MQTT_CONNECT_MAX_LEN];
+  uint32_t len;
+
+  len = mqtt_connect(packet, sink->client_id,
+                     (sink->username[0] != '\0') ? sink->username : NULL,
+                     (sink->password[0] != '\0') ? sink->password : NULL,
+                     OUTPUT_MQTT_KEEP_ALIVE);
+  // The send buffer of a new connection takes the whole packet.
+  if (mqtt_send(sink, packet, len) != (int32_t)len) {
+    connect_finish(sink, -1);
+    return;
+  }
+  sink->state = STATE_SESSION;
+  update_poll(sink);
+#if defined(POSIX) && POSIX == 1
+  app_poll_timer_start(&sink->reconnect_timer, OUTPUT_MQTT_CONNACK_TIMEOUT, 0,
+                       on_reconnect_timer, sink);
+#else // defined(POSIX) && POSIX == 1
+  sink->reconnect_us = aoa_time_us() + (uint64_t)OUTPUT_MQTT_CONNACK_TIMEOUT * 1000;
+#endif // defined(POSIX) && POSIX == 1
+}
+
+/**************************************************************************//**
+ * Read and handle the packets from the broker.
+ *****************************************************************************/
+static void mqtt_receive(sink_t *sink)
+{
+  mqtt_packet_t packet;
+  int32_t size;
+  int32_t len;
+
+#if defined(POSIX) && POSIX == 1
+  size = (int32_t)read(sink->handle, &sink->rx[sink->rx_len],
+                       sizeof(sink->rx) - sink->rx_len);
+  if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+    return;
+  }
+#else // defined(POSIX) && POSIX == 1
+  size = tcp_rx_peek(&sink->handle);
+  if (size == 0) {
+    return;
+  }
+  if (size > 0) {
+    size = tcp_rx_partial(&sink->handle, sizeof(sink->rx) - sink->rx_len,
+                          &sink->rx[sink->rx_len]);
+  }
+#endif // defined(POSIX) && POSIX == 1
+  if (size <= 0) {
+    connection_lost(sink);
+    return;
+  }
+  sink->rx_len += (uint32_t)size;
+
+  while ((len = mqtt_parse(sink->rx, sink->rx_len, &packet)) > 0) {
+    sink->rx_len -= (uint32_t)len;
+    memmove(sink->rx, &sink->rx[len], sink->rx_len);
+    if (packet.type == MQTT_CONNACK && sink->state == STATE_SESSION) {
+      mqtt_on_connack(sink, packet.return_code);
+    } else if (packet.type == MQTT_PUBACK) {
+      mqtt_on_puback(sink, packet.packet_id);
+    }
+    if (sink->state != STATE_CONNECTED && sink->state != STATE_SESSION) {
+      return;
+    }
+  }
+  // Nothing longer than the buffer is expected from the broker.
+  if (len < 0 || sink->rx_len == sizeof(sink->rx)) {
+    app_log_warning("Output %s: invalid packet from the broker." APP_LOG_NL,
+                    sink->name);
+    connection_lost(sink);
+  }
+}
+
+/**************************************************************************//**
+ * Start publishing once the broker accepted the connection. PUBLISH packets
+ * not acknowledged on the previous connection are sent again first.
+ *****************************************************************************/
+static void mqtt_on_connack(sink_t *sink, uint8_t return_code)
+{
+#if defined(POSIX) && POSIX == 1
+  app_poll_timer_stop(&sink->reconnect_timer);
+#endif // defined(POSIX) && POSIX == 1
+  if (return_code != 0) {
+    app_log_warning("Output %s: connection refused by the broker, code %u." APP_LOG_NL,
+                    sink->name, return_code);
+    connect_finish(sink, -1);
+    return;
+  }
+  if (sink->inflight_count > 0) {
+    memmove(&sink->queue[sink->inflight_count], sink->queue,
+            sink->queue_count * sizeof(*sink->queue));
+    memcpy(sink->queue, sink->inflight,
+           sink->inflight_count * sizeof(*sink->queue));
+    for (uint32_t i = 0; i < sink->inflight_count; i++) {
+      ENTRY(sink, sink->inflight[i])->data[0] |= MQTT_PUBLISH_DUP;
+    }
+    sink->queue_count += sink->inflight_count;
+    sink->stats.resent += sink->inflight_count;
+    sink->inflight_count = 0;
+  }
+  sink->state = STATE_CONNECTED;
+  sink->stats.connects++;
+  sink->backoff = 0;
+  app_log_info("Output %s connected, %u results queued." APP_LOG_NL,
+               sink->name, sink->queue_count);
+  sink->last_write_us = aoa_time_us();
+#if defined(POSIX) && POSIX == 1
+  // A ping is only sent when nothing was written for half of the keep alive
+  // interval. Checking twice as often keeps the ping well within it.
+  app_poll_timer_start(&sink->keep_alive_timer,
+                       OUTPUT_MQTT_KEEP_ALIVE * 1000 / 4,
+                       OUTPUT_MQTT_KEEP_ALIVE * 1000 / 4,
+                       on_keep_alive_timer, sink);
+#endif // defined(POSIX) && POSIX == 1
+  write_queue(sink);
+}
+
+// Release an acknowledged PUBLISH packet.
+static void mqtt_on_puback(sink_t *sink, uint16_t packet_id)
+{
+  uint32_t i;
+
+  // The acknowledgements come in order, the first one normally matches.
+  for (i = 0; i < sink->inflight_count; i++) {
+    entry_t *entry = ENTRY(sink, sink->inflight[i]);
+    // The packet identifier follows the fixed header and the topic.
+    uint32_t pos = 1;
+    while (entry->data[pos++] & 0x80) {
+    }
+    pos += 2 + ((uint32_t)entry->data[pos] << 8 | entry->data[pos + 1]);
+    if ((uint16_t)(entry->data[pos] << 8 | entry->data[pos + 1]) == packet_id) {
+      break;
+    }
+  }
+  if (i == sink->inflight_count) {
+    return;
+  }
+  sink->free_entries[sink->free_count++] = sink->inflight[i];
+  sink->inflight_count--;
+  memmove(&sink->inflight[i], &sink->inflight[i + 1],
+          (sink->inflight_count - i) * sizeof(*sink->inflight));
+  sink->stats.acked++;
+  // Room in flight again.
+  if (sink->state == STATE_CONNECTED && !sink->blocked) {
+    write_queue(sink);
+  }
+}
+
+// Send a PINGREQ if nothing was sent for half of the keep alive interval.
+static void mqtt_keep_alive(sink_t *sink)
+{
+  uint8_t packet[MQTT_PINGREQ_LEN];
+  uint32_t len;
+
+  if (sink->state != STATE_CONNECTED || sink->sent_offset > 0 || sink->blocked
+      || aoa_time_us() - sink->last_write_us
+      < (uint64_t)OUTPUT_MQTT_KEEP_ALIVE * 1000000 / 2) {
+    return;
+  }
+  len = mqtt_empty_packet(packet, MQTT_PINGREQ);
+  if (mqtt_send(sink, packet, len) != (int32_t)len) {
+    connection_lost(sink);
+  }
+}
+
+// Send a packet outside of the queue, when no PUBLISH is partially sent.
+static int32_t mqtt_send(sink_t *sink, uint8_t *packet, uint32_t len)
+{
+  tcp_buf_t buf = { packet, len };
+  int32_t rc = tcp_txv(&sink->handle, &buf, 1);
+
+  if (rc > 0) {
+    sink->last_write_us = aoa_time_us();
+  }
+  return rc;
+}
+
+static void sleep_ms(uint32_t ms)
+{
+#if defined(POSIX) && POSIX == 1
+  struct timespec ts;
+  ts.tv_sec = (time_t)(ms / 1000);
+  ts.tv_nsec = (long)(ms % 1000) * 1000000;
+  nanosleep(&ts, NULL);
+#else // defined(POSIX) && POSIX == 1
+  Sleep(ms);
+#endif // defined(POSIX) && POSIX == 1
+}
@@ -0,0 +1,284 @@
+/***************************************************************************//**
+ * @file
+ * @brief Output of the results to sinks
+ *
+ * Every result is formatted once per format and delivered to all the sinks:
+ * TCP and local (Unix domain) socket servers, UDP destinations and files.
+ * Each sink has its own format, batching and queue.
+ *
+ * Results are collected into batches that are sent with a single gathered
+ * write. A batch is sent when the main loop runs out of events, when it is
+ * full, or when its first result has waited for the maximum latency. UDP
+ * sinks send each batch in as few datagrams as possible, a datagram only
+ * holds whole results.
+ *
+ * The sockets are non-blocking. What a sink does not take at once stays in
+ * its bounded queue and is sent when the socket becomes writable, so a slow
+ * server never holds up the processing of the IQ reports or the other
+ * sinks. When the queue is full, results are dropped per tag according to
+ * the queue policy.
+ *
+ * If a sink cannot be opened or its connection is lost, the results are
+ * kept in the same queue and the sink is opened again with exponential
+ * backoff. The queue is sent when the sink is back.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_status.h"
+
+// Optstring argument for getopt.
+#define OUTPUT_OPTSTRING "O:o:m:d:D:"
+
+// Usage info.
+#define OUTPUT_USAGE "[-O <sink>]... [-o <format>] [-m <max_latency>] [-d <queue_depth>] [-D <policy>] "
+
+// Options info.
+#define OUTPUT_OPTIONS                                                                             \
+  "    -O  Output sink, can be repeated. Without -O, the socket server of -s is used.\n"           \
+  "        <sink>           tcp:<address>[:<port>]  TCP socket server (default port: 8080)\n"      \
+  "                         udp:<address>[:<port>]  UDP datagrams (default port: 8080)\n"          \
+  "                         unix:<path>             Local stream socket server\n"                  \
+  "                         file:<path>             File, results are appended\n"                  \
+  "                         shm:/<name>             Shared memory ring of binary records,\n"       \
+  "                                                 see aoa_shm.h. The depth is the number\n"      \
+  "                                                 of slots (default: 4096).\n"                   \
+  "                         mqtt:<address>[:<port>] MQTT 3.1.1 broker (default port: 1883),\n"     \
+  "                                                 topic: <topic>/<locator>/<tag>\n"              \
+  "                         The sink can be followed by settings that override the\n"              \
+  "                         options below: ,format=<format>,latency=<max_latency>,\n"              \
+  "                         depth=<queue_depth>,policy=<policy>\n"                                 \
+  "                         MQTT settings: ,qos=0|1,topic=<topic>,client=<client_id>,\n"           \
+  "                         user=<username>,password=<password>\n"                                 \
+  "                         (default: qos=0,topic=silabs/aoa/angle, id given by the broker)\n"     \
+  "    -o  Output format.\n"                                                                       \
+  "        <format>         json (default) or binary, see aoa_record.h\n"                          \
+  "    -m  Maximum time a result is held back to be sent with later results.\n"                    \
+  "        <max_latency>    Milliseconds, 0 sends every result at once (default: 5)\n"             \
+  "    -d  Number of results that can wait for a slow or missing sink.\n"                          \
+  "        <queue_depth>    Queue depth, default: 256\n"                                           \
+  "    -D  What to drop when the output queue is full.\n"                                          \
+  "        <policy>         oldest: the oldest result of the same tag (default)\n"                 \
+  "                         latest: all but the latest result of every tag\n"
+
+// Maximum number of sinks.
+#define OUTPUT_MAX_SINKS            8
+
+// Default maximum latency added by batching in milliseconds.
+#define OUTPUT_MAX_LATENCY_DEFAULT  5
+
+// Maximum number of results in a batch.
+#define OUTPUT_BATCH_COUNT          64
+
+// Batch size that is sent without waiting for more results.
+#define OUTPUT_BATCH_BYTES          8192
+
+// Maximum size of a UDP datagram, fits in an Ethernet frame.
+#define OUTPUT_DATAGRAM_MAX_LEN     1472
+
+// Default number of results that can wait to be sent.
+#define OUTPUT_QUEUE_DEPTH_DEFAULT  256
+
+// Time to send the queues when closing, in milliseconds.
+#define OUTPUT_CLOSE_TIMEOUT        1000
+
+// Shortest and longest time between connection attempts in milliseconds.
+#define OUTPUT_RECONNECT_MIN        250
+#define OUTPUT_RECONNECT_MAX        30000
+
+// Maximum size of one result.
+#define OUTPUT_RESULT_MAX_LEN       256
+
+// Maximum length of a sink name, e.g. "tcp:127.0.0.1:8080".
+#define OUTPUT_SINK_NAME_LEN        128
+
+// Default MQTT topic prefix and its maximum length.
+#define OUTPUT_MQTT_TOPIC_DEFAULT   "silabs/aoa/angle"
+#define OUTPUT_MQTT_PREFIX_LEN      64
+
+// Maximum length of the locator and tag IDs in an MQTT topic.
+#define OUTPUT_MQTT_ID_MAX_LEN      48
+
+// Maximum length of an MQTT topic: <prefix>/<locator>/<tag>.
+#define OUTPUT_MQTT_TOPIC_MAX_LEN   (OUTPUT_MQTT_PREFIX_LEN + 2 * OUTPUT_MQTT_ID_MAX_LEN + 2)
+
+// MQTT keep alive interval in seconds.
+#define OUTPUT_MQTT_KEEP_ALIVE      60
+
+// Time to wait for the CONNACK of the broker in milliseconds.
+#define OUTPUT_MQTT_CONNACK_TIMEOUT 5000
+
+// Maximum number of PUBLISH packets with QoS 1 waiting for their PUBACK.
+#define OUTPUT_MQTT_INFLIGHT_MAX    64
+
+// Formats of the results.
+typedef enum {
+  OUTPUT_FORMAT_JSON,
+  OUTPUT_FORMAT_BINARY,
+  OUTPUT_FORMAT_COUNT
+} output_format_t;
+
+// Events that trigger sending a batch.
+typedef enum {
+  OUTPUT_FLUSH_IDLE,      // No more events to process
+  OUTPUT_FLUSH_SIZE,      // Batch full
+  OUTPUT_FLUSH_LATENCY,   // Maximum latency reached
+  OUTPUT_FLUSH_REASONS
+} output_flush_reason_t;
+
+// What to drop when the queue is full.
+typedef enum {
+  OUTPUT_QUEUE_DROP_OLDEST,  // The oldest result of the same tag
+  OUTPUT_QUEUE_KEEP_LATEST   // All but the latest result of every tag
+} output_queue_policy_t;
+
+// A result in every format used by the sinks.
+typedef struct {
+  uint64_t key;           // Same key: same tag, as seen by the same locator
+  const uint8_t *data[OUTPUT_FORMAT_COUNT];
+  uint32_t len[OUTPUT_FORMAT_COUNT];
+  const char *locator_id; // IDs used in the MQTT topic
+  const char *tag_id;
+} output_result_t;
+
+typedef struct {
+  uint64_t results;         // Results sent
+  uint64_t bytes;           // Bytes sent
+  uint32_t writes;          // Gathered writes
+  uint32_t max_batch;       // Most results sent in one write
+  uint32_t flushes[OUTPUT_FLUSH_REASONS];
+  uint32_t blocked;         // Writes that could not send the whole queue
+  uint32_t dropped;         // Results dropped from the full queue
+  uint32_t dropped_offline; // Of which while not connected
+  uint32_t unsent;          // Results still queued when closed
+  uint32_t max_queued;      // Most results waiting in the queue
+  uint32_t depth;           // Queue depth
+  uint32_t attempts;        // Connection attempts
+  uint32_t connects;        // Successful connections
+  uint32_t disconnects;     // Connections lost
+  uint64_t acked;           // MQTT: PUBLISH packets acknowledged by the broker
+  uint32_t resent;          // MQTT: PUBLISH packets sent again after reconnecting
+} output_stats_t;
+
+/**************************************************************************//**
+ * Set output options.
+ *
+ * @param[in] option Option to set.
+ * @param[in] value Value of the option.
+ *
+ * @retval SL_STATUS_OK Option set successfully.
+ * @retval SL_STATUS_NOT_FOUND Unknown option.
+ * @retval SL_STATUS_INVALID_PARAMETER Invalid value.
+ * @retval SL_STATUS_FULL Too many sinks.
+ *****************************************************************************/
+sl_status_t output_set_option(char option, char *value);
+
+/**************************************************************************//**
+ * Open the sinks. The function does not wait for the connections, results
+ * are queued until they are established.
+ *
+ * @param[in] host Address of the socket server of -s, kept until
+ *                 output_close. NULL if not given.
+ * @param[in] port Port of the socket server of -s, kept until output_close.
+ *
+ * The socket server is added as a TCP sink if host is given or there are no
+ * other sinks.
+ *
+ * @retval SL_STATUS_OK Output opened.
+ * @retval SL_STATUS_INVALID_STATE Output already open.
+ * @retval SL_STATUS_FULL Too many sinks.
+ * @retval SL_STATUS_ALLOCATION_FAILED Not enough memory for the queues.
+ *****************************************************************************/
+sl_status_t output_open(char *host, char *port);
+
+/**************************************************************************//**
+ * Check whether the output is open. The connections themselves may be down.
+ *****************************************************************************/
+bool output_is_open(void);
+
+/**************************************************************************//**
+ * Get the formats used by the sinks.
+ *
+ * @return Bit mask of the formats, bit n is output_format_t n.
+ *****************************************************************************/
+uint32_t output_get_formats(void);
+
+/**************************************************************************//**
+ * Add a result to the current batch of every sink. The data is copied.
+ *
+ * @param[in] result Result in every format returned by output_get_formats.
+ *
+ * @retval SL_STATUS_OK Result added.
+ * @retval SL_STATUS_INVALID_STATE The output is not open.
+ * @retval SL_STATUS_INVALID_PARAMETER A format used by a sink is missing, or
+ *                                     the IDs of an MQTT sink.
+ * @retval SL_STATUS_WOULD_OVERFLOW The result is longer than
+ *                                  OUTPUT_RESULT_MAX_LEN.
+ *****************************************************************************/
+sl_status_t output_write(const output_result_t *result);
+
+/**************************************************************************//**
+ * Send the current batches. Called when the main loop has no more events.
+ *****************************************************************************/
+void output_flush(void);
+
+/**************************************************************************//**
+ * Send the current batches and close the sinks. Waits at most
+ * OUTPUT_CLOSE_TIMEOUT milliseconds for the servers to take the queues.
+ *****************************************************************************/
+void output_close(void);
+
+/**************************************************************************//**
+ * Get the number of sinks.
+ *****************************************************************************/
+uint32_t output_get_sink_count(void);
+
+/**************************************************************************//**
+ * Get the name of a sink, the sink option without its settings.
+ *
+ * @param[in] sink Index of the sink.
+ *
+ * @return Name of the sink or NULL if there is no such sink.
+ *****************************************************************************/
+const char *output_get_sink_name(uint32_t sink);
+
+/**************************************************************************//**
+ * Get the output statistics of a sink.
+ *
+ * @param[in] sink Index of the sink.
+ * @param[out] stats Statistics since the start of the application.
+ *
+ * @retval SL_STATUS_OK Statistics returned.
+ * @retval SL_STATUS_NOT_FOUND There is no such sink.
+ *****************************************************************************/
+sl_status_t output_get_stats(uint32_t sink, output_stats_t *stats);
+
+#endif // OUTPUT_H
@@ -0,0 +1,284 @@
+/***************************************************************************//**
+ * @file
+ * @brief Load shedding of the angle estimation
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_log.h"
+#include "aoa_angle.h"
+#include "aoa_angle_config.h"
+#include "aoa_util.h"
+#include "overload.h"
+
+#if defined(POSIX) && POSIX == 1
+#include "app_poll.h"
+#endif // defined(POSIX) && POSIX == 1
+
+// Estimator mode and decimation of a level.
+typedef struct {
+  enum sl_rtl_aox_mode mode;
+  uint32_t decimation;      // 1 of every N reports of a tag is estimated
+} level_t;
+
+static bool enabled = false;
+static uint32_t load_high;
+static uint32_t load_low;
+static uint32_t thread_count = 1;
+// The levels above 0 share the cheaper mode, so that only the step between
+// level 0 and 1 creates the estimators again.
+static level_t levels[OVERLOAD_LEVELS] = {
+  { AOX_MODE, 1 },
+  { SL_RTL_AOX_MODE_REAL_TIME_FAST_RESPONSE, 1 },
+  { SL_RTL_AOX_MODE_REAL_TIME_FAST_RESPONSE, 2 },
+  { SL_RTL_AOX_MODE_REAL_TIME_FAST_RESPONSE, 4 }
+};
+static overload_stats_t stats;
+
+// The current interval.
+static uint64_t interval_start_us;
+static uint64_t busy_us;          // Time spent in the estimator
+static uint32_t estimates;
+static uint32_t min_backlog = UINT32_MAX;  // Standing queue, bursts left out
+static uint32_t calm_intervals;   // Intervals in a row with a low load
+
+// Mean estimation time at each level, 0: not measured yet.
+static double cost_us[OVERLOAD_LEVELS];
+
+#if defined(POSIX) && POSIX == 1
+// Ends the intervals in which no estimate finishes. It ticks more often than
+// the intervals end, as those that do end with an estimate move them.
+#define OVERLOAD_POLL_PERIOD            (OVERLOAD_INTERVAL / 10)
+static app_poll_timer_t interval_timer;
+#endif // defined(POSIX) && POSIX == 1
+
+static enum sl_rtl_aox_mode cheaper_mode(enum sl_rtl_aox_mode mode);
+static void decide(uint64_t now);
+static uint32_t expected_load(uint32_t load);
+#if defined(POSIX) && POSIX == 1
+static void on_interval(app_poll_timer_t *timer, void *ctx);
+#endif // defined(POSIX) && POSIX == 1
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+sl_status_t overload_set_option(char option, char *value)
+{
+  char *end;
+  unsigned long high;
+  unsigned long low;
+
+  switch (option) {
+    // Load thresholds.
+    case 'S':
+      high = strtoul(value, &end, 10);
+      low = high / 2;
+      if (*end == ',') {
+        low = strtoul(end + 1, &end, 10);
+      }
+      if (*end != '\0' || high == 0 || high > 100 || low >= high) {
+        app_log_error("Invalid load thresholds: expected <high>[,<low>] with 0 <= low < high <= 100" APP_LOG_NL);
+        return SL_STATUS_INVALID_PARAMETER;
+      }
+      load_high = (uint32_t)high;
+      load_low = (uint32_t)low;
+      enabled = true;
+      return SL_STATUS_OK;
+    // Unknown option.
+    default:
+      return SL_STATUS_NOT_FOUND;
+  }
+}
+
+void overload_init(enum sl_rtl_aox_mode mode, uint32_t threads)
+{
+  levels[0].mode = mode;
+  for (uint32_t i = 1; i < OVERLOAD_LEVELS; i++) {
+    levels[i].mode = cheaper_mode(mode);
+  }
+  thread_count = (threads > 0) ? threads : 1;
+  interval_start_us = aoa_time_us();
+  if (enabled) {
+    app_log_info("Shedding load above %u%%, restoring below %u%%, cheaper mode %s." APP_LOG_NL,
+                 load_high, load_low, aoa_mode_name(levels[1].mode));
+#if defined(POSIX) && POSIX == 1
+    app_poll_timer_start(&interval_timer, OVERLOAD_POLL_PERIOD,
+                         OVERLOAD_POLL_PERIOD, on_interval, NULL);
+#endif // defined(POSIX) && POSIX == 1
+  }
+}
+
+bool overload_admit(uint32_t *reports, enum sl_rtl_aox_mode *mode)
+{
+  const level_t *level = &levels[stats.level];
+
+  *mode = level->mode;
+  if ((*reports)++ % level->decimation != 0) {
+    stats.decimated++;
+    return false;
+  }
+  return true;
+}
+
+void overload_update(uint32_t estimate_us, uint32_t backlog)
+{
+  uint64_t now;
+
+  if (!enabled) {
+    return;
+  }
+  busy_us += estimate_us;
+  estimates++;
+  if (backlog < min_backlog) {
+    min_backlog = backlog;
+  }
+  now = aoa_time_us();
+  if (now - interval_start_us >= (uint64_t)OVERLOAD_INTERVAL * 1000) {
+    decide(now);
+  }
+}
+
+void overload_poll(void)
+{
+  uint64_t now;
+
+  if (!enabled) {
+    return;
+  }
+  now = aoa_time_us();
+  if (now - interval_start_us >= (uint64_t)OVERLOAD_INTERVAL * 1000) {
+    decide(now);
+  }
+}
+
+void overload_get_stats(overload_stats_t *overload_stats)
+{
+  *overload_stats = stats;
+}
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+// The cheaper mode of the levels above 0. The one shot modes keep their
+// filtering but give up the elevation.
+static enum sl_rtl_aox_mode cheaper_mode(enum sl_rtl_aox_mode mode)
+{
+  switch (mode) {
+    case SL_RTL_AOX_MODE_ONE_SHOT_BASIC:
+    case SL_RTL_AOX_MODE_ONE_SHOT_BASIC_LIGHTWEIGHT:
+      return SL_RTL_AOX_MODE_ONE_SHOT_BASIC_AZIMUTH_ONLY;
+    case SL_RTL_AOX_MODE_ONE_SHOT_FAST_RESPONSE:
+      return SL_RTL_AOX_MODE_ONE_SHOT_FAST_RESPONSE_AZIMUTH_ONLY;
+    case SL_RTL_AOX_MODE_ONE_SHOT_HIGH_ACCURACY:
+      return SL_RTL_AOX_MODE_ONE_SHOT_HIGH_ACCURACY_AZIMUTH_ONLY;
+    case SL_RTL_AOX_MODE_REAL_TIME_BASIC:
+    case SL_RTL_AOX_MODE_REAL_TIME_HIGH_ACCURACY:
+      return SL_RTL_AOX_MODE_REAL_TIME_FAST_RESPONSE;
+    default:
+      return mode;
+  }
+}
+
+// Decide the level at the end of an interval and start the next one.
+static void decide(uint64_t now)
+{
+  uint32_t level = stats.level;
+  uint32_t next = level;
+  uint32_t load;
+
+  load = (uint32_t)(busy_us * 100 / ((now - interval_start_us) * thread_count));
+  if (estimates > 0) {
+    cost_us[level] = (double)busy_us / estimates;
+  } else {
+    // Nothing was estimated, the reports have stopped or are all skipped.
+    min_backlog = 0;
+  }
+  stats.intervals[level]++;
+
+  if (load >= load_high || min_backlog >= OVERLOAD_BACKLOG_HIGH) {
+    calm_intervals = 0;
+    if (level + 1 < OVERLOAD_LEVELS) {
+      next = level + 1;
+    }
+  } else if (level > 0 && min_backlog < OVERLOAD_BACKLOG_LOW
+             && expected_load(load) < load_low) {
+    if (++calm_intervals >= OVERLOAD_RESTORE_INTERVALS) {
+      calm_intervals = 0;
+      next = level - 1;
+    }
+  } else {
+    calm_intervals = 0;
+  }
+
+  if (next != level) {
+    stats.level = next;
+    stats.changes++;
+    if (next > stats.max_level) {
+      stats.max_level = next;
+    }
+    if (next > level) {
+      app_log_warning("Overload: load %u%%, backlog %u%%, level %u -> %u: %s, 1 of %u reports" APP_LOG_NL,
+                      load, min_backlog, level, next,
+                      aoa_mode_name(levels[next].mode), levels[next].decimation);
+    } else {
+      app_log_info("Overload: load %u%%, backlog %u%%, level %u -> %u: %s, 1 of %u reports" APP_LOG_NL,
+                   load, min_backlog, level, next,
+                   aoa_mode_name(levels[next].mode), levels[next].decimation);
+    }
+  }
+
+  interval_start_us = now;
+  busy_us = 0;
+  estimates = 0;
+  min_backlog = UINT32_MAX;
+}
+
+// Load expected at the level below the current one, from the estimation
+// time measured there and the decimation.
+static uint32_t expected_load(uint32_t load)
+{
+  uint32_t level = stats.level;
+  double expected = (double)load * levels[level].decimation
+                    / levels[level - 1].decimation;
+
+  if (cost_us[level - 1] > 0 && cost_us[level] > 0) {
+    expected = expected * cost_us[level - 1] / cost_us[level];
+  }
+  return (uint32_t)expected;
+}
+
+#if defined(POSIX) && POSIX == 1
+static void on_interval(app_poll_timer_t *timer, void *ctx)
+{
+  (void)timer;
+  (void)ctx;
+  overload_poll();
+}
+#endif // defined(POSIX) && POSIX == 1
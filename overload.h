@@ -0,0 +1,151 @@
+/***************************************************************************//**
+ * @file
+ * @brief Load shedding of the angle estimation
+ *
+ * With -S, the load of the angle estimation is watched: the time spent in
+ * the estimator per second of every estimating thread, and how full the
+ * queue in front of the estimation is. Once a second, the load decides the
+ * level of all tags, also when no estimate has finished in that second:
+ *
+ *   0  Full quality: the configured estimator mode, every report
+ *   1  Cheaper estimator mode: REAL_TIME_FAST_RESPONSE for the real time
+ *      modes, the AZIMUTH_ONLY variant for the one shot modes
+ *   2  Cheaper mode, every 2nd report of a tag
+ *   3  Cheaper mode, every 4th report of a tag
+ *
+ * The queue fill is the lowest seen in the interval, so that the bursts of
+ * reports arriving together do not count, only a queue that never drains.
+ * The level steps up when the load reaches the high threshold or the queue
+ * stays half full. It steps down when the load expected at the level below,
+ * scaled from the estimation time and the decimation measured at each
+ * level, stays under the low threshold for OVERLOAD_RESTORE_INTERVALS and
+ * the queue drains. Every level change is logged.
+ *
+ * A tag changes its estimator mode with its next report, which starts the
+ * filtering of its estimator over. Only the step between level 0 and 1
+ * changes the mode, the estimators keep their state across the decimation
+ * levels. With a configured mode that has no cheaper one, they always do.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_rtl_clib_api.h"
+#include "sl_status.h"
+
+// Optstring argument for getopt.
+#define OVERLOAD_OPTSTRING "S:"
+
+// Usage info.
+#define OVERLOAD_USAGE "[-S <high>[,<low>]] "
+
+// Options info.
+#define OVERLOAD_OPTIONS                                                                           \
+  "    -S  Shed load when the angle estimation falls behind, default: disabled.\n"                 \
+  "        <high>           Estimation load in percent that lowers the quality\n"                  \
+  "        <low>            Load in percent below which the quality is restored,\n"                \
+  "                         default: half of <high>\n"
+
+// Number of levels, see above.
+#define OVERLOAD_LEVELS                 4
+
+// Interval of the level decisions in milliseconds.
+#define OVERLOAD_INTERVAL               1000
+
+// Intervals with a low load before the level steps down.
+#define OVERLOAD_RESTORE_INTERVALS      5
+
+// Lowest queue fill of an interval in percent that steps the level up, and
+// the fill below which it may step down.
+#define OVERLOAD_BACKLOG_HIGH           50
+#define OVERLOAD_BACKLOG_LOW            10
+
+typedef struct {
+  uint32_t level;                       // Current level
+  uint32_t max_level;                   // Highest level reached
+  uint32_t changes;                     // Level changes
+  uint64_t decimated;                   // Reports skipped by the decimation
+  uint64_t intervals[OVERLOAD_LEVELS];  // Intervals spent at each level
+} overload_stats_t;
+
+/**************************************************************************//**
+ * Set load shedding options.
+ *
+ * @param[in] option Option to set.
+ * @param[in] value Value of the option.
+ *
+ * @retval SL_STATUS_OK Option set successfully.
+ * @retval SL_STATUS_NOT_FOUND Unknown option.
+ * @retval SL_STATUS_INVALID_PARAMETER Invalid value.
+ *****************************************************************************/
+sl_status_t overload_set_option(char option, char *value);
+
+/**************************************************************************//**
+ * Start at full quality.
+ *
+ * @param[in] mode Configured estimator mode.
+ * @param[in] threads Number of threads estimating the angles.
+ *****************************************************************************/
+void overload_init(enum sl_rtl_aox_mode mode, uint32_t threads);
+
+/**************************************************************************//**
+ * Decide whether to estimate a report of a tag, and in which mode.
+ *
+ * @param[in,out] reports Report counter of the tag.
+ * @param[out] mode Estimator mode for the report.
+ *
+ * @return false if the report is skipped by the decimation.
+ *****************************************************************************/
+bool overload_admit(uint32_t *reports, enum sl_rtl_aox_mode *mode);
+
+/**************************************************************************//**
+ * Account a finished estimation and decide the level at the end of an
+ * interval.
+ *
+ * @param[in] estimate_us Time spent in the estimator.
+ * @param[in] backlog Fill of the queue in front of the estimation, percent.
+ *****************************************************************************/
+void overload_update(uint32_t estimate_us, uint32_t backlog);
+
+/**************************************************************************//**
+ * Decide the level once an interval has passed, even if no estimate has
+ * finished in it. Called by a timer of the poll loop, or by the main loop
+ * without one.
+ *****************************************************************************/
+void overload_poll(void);
+
+/**************************************************************************//**
+ * Get the load shedding statistics.
+ *
+ * @param[out] stats Statistics since the start of the application.
+ *****************************************************************************/
+void overload_get_stats(overload_stats_t *stats);
+
+#endif // OVERLOAD_H
@@ -0,0 +1,344 @@
+/***************************************************************************//**
+ * @file
+ * @brief Shared memory output latency benchmark.
+ *
+ * Publishes binary angle records at a fixed interval and measures the time
+ * until a reader in another process has them, once through the shared
+ * memory ring (aoa_shm.h) and once through a loopback TCP connection. The
+ * record timestamp carries the monotonic send time in nanoseconds. The
+ * shared memory reader polls the ring without system calls, the TCP reader
+ * blocks in read(). With -y, or on a single CPU, the shared memory reader
+ * yields the CPU while the ring is empty, so that it does not take the time
+ * of the writer.
+ *
+ * Usage: shm_bench [-n <records>] [-i <interval_us>] [-y]
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "aoa_shm.h"
+#include "aoa_shm_reader.h"
+
+#define DEFAULT_RECORD_COUNT  20000
+#define DEFAULT_INTERVAL_US   100
+#define SHM_NAME              "/aoa_shm_bench"
+
+// Yield the CPU while the ring is empty.
+static bool yield;
+
+typedef struct {
+  uint32_t records;
+  uint64_t lost;
+  double mean_us;
+  double p50_us;
+  double p99_us;
+  double max_us;
+} result_t;
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t)
+{
+  struct timespec ts;
+  ts.tv_sec = (time_t)(t / 1000000000ULL);
+  ts.tv_nsec = (long)(t % 1000000000ULL);
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Account the latency of a received record.
+static void add_latency(uint32_t *latencies, uint32_t *count, uint32_t max,
+                        const aoa_record_t *record)
+{
+  if (*count < max) {
+    latencies[(*count)++] = (uint32_t)(now_ns() - record->timestamp);
+  }
+}
+
+static void summarize(uint32_t *latencies, uint32_t count, uint64_t lost,
+                      result_t *result)
+{
+  uint64_t sum = 0;
+
+  memset(result, 0, sizeof(*result));
+  result->records = count;
+  result->lost = lost;
+  if (count == 0) {
+    return;
+  }
+  qsort(latencies, count, sizeof(*latencies), compare_u32);
+  for (uint32_t i = 0; i < count; i++) {
+    sum += latencies[i];
+  }
+  result->mean_us = (double)sum / count / 1e3;
+  result->p50_us = latencies[count / 2] / 1e3;
+  result->p99_us = latencies[(uint64_t)count * 99 / 100] / 1e3;
+  result->max_us = latencies[count - 1] / 1e3;
+}
+
+// Reader process of the shared memory case.
+static void shm_reader(int ready, uint32_t *latencies, uint32_t max,
+                       result_t *result)
+{
+  aoa_shm_reader_t reader;
+  aoa_record_t record;
+  uint32_t count = 0;
+  int32_t rc;
+
+  if (aoa_shm_reader_open(&reader, SHM_NAME) != 0) {
+    perror("aoa_shm_reader_open");
+    exit(EXIT_FAILURE);
+  }
+  if (write(ready, "r", 1) != 1) {
+    exit(EXIT_FAILURE);
+  }
+  while ((rc = aoa_shm_reader_read(&reader, &record)) >= 0) {
+    if (rc == 1) {
+      add_latency(latencies, &count, max, &record);
+    } else if (yield) {
+      sched_yield();
+    }
+  }
+  summarize(latencies, count, reader.lost, result);
+  aoa_shm_reader_close(&reader);
+}
+
+// Reader process of the TCP case.
+static void tcp_reader(int ready, int listener, uint32_t *latencies,
+                       uint32_t max, result_t *result)
+{
+  uint8_t buf[4096];
+  aoa_record_t record;
+  uint32_t frame_len;
+  uint32_t count = 0;
+  uint32_t len = 0;
+  uint32_t pos;
+  ssize_t n;
+  int fd;
+
+  if (write(ready, "r", 1) != 1) {
+    exit(EXIT_FAILURE);
+  }
+  fd = accept(listener, NULL, NULL);
+  if (fd < 0) {
+    perror("accept");
+    exit(EXIT_FAILURE);
+  }
+  while ((n = read(fd, &buf[len], sizeof(buf) - len)) > 0) {
+    len += (uint32_t)n;
+    pos = 0;
+    while (aoa_record_decode(&buf[pos], len - pos, &record, &frame_len)
+           == SL_STATUS_OK) {
+      add_latency(latencies, &count, max, &record);
+      pos += frame_len;
+    }
+    memmove(buf, &buf[pos], len - pos);
+    len -= pos;
+  }
+  close(fd);
+  summarize(latencies, count, 0, result);
+}
+
+static void encode(uint8_t *frame, uint32_t i)
+{
+  aoa_record_t record;
+
+  memset(&record, 0, sizeof(record));
+  record.angle.azimuth = (float)(i % 360);
+  record.angle.sequence = (int32_t)i;
+  record.timestamp = now_ns();
+  aoa_record_encode(&record, frame);
+}
+
+/**************************************************************************//**
+ * Run one case: start the reader process, publish the records at the given
+ * interval and collect the result of the reader.
+ *****************************************************************************/
+static bool run_case(bool shm, uint32_t records, uint32_t interval_us,
+                     result_t *result)
+{
+  uint8_t frame[AOA_RECORD_FRAME_LEN];
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  aoa_shm_t ring;
+  int ready[2];
+  int results[2];
+  int listener = -1;
+  int fd = -1;
+  int one = 1;
+  char c;
+  pid_t pid;
+  uint64_t start;
+
+  if (pipe(ready) != 0 || pipe(results) != 0) {
+    return false;
+  }
+  if (shm) {
+    if (aoa_shm_create(&ring, SHM_NAME, AOA_SHM_SLOT_COUNT_DEFAULT) != 0) {
+      perror("aoa_shm_create");
+      return false;
+    }
+  } else {
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(listener, 1) != 0
+        || getsockname(listener, (struct sockaddr *)&addr, &addr_len) != 0) {
+      perror("listen");
+      return false;
+    }
+  }
+
+  // Nothing buffered may be printed twice.
+  fflush(stdout);
+  pid = fork();
+  if (pid == 0) {
+    uint32_t *latencies = malloc(records * sizeof(*latencies));
+    if (latencies == NULL) {
+      exit(EXIT_FAILURE);
+    }
+    if (shm) {
+      shm_reader(ready[1], latencies, records, result);
+    } else {
+      tcp_reader(ready[1], listener, latencies, records, result);
+    }
+    if (write(results[1], result, sizeof(*result)) != sizeof(*result)) {
+      exit(EXIT_FAILURE);
+    }
+    exit(EXIT_SUCCESS);
+  }
+  if (pid < 0 || read(ready[0], &c, 1) != 1) {
+    return false;
+  }
+  if (!shm) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      perror("connect");
+      kill(pid, SIGKILL);
+      return false;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  start = now_ns();
+  for (uint32_t i = 0; i < records; i++) {
+    sleep_until(start + (uint64_t)i * interval_us * 1000);
+    encode(frame, i);
+    if (shm) {
+      aoa_shm_write(&ring, frame, sizeof(frame));
+    } else if (write(fd, frame, sizeof(frame)) != sizeof(frame)) {
+      perror("write");
+      break;
+    }
+  }
+  if (shm) {
+    aoa_shm_close(&ring);
+  } else {
+    close(fd);
+    close(listener);
+  }
+
+  if (read(results[0], result, sizeof(*result)) != sizeof(*result)) {
+    return false;
+  }
+  waitpid(pid, NULL, 0);
+  close(ready[0]);
+  close(ready[1]);
+  close(results[0]);
+  close(results[1]);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t records = DEFAULT_RECORD_COUNT;
+  uint32_t interval_us = DEFAULT_INTERVAL_US;
+  int opt;
+
+  yield = (sysconf(_SC_NPROCESSORS_ONLN) == 1);
+  while ((opt = getopt(argc, argv, "n:i:yh")) != -1) {
+    switch (opt) {
+      case 'n':
+        records = (uint32_t)atol(optarg);
+        break;
+      case 'i':
+        interval_us = (uint32_t)atol(optarg);
+        break;
+      case 'y':
+        yield = true;
+        break;
+      default:
+        printf("Usage: %s [-n <records>] [-i <interval_us>] [-y]\n", argv[0]);
+        return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (records == 0) {
+    fprintf(stderr, "The number of records must be positive.\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("%-6s %8s %6s %10s %10s %10s %10s\n", "sink", "records", "lost",
+         "mean [us]", "p50 [us]", "p99 [us]", "max [us]");
+  for (int shm = 1; shm >= 0; shm--) {
+    result_t r;
+    if (!run_case(shm, records, interval_us, &r)) {
+      return EXIT_FAILURE;
+    }
+    printf("%-6s %8u %6llu %10.2f %10.2f %10.2f %10.2f\n", shm ? "shm" : "tcp",
+           r.records, (unsigned long long)r.lost, r.mean_us, r.p50_us,
+           r.p99_us, r.max_us);
+  }
+  return EXIT_SUCCESS;
+}
@@ -14,45 +14,154 @@
  *
  ******************************************************************************/
 
+#include <stdlib.h>
+#include <string.h>
 #include "sl_bt_ncp_host.h"
 #include "sl_status.h"
 
+#if defined(POSIX) && POSIX == 1
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#endif // defined(POSIX) && POSIX == 1
+
 // We only have bt and btmesh
 #define SL_BGAPI_DEVICE_TYPES 2
 
-bgapi_device_type_queue_t* device_event_queues[SL_BGAPI_DEVICE_TYPES] = { 0 };
-static size_t registered_devices_count = 0;
+// The event queues are single producer, single consumer rings. The write
+// offset is written by the producer only, so acquire/release ordering is
+// sufficient to publish the slots. The read offset is also advanced by the
+// producer when it drops the oldest event, and the consumer announces the
+// slot it is reading in the borrowed field, so these use sequential
+// consistency. The borrowed field is claimed with a compare and swap by
+// either side: the consumer to read the oldest slot, the producer to drop it.
+// The read offset only moves while the field is claimed, so an event is
+// either delivered or dropped, never both.
+#define sli_queue_load(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define sli_queue_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define sli_queue_load_sc(p)  __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define sli_queue_store_sc(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define sli_queue_cas(p, e, v) \
+  __atomic_compare_exchange_n((p), (e), (v), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+#define SLI_QUEUE_SLOT_NONE UINT32_MAX
+// Borrowed field value while the producer drops the oldest event.
+#define SLI_QUEUE_SLOT_DROPPING (UINT32_MAX - 1)
+
+// Interval of checking for room in the queue with SL_BT_API_OVERFLOW_WAIT.
+#define SLI_BGAPI_QUEUE_WAIT_NS 100000
+
+/**
+ * State of one NCP connection.
+ */
+typedef struct {
+  bgapi_device_type_queue_t* device_event_queues[SL_BGAPI_DEVICE_TYPES];
+  size_t registered_devices_count;
+
+  // Bluetooth event queue.
+  bgapi_device_type_queue_t bt_queue;
+  sl_bt_api_queue_stats_t queue_stats;
+
+  // Response to the last command.
+  sl_bt_msg_t rsp_msg;
+
+  // Receive buffer. Input is pulled in chunks as large as currently available,
+  // and BGAPI frames are parsed out of it in place.
+  uint8_t rx_buffer[SL_BT_API_RX_BUFFER_SIZE];
+  uint32_t rx_head; // Start of the first unparsed byte.
+  uint32_t rx_tail; // End of the received data.
+  sl_bt_api_rx_stats_t rx_stats;
+
+#if defined(POSIX) && POSIX == 1
+  // Receive thread state.
+  pthread_t rx_thread;
+  sl_bt_msg_t rx_thread_rsp;
+  // Responses are handed over to the thread waiting in sl_bt_wait_response.
+  pthread_mutex_t rsp_mutex;
+  pthread_cond_t rsp_cond;
+  bool rsp_ready;
+  // The application is waiting for a response, so the receive thread must
+  // not wait for room in the event queue.
+  bool rsp_waiting;
+#endif // defined(POSIX) && POSIX == 1
+} sli_bgapi_instance_t;
+
+static sli_bgapi_instance_t sli_bgapi_instances[SL_BT_API_MAX_INSTANCES];
+static uint8_t sli_bgapi_instance_count = 0;
+// Instance that commands are sent to and input is read from. The receive
+// threads work on their own instance, the application thread selects one.
+static __thread sli_bgapi_instance_t *sli_bgapi_current = NULL;
+// Instance to look at first for the next event.
+static uint8_t sli_bgapi_next_instance = 0;
 
 sl_bt_msg_t _sl_bt_cmd_msg;
-sl_bt_msg_t _sl_bt_rsp_msg;
 sl_bt_msg_t *sl_bt_cmd_msg = &_sl_bt_cmd_msg;
-sl_bt_msg_t *sl_bt_rsp_msg = &_sl_bt_rsp_msg;
+sl_bt_msg_t *sl_bt_rsp_msg = NULL;
 void (*sl_bt_api_output)(uint32_t len1, uint8_t* data1);
 int32_t (*sl_bt_api_input)(uint32_t len1, uint8_t* data1);
 int32_t (*sl_bt_api_peek)(void);
-uint8_t _sl_bt_queue_buffer[SL_BT_API_QUEUE_LEN * (SL_BGAPI_MSG_HEADER_LEN + SL_BGAPI_MAX_PAYLOAD_SIZE)];
 
-bgapi_device_type_queue_t sl_bt_api_queue = {
-  sl_bgapi_dev_type_bt,
-  0, // Write and read offsets start from zero.
-  0,
-  (sl_bt_msg_t *)_sl_bt_queue_buffer,
-  SL_BT_API_QUEUE_LEN
-};
+// Number of events in the queue of each new instance.
+static uint32_t sl_bt_queue_depth = SL_BT_API_QUEUE_LEN - 1;
+static sl_bt_api_overflow_policy_t sl_bt_overflow_policy = SL_BT_API_OVERFLOW_DROP_NEWEST;
+
+#if defined(POSIX) && POSIX == 1
+static bool sl_bt_rx_thread_running = false;
+// Pipe that becomes readable when a receive thread queues events. The flag
+// is set by the receive thread when it writes the pipe and cleared by the
+// processing thread before it checks the queues for the last time, so that
+// the pipe is written only once per wakeup.
+static int sl_bt_event_pipe[2] = { -1, -1 };
+static bool sl_bt_event_signaled = false;
+#endif // defined(POSIX) && POSIX == 1
 
 sl_status_t sli_bgapi_register_device(bgapi_device_type_queue_t *queue)
 {
+  sli_bgapi_instance_t *inst = sli_bgapi_current;
   size_t i;
   for (i = 0; i < SL_BGAPI_DEVICE_TYPES; i++) {
-    if (device_event_queues[i] == NULL) {
-      device_event_queues[i] = queue;
-      registered_devices_count++;
+    if (inst->device_event_queues[i] == NULL) {
+      inst->device_event_queues[i] = queue;
+      inst->registered_devices_count++;
       return SL_STATUS_OK;
     }
   }
   return SL_STATUS_ALREADY_INITIALIZED;
 }
 
+/**
+ * Set up a new instance and select it.
+ */
+static sl_status_t sli_bgapi_add_instance(void)
+{
+  sli_bgapi_instance_t *inst;
+
+  if (sli_bgapi_instance_count == SL_BT_API_MAX_INSTANCES) {
+    return SL_STATUS_FULL;
+  }
+  inst = &sli_bgapi_instances[sli_bgapi_instance_count];
+  // One slot is always left empty to tell a full queue from an empty one.
+  inst->bt_queue.device_type = sl_bgapi_dev_type_bt;
+  inst->bt_queue.write_offset = 0;
+  inst->bt_queue.read_offset = 0;
+  inst->bt_queue.len = sl_bt_queue_depth + 1;
+  inst->bt_queue.borrowed = SLI_QUEUE_SLOT_NONE;
+  inst->bt_queue.buffer = malloc(inst->bt_queue.len * sizeof(sl_bt_msg_t));
+  if (inst->bt_queue.buffer == NULL) {
+    return SL_STATUS_ALLOCATION_FAILED;
+  }
+#if defined(POSIX) && POSIX == 1
+  pthread_mutex_init(&inst->rsp_mutex, NULL);
+  pthread_cond_init(&inst->rsp_cond, NULL);
+#endif // defined(POSIX) && POSIX == 1
+  sli_bgapi_instance_count++;
+  sl_bt_api_select_instance(sli_bgapi_instance_count - 1);
+  return sli_bgapi_register_device(&inst->bt_queue);
+}
+
 sl_status_t sl_bt_api_initialize(tx_func ofunc, rx_func ifunc)
 {
   if (!ofunc || !ifunc) {
@@ -61,7 +170,7 @@ sl_status_t sl_bt_api_initialize(tx_func ofunc, rx_func ifunc)
   sl_bt_api_output = ofunc;
   sl_bt_api_input = ifunc;
   sl_bt_api_peek = NULL;
-  return sli_bgapi_register_device(&sl_bt_api_queue);
+  return sli_bgapi_add_instance();
 }
 
 sl_status_t sl_bt_api_initialize_nonblock(tx_func ofunc, rx_func ifunc, rx_peek_func pfunc)
@@ -72,7 +181,27 @@ sl_status_t sl_bt_api_initialize_nonblock(tx_func ofunc, rx_func ifunc, rx_peek_
   sl_bt_api_output = ofunc;
   sl_bt_api_input = ifunc;
   sl_bt_api_peek = pfunc;
-  return sli_bgapi_register_device(&sl_bt_api_queue);
+  return sli_bgapi_add_instance();
+}
+
+uint8_t sl_bt_api_get_instance_count(void)
+{
+  return sli_bgapi_instance_count;
+}
+
+sl_status_t sl_bt_api_select_instance(uint8_t instance)
+{
+  if (instance >= sli_bgapi_instance_count) {
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  sli_bgapi_current = &sli_bgapi_instances[instance];
+  sl_bt_rsp_msg = &sli_bgapi_current->rsp_msg;
+  return SL_STATUS_OK;
+}
+
+uint8_t sl_bt_api_get_instance(void)
+{
+  return (uint8_t)(sli_bgapi_current - sli_bgapi_instances);
 }
 
 /**
@@ -80,7 +209,7 @@ sl_status_t sl_bt_api_initialize_nonblock(tx_func ofunc, rx_func ifunc, rx_peek_
  */
 bool sli_bgapi_device_queue_has_events(bgapi_device_type_queue_t *device_queue)
 {
-  if (device_queue->write_offset != device_queue->read_offset) {
+  if (sli_queue_load(&device_queue->write_offset) != sli_queue_load_sc(&device_queue->read_offset)) {
     return true;
   }
   return false;
@@ -91,11 +220,12 @@ bool sli_bgapi_device_queue_has_events(bgapi_device_type_queue_t *device_queue)
  */
 bool sli_bgapi_other_events_in_queue(enum sl_bgapi_dev_types my_device_type)
 {
+  sli_bgapi_instance_t *inst = sli_bgapi_current;
   size_t i;
-  for (i = 0; i < registered_devices_count; i++) {
+  for (i = 0; i < inst->registered_devices_count; i++) {
     // Go through all registered device types that don't match the current device type.
-    if (device_event_queues[i] && device_event_queues[i]->device_type != my_device_type) {
-      if (sli_bgapi_device_queue_has_events(device_event_queues[i])) {
+    if (inst->device_event_queues[i] && inst->device_event_queues[i]->device_type != my_device_type) {
+      if (sli_bgapi_device_queue_has_events(inst->device_event_queues[i])) {
         // Another device type has some events in the queue
         return true;
       }
@@ -104,11 +234,276 @@ bool sli_bgapi_other_events_in_queue(enum sl_bgapi_dev_types my_device_type)
   return false;
 }
 
+/**
+ * Pull more data from the input function into the receive buffer.
+ *
+ * The input function is asked for as many bytes as fit into the buffer, and
+ * returns whatever is available at the moment. Any incomplete frame left over
+ * is moved to the beginning of the buffer first if a maximum size frame would
+ * not fit after it anymore.
+ *
+ * Returns the amount of bytes read or -1 on failure.
+ */
+static int32_t sli_bgapi_rx_fill(sli_bgapi_instance_t *inst)
+{
+  int32_t ret;
+  uint32_t pending = inst->rx_tail - inst->rx_head;
+
+  if (pending == 0) {
+    inst->rx_head = 0;
+    inst->rx_tail = 0;
+  } else if (SL_BT_API_RX_BUFFER_SIZE - inst->rx_tail
+             < SL_BGAPI_MSG_HEADER_LEN + SL_BGAPI_MAX_PAYLOAD_SIZE) {
+    memmove(inst->rx_buffer, &inst->rx_buffer[inst->rx_head], pending);
+    inst->rx_head = 0;
+    inst->rx_tail = pending;
+  }
+
+  ret = sl_bt_api_input(SL_BT_API_RX_BUFFER_SIZE - inst->rx_tail,
+                        &inst->rx_buffer[inst->rx_tail]);
+  inst->rx_stats.reads++;
+  if (ret > 0) {
+    inst->rx_tail += (uint32_t)ret;
+    inst->rx_stats.bytes += (uint32_t)ret;
+  }
+  return ret;
+}
+
+/**
+ * Locate the next complete BGAPI frame in the receive buffer.
+ *
+ * Bytes that cannot start a valid header for any of the registered device
+ * types are dropped one by one until the stream is in sync again.
+ *
+ * Returns a pointer to the header of the frame, or NULL if no complete frame
+ * is buffered yet. The header and the matching device queue are stored in the
+ * output parameters.
+ */
+static uint8_t* sli_bgapi_rx_frame(sli_bgapi_instance_t *inst, uint32_t *header, bgapi_device_type_queue_t **queue)
+{
+  uint8_t *frame;
+  size_t i;
+
+  while (inst->rx_tail > inst->rx_head) {
+    frame = &inst->rx_buffer[inst->rx_head];
+    *queue = NULL;
+    for (i = 0; i < SL_BGAPI_DEVICE_TYPES; i++) {
+      if ((inst->device_event_queues[i] != NULL)
+          && ((frame[0] & 0x78) == inst->device_event_queues[i]->device_type)) {
+        *queue = inst->device_event_queues[i];
+        break;
+      }
+    }
+    if (*queue == NULL) {
+      // Unrecognized device, resync on the next byte.
+      inst->rx_head++;
+      inst->rx_stats.discarded++;
+      continue;
+    }
+    if (inst->rx_tail - inst->rx_head < SL_BGAPI_MSG_HEADER_LEN) {
+      return NULL;
+    }
+    memcpy(header, frame, SL_BGAPI_MSG_HEADER_LEN);
+    if (SL_BT_MSG_LEN(*header) > SL_BGAPI_MAX_PAYLOAD_SIZE) {
+      inst->rx_head++;
+      inst->rx_stats.discarded++;
+      continue;
+    }
+    if (inst->rx_tail - inst->rx_head
+        < SL_BGAPI_MSG_HEADER_LEN + SL_BT_MSG_LEN(*header)) {
+      return NULL;
+    }
+    return frame;
+  }
+  return NULL;
+}
+
+/**
+ * Check if a complete BGAPI frame is waiting in the receive buffer.
+ */
+static bool sli_bgapi_rx_frame_buffered(sli_bgapi_instance_t *inst)
+{
+  uint32_t header;
+  bgapi_device_type_queue_t *queue;
+
+  return sli_bgapi_rx_frame(inst, &header, &queue) != NULL;
+}
+
+/**
+ * Count an event dropped because the queue was full.
+ */
+static void sli_bgapi_count_drop(sli_bgapi_instance_t *inst, uint32_t header)
+{
+  sl_bt_api_queue_stats_t *stats = &inst->queue_stats;
+  uint32_t id = SL_BT_MSG_ID(header);
+  size_t i;
+
+  stats->dropped++;
+  for (i = 0; i < SL_BT_API_DROP_STATS_IDS; i++) {
+    if (stats->drops[i].id == id) {
+      stats->drops[i].count++;
+      return;
+    }
+    if (stats->drops[i].id == 0) {
+      stats->drops[i].id = id;
+      stats->drops[i].count = 1;
+      return;
+    }
+  }
+  stats->drops_other++;
+}
+
+/**
+ * Count an event put into the queue and track the fill level.
+ */
+static void sli_bgapi_count_queued(sli_bgapi_instance_t *inst, bgapi_device_type_queue_t *queue)
+{
+  uint32_t depth = (queue->write_offset + queue->len
+                    - sli_queue_load_sc(&queue->read_offset)) % queue->len;
+
+  inst->queue_stats.queued++;
+  if (depth > inst->queue_stats.max_depth) {
+    inst->queue_stats.max_depth = depth;
+  }
+}
+
+/**
+ * Make sure the slot at the write offset can be written, applying the
+ * overflow policy if the queue is full.
+ *
+ * Returns false if the received event has to be dropped.
+ */
+static bool sli_bgapi_queue_reserve(sli_bgapi_instance_t *inst, bgapi_device_type_queue_t *queue, uint32_t header)
+{
+  uint32_t read_offset = sli_queue_load_sc(&queue->read_offset);
+
+#if defined(POSIX) && POSIX == 1
+  if (sl_bt_overflow_policy == SL_BT_API_OVERFLOW_WAIT && sl_bt_rx_thread_running) {
+    struct timespec ts = { 0, SLI_BGAPI_QUEUE_WAIT_NS };
+    while ((queue->write_offset + 1) % queue->len == read_offset
+           && !__atomic_load_n(&inst->rsp_waiting, __ATOMIC_SEQ_CST)) {
+      // Cancellation point.
+      nanosleep(&ts, NULL);
+      read_offset = sli_queue_load_sc(&queue->read_offset);
+    }
+  }
+#endif // defined(POSIX) && POSIX == 1
+  if ((queue->write_offset + 1) % queue->len == read_offset) {
+    // Would write over the next item we'd due to read - queue full!
+    if ((sl_bt_overflow_policy == SL_BT_API_OVERFLOW_DROP_NEWEST)
+        || (sl_bt_overflow_policy == SL_BT_API_OVERFLOW_WAIT)
+        || ((sl_bt_overflow_policy == SL_BT_API_OVERFLOW_KEEP_BOOT)
+            && (SL_BT_MSG_ID(header) != sl_bt_evt_system_boot_id))) {
+      return false;
+    }
+    // Drop the oldest event unless the consumer is reading it right now. A
+    // borrowed slot is always the oldest one.
+    uint32_t borrowed = SLI_QUEUE_SLOT_NONE;
+    if (!sli_queue_cas(&queue->borrowed, &borrowed, SLI_QUEUE_SLOT_DROPPING)) {
+      return false;
+    }
+    // The consumer may have released an event before the claim.
+    read_offset = sli_queue_load_sc(&queue->read_offset);
+    if ((queue->write_offset + 1) % queue->len == read_offset) {
+      sli_bgapi_count_drop(inst, queue->buffer[read_offset].header);
+      sli_queue_store_sc(&queue->read_offset, (read_offset + 1) % queue->len);
+    }
+    sli_queue_store_sc(&queue->borrowed, SLI_QUEUE_SLOT_NONE);
+  }
+  return true;
+}
+
+/**
+ * Borrow the slot of the oldest event in a non-empty queue. The slot is
+ * neither dropped nor overwritten by the producer until it is released.
+ *
+ * Returns false if the producer dropped the event before it was borrowed, or
+ * is dropping it right now.
+ */
+static bool sli_bgapi_queue_borrow(bgapi_device_type_queue_t *queue, sl_bt_msg_t **event)
+{
+  uint32_t read_offset = sli_queue_load_sc(&queue->read_offset);
+  uint32_t borrowed = SLI_QUEUE_SLOT_NONE;
+
+  // Claim the slot first, then make sure it was not dropped before that. The
+  // claim fails while the producer is dropping the oldest event.
+  if (!sli_queue_cas(&queue->borrowed, &borrowed, read_offset)) {
+    return false;
+  }
+  if (sli_queue_load_sc(&queue->read_offset) != read_offset) {
+    sli_queue_store_sc(&queue->borrowed, SLI_QUEUE_SLOT_NONE);
+    return false;
+  }
+  *event = &queue->buffer[read_offset];
+  return true;
+}
+
+/**
+ * Release the borrowed slot, if any.
+ */
+static void sli_bgapi_queue_release(bgapi_device_type_queue_t *queue)
+{
+  uint32_t read_offset = sli_queue_load_sc(&queue->borrowed);
+
+  // Nothing borrowed, the producer may be dropping the oldest event.
+  if (read_offset == SLI_QUEUE_SLOT_NONE || read_offset == SLI_QUEUE_SLOT_DROPPING) {
+    return;
+  }
+  // Nudge the read offset forward by one message, or wrap around to
+  // beginning. The producer does not move it while the slot is borrowed.
+  sli_queue_store_sc(&queue->read_offset, (read_offset + 1) % queue->len);
+  sli_queue_store_sc(&queue->borrowed, SLI_QUEUE_SLOT_NONE);
+}
+
+#if defined(POSIX) && POSIX == 1
+/**
+ * Wake up the processing thread after an event has been queued.
+ */
+static void sli_bgapi_signal_event(void)
+{
+  uint8_t byte = 0;
+
+  if (!sl_bt_rx_thread_running) {
+    return;
+  }
+  // The flag only saves writes. A byte written after the processing thread
+  // cleared the flag is left in the pipe until the next clear drains it, so
+  // the pipe holds a few bytes at most and the write does not block.
+  if (!__atomic_exchange_n(&sl_bt_event_signaled, true, __ATOMIC_SEQ_CST)) {
+    (void)write(sl_bt_event_pipe[1], &byte, sizeof(byte));
+  }
+}
+
+/**
+ * Clear the wakeup signal before the processing thread goes to sleep.
+ *
+ * Returns true if a signal was pending. Events queued before the signal was
+ * raised are visible to the caller afterwards, so the queue has to be checked
+ * again in that case.
+ *
+ * The pipe is drained whatever the flag says: the receive thread sets the
+ * flag before it writes, so its byte may arrive after the flag was cleared.
+ * Left in the pipe, it would keep the event fd readable.
+ */
+static bool sli_bgapi_clear_event_signal(void)
+{
+  uint8_t bytes[16];
+  bool signaled;
+
+  signaled = __atomic_exchange_n(&sl_bt_event_signaled, false, __ATOMIC_SEQ_CST);
+  while (read(sl_bt_event_pipe[0], bytes, sizeof(bytes)) > 0) {
+    signaled = true;
+  }
+  return signaled;
+}
+#endif // defined(POSIX) && POSIX == 1
+
 /**
  * This function attempts to read a BGAPI event or response from the input data pipe.
  *
- * If there is no data, or a proper header cannot be recognized, returns NULL and
- * discards any read data.
+ * If no complete frame is buffered yet, the input function is called once to
+ * read whatever data is available. If there is still no complete frame, or a
+ * proper header cannot be recognized, returns NULL.
  *
  * If an event is found, it is put into the corresponding event queue, as indicated
  * by the registered event queue struct device type. Then NULL is returned.
@@ -120,71 +515,51 @@ sl_bt_msg_t* sli_wait_for_bgapi_message(sl_bt_msg_t *response_buffer)
 {
   uint32_t msg_length;
   uint32_t header;
-  uint8_t  *payload;
-  sl_bt_msg_t *packet_ptr, *retVal = NULL;
-  int      ret;
-  size_t i;
+  uint8_t  *frame;
+  sl_bt_msg_t *retVal = NULL;
   bgapi_device_type_queue_t *queue = NULL;
-  //sync to header byte
-  ret = sl_bt_api_input(1, (uint8_t*)&header);
-  if (ret < 0) {
-    return 0; // Failed to read header byte
-  }
-  for (i = 0; i < SL_BGAPI_DEVICE_TYPES; i++) {
-    if ((device_event_queues[i] != NULL)
-        && ((header & 0x78) == device_event_queues[i]->device_type)) {
-      queue = device_event_queues[i];
-      break;
+  sli_bgapi_instance_t *inst = sli_bgapi_current;
+
+  frame = sli_bgapi_rx_frame(inst, &header, &queue);
+  if (frame == NULL) {
+    if (sli_bgapi_rx_fill(inst) <= 0) {
+      return 0; // Failed to read or no data available
+    }
+    frame = sli_bgapi_rx_frame(inst, &header, &queue);
+    if (frame == NULL) {
+      return 0; // Frame is not complete yet
     }
-  }
-  if (queue == NULL) {
-    return 0; // Unrecognized device
-  }
-  ret = sl_bt_api_input(SL_BGAPI_MSG_HEADER_LEN - 1, &((uint8_t*)&header)[1]);
-  if (ret < 0) {
-    return 0;
   }
 
   msg_length = SL_BT_MSG_LEN(header);
-
-  if (msg_length > SL_BGAPI_MAX_PAYLOAD_SIZE) {
-    return 0;
-  }
+  // The frame is consumed from the receive buffer in any case.
+  inst->rx_head += SL_BGAPI_MSG_HEADER_LEN + msg_length;
+  inst->rx_stats.frames++;
 
   if ((header & 0xf8) == ( (uint32_t)(queue->device_type) | (uint32_t)sl_bgapi_msg_type_evt)) {
     //received event
-    if (((queue->write_offset + 1) % queue->len == queue->read_offset)) {
-      // Would write over the next item we'd due to read - queue full!
-      if (msg_length) {
-        // Discard payload if it exists
-        uint8_t discard_buf[SL_BGAPI_MAX_PAYLOAD_SIZE];
-        sl_bt_api_input(msg_length, discard_buf);
-      }
+    if (!sli_bgapi_queue_reserve(inst, queue, header)) {
+      sli_bgapi_count_drop(inst, header);
       return 0;
     }
-    packet_ptr = &queue->buffer[queue->write_offset];
-    // Move write offset to next slot or wrap around to beginning.
-    queue->write_offset = (queue->write_offset + 1) % queue->len;
+    // Copy the frame out of the receive buffer, then move write offset to next
+    // slot or wrap around to beginning to publish it.
+    memcpy(&queue->buffer[queue->write_offset], frame, SL_BGAPI_MSG_HEADER_LEN + msg_length);
+    sli_queue_store(&queue->write_offset, (queue->write_offset + 1) % queue->len);
+    sli_bgapi_count_queued(inst, queue);
+#if defined(POSIX) && POSIX == 1
+    sli_bgapi_signal_event();
+#endif // defined(POSIX) && POSIX == 1
   } else if ((header & 0xf8) == queue->device_type) {//response
     // Note that in the case of a response we don't need to split it into two buffer types,
     // because we can't have multiple pending commands and responses in parallel.
     // Whoever sent the last command will wait for the response.
-    retVal = packet_ptr = response_buffer;
+    retVal = response_buffer;
+    memcpy(response_buffer, frame, SL_BGAPI_MSG_HEADER_LEN + msg_length);
   } else {
     //fail
     return 0;
   }
-  packet_ptr->header = header;
-  payload = (uint8_t*)&packet_ptr->data.payload;
-  /**
-   * Read the payload data if required and store it after the header.
-   */
-  if (msg_length) {
-    ret = sl_bt_api_input(msg_length, payload);
-    if (ret < 0) {
-      return 0;
-    }
-  }
 
   // Using retVal avoid double handling of event msg types in outer function.
   // If retVal is non-null we got a response packet. If null, an event was placed
@@ -192,23 +567,137 @@ sl_bt_msg_t* sli_wait_for_bgapi_message(sl_bt_msg_t *response_buffer)
   return retVal;
 }
 
-bool sl_bt_event_pending(void)
+/**
+ * Check if a complete frame is buffered or something is waiting in the input
+ * data pipe. Without a peek function the input is assumed to be available.
+ */
+static bool sli_bgapi_input_available(sli_bgapi_instance_t *inst)
 {
-  if (sli_bgapi_device_queue_has_events(&sl_bt_api_queue)) {//event is waiting in queue
+  if (sli_bgapi_rx_frame_buffered(inst)) {
     return true;
   }
+  if (sl_bt_api_peek) {
+    sli_bgapi_instance_t *current = sli_bgapi_current;
+    bool available;
+
+    // The peek function looks at the input of the selected instance.
+    inst->rx_stats.peeks++;
+    sli_bgapi_current = inst;
+    available = sl_bt_api_peek() != 0;
+    sli_bgapi_current = current;
+    return available;
+  }
+  return true;
+}
+
+void sl_bt_api_get_rx_stats(sl_bt_api_rx_stats_t *stats)
+{
+  *stats = sli_bgapi_current->rx_stats;
+}
+
+sl_status_t sl_bt_api_set_queue_depth(uint32_t depth)
+{
+  if (depth == 0) {
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  if (sli_bgapi_instance_count > 0) {
+    return SL_STATUS_INVALID_STATE;
+  }
+  sl_bt_queue_depth = depth;
+  return SL_STATUS_OK;
+}
+
+void sl_bt_api_set_overflow_policy(sl_bt_api_overflow_policy_t policy)
+{
+  sl_bt_overflow_policy = policy;
+}
+
+void sl_bt_api_get_queue_stats(sl_bt_api_queue_stats_t *stats)
+{
+  *stats = sli_bgapi_current->queue_stats;
+  stats->depth = sli_bgapi_current->bt_queue.len - 1;
+}
+
+/**
+ * Get the number of events in an event queue.
+ */
+static uint32_t sli_bgapi_queue_level(bgapi_device_type_queue_t *queue)
+{
+  uint32_t write_offset = sli_queue_load(&queue->write_offset);
+  uint32_t read_offset = sli_queue_load(&queue->read_offset);
+
+  return (write_offset + queue->len - read_offset) % queue->len;
+}
+
+uint32_t sl_bt_api_get_queue_level(void)
+{
+  return sli_bgapi_queue_level(&sli_bgapi_current->bt_queue);
+}
+
+uint32_t sl_bt_api_get_max_queue_level(void)
+{
+  uint32_t level;
+  uint32_t max_level = 0;
+  uint8_t i;
+
+  for (i = 0; i < sli_bgapi_instance_count; i++) {
+    level = sli_bgapi_queue_level(&sli_bgapi_instances[i].bt_queue);
+    if (level > max_level) {
+      max_level = level;
+    }
+  }
+  return max_level;
+}
 
-  //something in uart waiting to be read
-  if (sl_bt_api_peek && sl_bt_api_peek()) {
+/**
+ * Check if any instance has events in its Bluetooth event queue.
+ */
+static bool sli_bgapi_any_events_queued(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < sli_bgapi_instance_count; i++) {
+    if (sli_bgapi_device_queue_has_events(&sli_bgapi_instances[i].bt_queue)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool sl_bt_event_pending(void)
+{
+  uint8_t i;
+
+  if (sli_bgapi_any_events_queued()) {//event is waiting in queue
     return true;
   }
 
+#if defined(POSIX) && POSIX == 1
+  if (sl_bt_rx_thread_running) {
+    // Nothing is queued, so the caller is about to sleep on the event fd.
+    // Rearm the wakeup first and check the queues again.
+    if (sli_bgapi_clear_event_signal()) {
+      return sli_bgapi_any_events_queued();
+    }
+    return false;
+  }
+#endif // defined(POSIX) && POSIX == 1
+
+  //complete frame buffered or something in uart waiting to be read
+  for (i = 0; i < sli_bgapi_instance_count; i++) {
+    if (sl_bt_api_peek ? sli_bgapi_input_available(&sli_bgapi_instances[i])
+        : sli_bgapi_rx_frame_buffered(&sli_bgapi_instances[i])) {
+      return true;
+    }
+  }
+
   return false;
 }
 
 /**
- * Attempts to get an event that is already in the event queue, or an
- * event or response from the input pipe.
+ * Attempts to borrow an event that is already in the event queue, or an
+ * event or response from the input pipe. The event stays in its queue slot
+ * until sli_bgapi_release_event is called.
  *
  * If BGAPI was initialized in blocking mode, this function will block
  * until a valid event or response is found.
@@ -217,46 +706,111 @@ bool sl_bt_event_pending(void)
  * type that was expected is found. It will return SL_STATUS_BUSY in that case.
  * Otherwise we would be stuck until the event type we checked for arrives.
  **/
-sl_status_t sli_bgapi_get_event(int block, sl_bt_msg_t *event, bgapi_device_type_queue_t *device_queue)
+sl_status_t sli_bgapi_borrow_event(int block, sl_bt_msg_t **event, bgapi_device_type_queue_t *device_queue)
 {
   sl_bt_msg_t *rsp;
   while (1) {
     // First check if we already have events waiting for us.
     if (sli_bgapi_device_queue_has_events(device_queue)) {
-      // Copy event from queue to event parameter, then nudge the read offset forward
-      // by one message, or wrap around to beginning.
-      memcpy(event, &device_queue->buffer[device_queue->read_offset], sizeof(sl_bt_msg_t));
-      device_queue->read_offset = (device_queue->read_offset + 1) % device_queue->len;
-      return SL_STATUS_OK;
+      // Hand out the queue slot of the event.
+      if (sli_bgapi_queue_borrow(device_queue, event)) {
+        return SL_STATUS_OK;
+      }
+      continue;
     } else if (sli_bgapi_other_events_in_queue(device_queue->device_type)) {
       // If some other device type has messages, we need to yield here in order to let the
       // events be processed.
       return SL_STATUS_BUSY;
     }
 
-    //if not blocking and nothing in uart -> out
-    if (!block && sl_bt_api_peek && sl_bt_api_peek() == 0) {
+#if defined(POSIX) && POSIX == 1
+    if (sl_bt_rx_thread_running) {
+      // The receive thread fills the queue, rearm the wakeup and check again.
+      if (sli_bgapi_clear_event_signal()) {
+        continue;
+      }
+      if (!block) {
+        return SL_STATUS_WOULD_BLOCK;
+      }
+      struct pollfd pfd = { sl_bt_event_pipe[0], POLLIN, 0 };
+      (void)poll(&pfd, 1, -1);
+      continue;
+    }
+#endif // defined(POSIX) && POSIX == 1
+
+    //if not blocking and nothing buffered or in uart -> out
+    if (!block && !sli_bgapi_input_available(sli_bgapi_current)) {
       return SL_STATUS_WOULD_BLOCK;
     }
 
     //read more messages from device
     if ( (rsp = sli_wait_for_bgapi_message(sl_bt_rsp_msg)) ) {
-      // Note that we copy the event to the event pointer here only if it is a response.
+      // Note that we hand out the response buffer here only if it is a response.
       // Regular events are handled in the above blocks.
-      memcpy(event, rsp, sizeof(sl_bt_msg_t));
+      *event = rsp;
       return SL_STATUS_OK;
     }
   }
 }
 
+void sli_bgapi_release_event(bgapi_device_type_queue_t *device_queue)
+{
+  sli_bgapi_queue_release(device_queue);
+}
+
+sl_status_t sli_bgapi_get_event(int block, sl_bt_msg_t *event, bgapi_device_type_queue_t *device_queue)
+{
+  sl_bt_msg_t *msg;
+  sl_status_t sc;
+
+  sc = sli_bgapi_borrow_event(block, &msg, device_queue);
+  if (sc == SL_STATUS_OK) {
+    memcpy(event, msg, SL_BGAPI_MSG_HEADER_LEN + SL_BT_MSG_LEN(msg->header));
+    sli_bgapi_release_event(device_queue);
+  }
+  return sc;
+}
+
 sl_status_t sl_bt_wait_event(sl_bt_msg_t* event)
 {
-  return sli_bgapi_get_event(1, event, &sl_bt_api_queue);
+  return sli_bgapi_get_event(1, event, &sli_bgapi_current->bt_queue);
 }
 
 sl_status_t sl_bt_pop_event(sl_bt_msg_t* event)
 {
-  return sli_bgapi_get_event(0, event, &sl_bt_api_queue);
+  sl_bt_msg_t *msg;
+  sl_status_t sc;
+
+  sc = sl_bt_borrow_event(&msg);
+  if (sc == SL_STATUS_OK) {
+    memcpy(event, msg, SL_BGAPI_MSG_HEADER_LEN + SL_BT_MSG_LEN(msg->header));
+    sl_bt_release_event();
+  }
+  return sc;
+}
+
+sl_status_t sl_bt_borrow_event(sl_bt_msg_t** event)
+{
+  sl_status_t sc = SL_STATUS_WOULD_BLOCK;
+  uint8_t i, instance;
+
+  // Take turns between the instances, and select the instance of the event
+  // so that the commands sent by the event handler go to the right NCP.
+  for (i = 0; i < sli_bgapi_instance_count; i++) {
+    instance = (sli_bgapi_next_instance + i) % sli_bgapi_instance_count;
+    sl_bt_api_select_instance(instance);
+    sc = sli_bgapi_borrow_event(0, event, &sli_bgapi_current->bt_queue);
+    if (sc != SL_STATUS_WOULD_BLOCK) {
+      sli_bgapi_next_instance = (instance + 1) % sli_bgapi_instance_count;
+      break;
+    }
+  }
+  return sc;
+}
+
+void sl_bt_release_event(void)
+{
+  sli_bgapi_release_event(&sli_bgapi_current->bt_queue);
 }
 
 /**
@@ -267,6 +821,23 @@ sl_status_t sl_bt_pop_event(sl_bt_msg_t* event)
 sl_bt_msg_t* sl_bt_wait_response(void)
 {
   sl_bt_msg_t* rsp;
+
+#if defined(POSIX) && POSIX == 1
+  sli_bgapi_instance_t *inst = sli_bgapi_current;
+
+  if (sl_bt_rx_thread_running) {
+    pthread_mutex_lock(&inst->rsp_mutex);
+    __atomic_store_n(&inst->rsp_waiting, true, __ATOMIC_SEQ_CST);
+    while (!inst->rsp_ready) {
+      pthread_cond_wait(&inst->rsp_cond, &inst->rsp_mutex);
+    }
+    __atomic_store_n(&inst->rsp_waiting, false, __ATOMIC_SEQ_CST);
+    inst->rsp_ready = false;
+    pthread_mutex_unlock(&inst->rsp_mutex);
+    return &inst->rsp_msg;
+  }
+#endif // defined(POSIX) && POSIX == 1
+
   while (1) {
     rsp = sli_wait_for_bgapi_message(sl_bt_rsp_msg); // Will return a valid pointer only if we got a response.
     if (rsp) {
@@ -287,3 +858,98 @@ void sl_bt_host_handle_command_noresponse()
   //packet in sl_bt_cmd_msg is waiting for output
   sl_bt_api_output(SL_BGAPI_MSG_HEADER_LEN + SL_BT_MSG_LEN(sl_bt_cmd_msg->header), (uint8_t*)sl_bt_cmd_msg);
 }
+
+#if defined(POSIX) && POSIX == 1
+/**
+ * Receive thread body. Frames the input of one instance into its event queues
+ * and hands the responses over to sl_bt_wait_response.
+ */
+static void* sli_bgapi_rx_thread(void *arg)
+{
+  sli_bgapi_instance_t *inst = arg;
+  sl_bt_msg_t *rsp;
+
+  sli_bgapi_current = inst;
+  while (1) {
+    // The input function is a cancellation point when it blocks.
+    rsp = sli_wait_for_bgapi_message(&inst->rx_thread_rsp);
+    if (rsp != NULL) {
+      pthread_mutex_lock(&inst->rsp_mutex);
+      memcpy(&inst->rsp_msg, rsp, SL_BGAPI_MSG_HEADER_LEN + SL_BT_MSG_LEN(rsp->header));
+      inst->rsp_ready = true;
+      pthread_cond_signal(&inst->rsp_cond);
+      pthread_mutex_unlock(&inst->rsp_mutex);
+    }
+  }
+  return NULL;
+}
+
+sl_status_t sl_bt_api_start_rx_thread(void)
+{
+  sigset_t all, old;
+  uint8_t i;
+  int rc = 0;
+
+  if (sl_bt_rx_thread_running) {
+    return SL_STATUS_ALREADY_INITIALIZED;
+  }
+  if (pipe(sl_bt_event_pipe) < 0) {
+    return SL_STATUS_FAIL;
+  }
+  fcntl(sl_bt_event_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(sl_bt_event_pipe[1], F_SETFL, O_NONBLOCK);
+  sl_bt_event_signaled = false;
+  sl_bt_rx_thread_running = true;
+
+  // Signals are left to the processing thread, so that they interrupt its
+  // wait instead of the input function.
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for (i = 0; i < sli_bgapi_instance_count && rc == 0; i++) {
+    sli_bgapi_instances[i].rsp_ready = false;
+    rc = pthread_create(&sli_bgapi_instances[i].rx_thread, NULL,
+                        sli_bgapi_rx_thread, &sli_bgapi_instances[i]);
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (rc != 0) {
+    // Stop the threads that were started.
+    while (--i > 0) {
+      pthread_cancel(sli_bgapi_instances[i - 1].rx_thread);
+      pthread_join(sli_bgapi_instances[i - 1].rx_thread, NULL);
+    }
+    sl_bt_rx_thread_running = false;
+    close(sl_bt_event_pipe[0]);
+    close(sl_bt_event_pipe[1]);
+    sl_bt_event_pipe[0] = -1;
+    sl_bt_event_pipe[1] = -1;
+    return SL_STATUS_FAIL;
+  }
+  return SL_STATUS_OK;
+}
+
+void sl_bt_api_stop_rx_thread(void)
+{
+  uint8_t i;
+
+  if (!sl_bt_rx_thread_running) {
+    return;
+  }
+  for (i = 0; i < sli_bgapi_instance_count; i++) {
+    pthread_cancel(sli_bgapi_instances[i].rx_thread);
+  }
+  for (i = 0; i < sli_bgapi_instance_count; i++) {
+    pthread_join(sli_bgapi_instances[i].rx_thread, NULL);
+  }
+  sl_bt_rx_thread_running = false;
+  close(sl_bt_event_pipe[0]);
+  close(sl_bt_event_pipe[1]);
+  sl_bt_event_pipe[0] = -1;
+  sl_bt_event_pipe[1] = -1;
+}
+
+int sl_bt_api_get_event_fd(void)
+{
+  return sl_bt_event_pipe[0];
+}
+#endif // defined(POSIX) && POSIX == 1
@@ -28,6 +28,16 @@
  *  any events are received during response waiting, they are queued and
  *  delivered next time sl_bt_wait_event is called.
  *
+ *  On POSIX systems the input can be read by a dedicated receive thread, see
+ *  sl_bt_api_start_rx_thread. The event queue is then filled by that thread
+ *  and emptied by the application thread without locking.
+ *
+ *  Several NCPs can be driven at the same time. Each initialization adds an
+ *  instance with its own event queue and selects it. Commands go to the
+ *  selected instance, and sl_bt_pop_event selects the instance of the event
+ *  it returns. The input and output functions find out which connection to
+ *  use from sl_bt_api_get_instance.
+ *
  *  Queue length is controlled by defining macro "SL_BT_API_QUEUE_LEN", default is 30.
  *  Queue length depends on use cases and allowed host memory usage.
  *
@@ -41,7 +51,8 @@
  *
  *      Declare and define input function, prototype is:
  *          void my_input(uint16_t len,uint8_t* data);
- *          Function reads "len" amount of data to pointer "data" from device.
+ *          Function reads at most "len" amount of data to pointer "data" from
+ *          device, returning as soon as any data is available.
  *          Function return nonzero if it failed.
  *
  *      Initialize library,and provide output and input function:
@@ -92,6 +103,28 @@
 #define SL_BT_API_QUEUE_LEN 30
 #endif
 
+/**
+ * Maximum number of NCP connections, see sl_bt_api_select_instance.
+ */
+#ifndef SL_BT_API_MAX_INSTANCES
+#define SL_BT_API_MAX_INSTANCES 4
+#endif
+
+/**
+ * Number of distinct event IDs that drops are counted for.
+ */
+#ifndef SL_BT_API_DROP_STATS_IDS
+#define SL_BT_API_DROP_STATS_IDS 16
+#endif
+
+/**
+ * Size of the receive buffer that input data is read into. It has to hold at
+ * least two maximum size messages.
+ */
+#ifndef SL_BT_API_RX_BUFFER_SIZE
+#define SL_BT_API_RX_BUFFER_SIZE 4096
+#endif
+
 /**
  * Structure defining a device type and the event queue where events of that
  * type should be stored.
@@ -102,14 +135,30 @@ typedef struct {
   uint32_t read_offset; /*< Pointer to the protocol consumer's write offset counter */
   sl_bt_msg_t *buffer; /*< Pointer to the protocol consumer's event queue buffer */
   uint32_t len; /*< Number of events possible to store in the queue */
+  uint32_t borrowed; /*< Slot being read by the consumer, UINT32_MAX if none, UINT32_MAX - 1 while the producer drops */
 } bgapi_device_type_queue_t;
 
-extern bgapi_device_type_queue_t sl_bt_api_queue;
+/**
+ * What to do with an event that does not fit into the full event queue.
+ * Responses are not queued, so they are never dropped.
+ *
+ * Only a receive thread can wait for room in the queue. Without one, or while
+ * the application waits for a response, SL_BT_API_OVERFLOW_WAIT drops the
+ * received event.
+ */
+typedef enum {
+  SL_BT_API_OVERFLOW_DROP_NEWEST = 0, /*< Drop the received event */
+  SL_BT_API_OVERFLOW_DROP_OLDEST, /*< Drop the oldest queued event */
+  SL_BT_API_OVERFLOW_KEEP_BOOT, /*< Drop the received event unless it is a boot event */
+  SL_BT_API_OVERFLOW_WAIT /*< Stop reading until the application makes room */
+} sl_bt_api_overflow_policy_t;
 
 sl_status_t sli_bgapi_register_device(bgapi_device_type_queue_t *queue);
 bool sli_bgapi_device_queue_has_events(bgapi_device_type_queue_t *device_queue);
 bool sli_bgapi_other_events_in_queue(enum sl_bgapi_dev_types my_device_type);
 sl_status_t sli_bgapi_get_event(int block, sl_bt_msg_t *event, bgapi_device_type_queue_t *device_queue);
+sl_status_t sli_bgapi_borrow_event(int block, sl_bt_msg_t **event, bgapi_device_type_queue_t *device_queue);
+void sli_bgapi_release_event(bgapi_device_type_queue_t *device_queue);
 
 /**
  * Function that sends a message to the serial port.
@@ -122,7 +171,11 @@ typedef void(*tx_func)(uint32_t msg_len, uint8_t* msg_data);
 /**
  *  @brief Function that reads data from serial port.
  *
- *  @param[in]  dataLength The amount of bytes to read.
+ *  The function should return as soon as any data is available, reading at
+ *  most dataLength bytes. Returning 0 is allowed if no data arrived within
+ *  the blocking time interval of the port.
+ *
+ *  @param[in]  dataLength The maximum amount of bytes to read.
  *  @param[out] data Buffer used for storing the data.
  *  @return  The amount of bytes read or -1 on failure.
  */
@@ -135,7 +188,34 @@ typedef int32_t(*rx_func)(uint32_t dataLength, uint8_t* data);
 typedef int32_t(*rx_peek_func)(void);
 
 /**
- * Initialize NCP host Bluetooth API.
+ * Receive path statistics.
+ */
+typedef struct {
+  uint32_t frames; /*< Number of BGAPI frames parsed from the input */
+  uint32_t reads; /*< Number of calls to the input function */
+  uint32_t peeks; /*< Number of calls to the peek function */
+  uint32_t discarded; /*< Number of bytes dropped to resynchronize */
+  uint64_t bytes; /*< Number of bytes received */
+} sl_bt_api_rx_stats_t;
+
+/**
+ * Event queue statistics.
+ */
+typedef struct {
+  uint32_t depth; /*< Number of events the queue can hold */
+  uint32_t max_depth; /*< Highest number of events queued at the same time */
+  uint32_t queued; /*< Number of events put into the queue */
+  uint32_t dropped; /*< Number of events dropped because the queue was full */
+  struct {
+    uint32_t id; /*< Event ID, zero for unused entries */
+    uint32_t count; /*< Number of dropped events with this ID */
+  } drops[SL_BT_API_DROP_STATS_IDS];
+  uint32_t drops_other; /*< Dropped events whose ID did not fit into drops */
+} sl_bt_api_queue_stats_t;
+
+/**
+ * Initialize NCP host Bluetooth API. Every call adds a new instance and
+ * selects it. All instances share the same functions.
  *
  * @param ofunc The function for sending api messages
  * @param ifunc The function for receiving api messages
@@ -144,7 +224,8 @@ typedef int32_t(*rx_peek_func)(void);
 sl_status_t sl_bt_api_initialize(tx_func ofunc, rx_func ifunc);
 
 /**
- * Initialize NCP host Bluetooth API.
+ * Initialize NCP host Bluetooth API. Every call adds a new instance and
+ * selects it. All instances share the same functions.
  *
  * @param ofunc The function for sending api messages
  * @param ifunc The function for receiving api messages
@@ -153,6 +234,29 @@ sl_status_t sl_bt_api_initialize(tx_func ofunc, rx_func ifunc);
  */
 sl_status_t sl_bt_api_initialize_nonblock(tx_func ofunc, rx_func ifunc, rx_peek_func pfunc);
 
+/**
+ * Get the number of instances.
+ *
+ * @return Number of initialized instances
+ */
+uint8_t sl_bt_api_get_instance_count(void);
+
+/**
+ * Select the instance that the following commands are sent to.
+ *
+ * @param instance Index of the instance in initialization order
+ * @return Status code
+ */
+sl_status_t sl_bt_api_select_instance(uint8_t instance);
+
+/**
+ * Get the selected instance. In the input function called by a receive
+ * thread, this is the instance of that thread.
+ *
+ * @return Index of the instance
+ */
+uint8_t sl_bt_api_get_instance(void);
+
 extern void(*sl_bt_api_output)(uint32_t len1, uint8_t* data1);
 extern int32_t (*sl_bt_api_input)(uint32_t len1, uint8_t* data1);
 extern int32_t(*sl_bt_api_peek)(void);
@@ -160,6 +264,98 @@ void sl_bt_host_handle_command();
 void sl_bt_host_handle_command_noresponse();
 sl_status_t sl_bt_wait_event(sl_bt_msg_t *p);
 
+/**
+ * Get the next event without copying it out of the event queue. The
+ * instance of the event is selected.
+ *
+ * The event stays valid until sl_bt_release_event is called, which has to
+ * happen before the next event is borrowed or popped. Commands may be sent
+ * while an event is borrowed.
+ *
+ * @param[out] event Pointer to the event in the queue
+ * @return SL_STATUS_OK if an event was found, SL_STATUS_WOULD_BLOCK otherwise
+ */
+sl_status_t sl_bt_borrow_event(sl_bt_msg_t **event);
+
+/**
+ * Give the slot of the borrowed event back to the event queue.
+ */
+void sl_bt_release_event(void);
+
 sl_bt_msg_t* sli_wait_for_bgapi_message(sl_bt_msg_t *response_buf);
 
+/**
+ * Get the receive path statistics of the selected instance.
+ *
+ * @param[out] stats Statistics counters
+ */
+void sl_bt_api_get_rx_stats(sl_bt_api_rx_stats_t *stats);
+
+/**
+ * Set the number of events the event queue of each instance can hold. Must
+ * be called before the API is initialized.
+ *
+ * @param depth Number of events, SL_BT_API_QUEUE_LEN - 1 by default
+ * @return Status code
+ */
+sl_status_t sl_bt_api_set_queue_depth(uint32_t depth);
+
+/**
+ * Set what to do when an event is received while the event queue is full.
+ *
+ * @param policy Overflow policy, SL_BT_API_OVERFLOW_DROP_NEWEST by default
+ */
+void sl_bt_api_set_overflow_policy(sl_bt_api_overflow_policy_t policy);
+
+/**
+ * Get the event queue statistics of the selected instance. The counters are
+ * updated by the receiving thread, so they are approximate while it is
+ * running.
+ *
+ * @param[out] stats Statistics counters
+ */
+void sl_bt_api_get_queue_stats(sl_bt_api_queue_stats_t *stats);
+
+/**
+ * Get the number of events in the event queue of the selected instance.
+ *
+ * @return Number of queued events
+ */
+uint32_t sl_bt_api_get_queue_level(void);
+
+/**
+ * Get the number of events in the fullest event queue of all instances.
+ *
+ * @return Number of queued events
+ */
+uint32_t sl_bt_api_get_max_queue_level(void);
+
+#if defined(POSIX) && POSIX == 1
+/**
+ * Start reading the input of each instance in a dedicated thread.
+ *
+ * The threads frame the input and put the events into the event queues, so
+ * that the input is drained even while the application is busy processing
+ * earlier events. Responses are handed over to the thread that issued the
+ * command. The instances have to be initialized in blocking mode before.
+ *
+ * @return Status code
+ */
+sl_status_t sl_bt_api_start_rx_thread(void);
+
+/**
+ * Stop the receive threads. Must be called before the inputs are closed.
+ */
+void sl_bt_api_stop_rx_thread(void);
+
+/**
+ * Get the file descriptor that becomes readable when a receive thread has
+ * queued events. It is reset by sl_bt_event_pending and sl_bt_borrow_event when
+ * they find the queue empty.
+ *
+ * @return File descriptor or -1 if the receive thread is not running
+ */
+int sl_bt_api_get_event_fd(void);
+#endif // defined(POSIX) && POSIX == 1
+
 #endif
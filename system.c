@@ -37,6 +37,10 @@
 static void sl_bt_init(void);
 static void sl_bt_step(void);
 
+// Maximum number of events dispatched per step.
+static uint32_t sl_bt_event_budget = SL_SYSTEM_EVENT_BUDGET_DEFAULT;
+static sl_system_dispatch_stats_t sl_bt_dispatch_stats;
+
 #ifdef BTMESH
 extern void sl_btmesh_init(void);
 extern void sl_btmesh_step(void);
@@ -70,15 +74,55 @@ static void sl_bt_init(void)
   // nothing to do
 }
 
-// Poll Bluetooth stack for an event and call event handler
-static void sl_bt_step(void)
+void sl_system_set_event_budget(uint32_t budget)
 {
-  sl_bt_msg_t evt;
+  sl_bt_event_budget = (budget > 0) ? budget : 1;
+}
 
-  // Pop (non-blocking) a Bluetooth stack event from event queue.
-  sl_status_t status = sl_bt_pop_event(&evt);
-  if (status != SL_STATUS_OK) {
+void sl_system_get_dispatch_stats(sl_system_dispatch_stats_t *stats)
+{
+  *stats = sl_bt_dispatch_stats;
+}
+
+// Record the number of events dispatched in one step
+static void sl_bt_count_batch(uint32_t count)
+{
+  uint32_t bin = 0;
+
+  sl_bt_dispatch_stats.passes++;
+  if (count == 0) {
+    sl_bt_dispatch_stats.empty++;
     return;
   }
-  sl_bt_on_event(&evt);
+  sl_bt_dispatch_stats.events += count;
+  if (count > sl_bt_dispatch_stats.max_batch) {
+    sl_bt_dispatch_stats.max_batch = count;
+  }
+  if (count == sl_bt_event_budget) {
+    sl_bt_dispatch_stats.budget_hits++;
+  }
+  while ((count >>= 1) != 0 && bin < SL_SYSTEM_BATCH_HIST_BINS - 1) {
+    bin++;
+  }
+  sl_bt_dispatch_stats.histogram[bin]++;
+}
+
+// Poll Bluetooth stack for events and call event handler for each of them
+static void sl_bt_step(void)
+{
+  sl_bt_msg_t *evt;
+  uint32_t count = 0;
+
+  // Borrow (non-blocking) Bluetooth stack events from the event queues until
+  // they are empty or the budget is used up. Each event is handled in place
+  // and its slot is given back before the next one is borrowed.
+  while (count < sl_bt_event_budget) {
+    if (sl_bt_borrow_event(&evt) != SL_STATUS_OK) {
+      break;
+    }
+    sl_bt_on_event(evt);
+    sl_bt_release_event();
+    count++;
+  }
+  sl_bt_count_batch(count);
 }
@@ -30,15 +30,52 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include <stdint.h>
 #include "sl_bt_api.h"
 
 /** @brief A macro for defining a weak symbol. */
 #define SL_WEAK __attribute__ ((weak))
 
+/** @brief Default number of events dispatched per sl_system_process_action. */
+#define SL_SYSTEM_EVENT_BUDGET_DEFAULT  32
+
+/** @brief Number of batch size histogram bins. Bin k counts batches of
+ *  2^k to 2^(k+1)-1 events, the last bin also counts larger batches. */
+#define SL_SYSTEM_BATCH_HIST_BINS       8
+
+/** @brief Event dispatch statistics. */
+typedef struct {
+  uint32_t passes;        ///< Calls to sl_system_process_action
+  uint32_t empty;         ///< Passes that found no event
+  uint64_t events;        ///< Events dispatched
+  uint32_t max_batch;     ///< Largest number of events in one pass
+  uint32_t budget_hits;   ///< Passes that stopped at the budget
+  uint32_t histogram[SL_SYSTEM_BATCH_HIST_BINS]; ///< Batch sizes, see above
+} sl_system_dispatch_stats_t;
+
 // TODO: remove if system takes care of generating this under autogen directory
 void sl_system_init(void);
 void sl_system_process_action(void);
 
 void sl_bt_on_event(sl_bt_msg_t *evt);
 
+/**************************************************************************//**
+ * Set how many events are dispatched at most per sl_system_process_action.
+ *
+ * Every event that is already received is handed to sl_bt_on_event back to
+ * back until none is left or the budget is used up. The budget bounds the
+ * time spent in one pass so that the rest of the main loop is not starved.
+ *
+ * @param[in] budget Maximum number of events per pass, 1 dispatches a single
+ *                   event per pass. 0 is treated as 1.
+ *****************************************************************************/
+void sl_system_set_event_budget(uint32_t budget);
+
+/**************************************************************************//**
+ * Get event dispatch statistics.
+ *
+ * @param[out] stats Statistics collected since start.
+ *****************************************************************************/
+void sl_system_get_dispatch_stats(sl_system_dispatch_stats_t *stats);
+
 #endif // SYSTEM_H
@@ -35,6 +35,15 @@
 
 #define DEFAULT_BUFLEN 512
 
+// Buffer of a gathered write.
+typedef struct {
+  uint8_t *data;
+  uint32_t len;
+} tcp_buf_t;
+
+// Maximum number of buffers in one datagram, see udp_txv.
+#define UDP_TXV_MAX_BUFS 64
+
 /**************************************************************************//**
  * Open a TCP communication through socket.
  * @param[out]  handle Socket handle
@@ -44,6 +53,37 @@
  *****************************************************************************/
 int32_t tcp_open(void *handle, char *ip, char *port);
 
+/**************************************************************************//**
+ * Start opening a non-blocking TCP connection through socket. The function
+ *          does not wait for the connection to be established.
+ * @param[out]  handle Socket handle
+ * @param[in]  ip IPv4 address.
+ * @param[in]  port Port to use.
+ * @return  0 if connected, 1 if the connection is in progress, see
+ *          tcp_connect_finish, or -1 on failure. No socket is left open on
+ *          failure.
+ *****************************************************************************/
+int32_t tcp_connect_start(void *handle, char *ip, char *port);
+
+/**************************************************************************//**
+ * Start opening a non-blocking connection to a local (Unix domain) stream
+ *          socket. The connection is used like a TCP connection.
+ * @param[out]  handle Socket handle
+ * @param[in]  path Path of the socket.
+ * @return  0 if connected, 1 if the connection is in progress, see
+ *          tcp_connect_finish, or -1 on failure or if not supported.
+ *****************************************************************************/
+int32_t tcp_connect_start_local(void *handle, char *path);
+
+/**************************************************************************//**
+ * Check whether a connection started with tcp_connect_start is established.
+ *          The function does not block.
+ * @param[in]  handle Socket handle
+ * @return  0 if connected, 1 if still in progress or -1 on failure. The
+ *          socket has to be closed on failure.
+ *****************************************************************************/
+int32_t tcp_connect_finish(void *handle);
+
 /**************************************************************************//**
  * Send data to device through TCP. The function will block until
  *          the desired amount has been written or an error occurs.
@@ -54,6 +94,45 @@ int32_t tcp_open(void *handle, char *ip, char *port);
  *****************************************************************************/
 int32_t tcp_tx(void *handle, uint32_t data_length, uint8_t *data);
 
+/**************************************************************************//**
+ * Send the contents of several buffers to device through TCP with as few
+ *          system calls as possible. On a blocking socket the function will
+ *          block until all the buffers have been written or an error occurs.
+ *          On a non-blocking socket it writes what fits in the send buffer.
+ * @param[in]  handle Socket handle
+ * @param[in]  bufs Buffers to write, in order.
+ * @param[in]  count The number of buffers.
+ * @return  The amount of bytes written or -1 on failure.
+ *****************************************************************************/
+int32_t tcp_txv(void *handle, tcp_buf_t *bufs, uint32_t count);
+
+/**************************************************************************//**
+ * Make the socket non-blocking. Writes return at once with what fits in the
+ *          send buffer.
+ * @param[in]  handle Socket handle
+ * @return  0 on success, -1 on failure.
+ *****************************************************************************/
+int32_t tcp_set_nonblocking(void *handle);
+
+/**************************************************************************//**
+ * Open a non-blocking UDP socket that sends to the given address.
+ * @param[out]  handle Socket handle
+ * @param[in]  ip IPv4 address.
+ * @param[in]  port Port to use.
+ * @return  0 on success, -1 on failure. Close the socket with tcp_close.
+ *****************************************************************************/
+int32_t udp_open(void *handle, char *ip, char *port);
+
+/**************************************************************************//**
+ * Send the contents of several buffers as one UDP datagram.
+ * @param[in]  handle Socket handle
+ * @param[in]  bufs Buffers to send, in order.
+ * @param[in]  count The number of buffers.
+ * @return  The size of the datagram, 0 if the send buffer is full or -1 on
+ *          failure. A datagram refused by the destination counts as sent.
+ *****************************************************************************/
+int32_t udp_txv(void *handle, tcp_buf_t *bufs, uint32_t count);
+
 /**************************************************************************//**
  * Blocking read data from device through TCP. The function will block until
  *          the desired amount has been read or an error occurs.
@@ -64,6 +143,16 @@ int32_t tcp_tx(void *handle, uint32_t data_length, uint8_t *data);
  *****************************************************************************/
 int32_t tcp_rx(void *handle, uint32_t data_length, uint8_t *data);
 
+/**************************************************************************//**
+ * Read the data available from device through TCP. The function will block
+ *          until at least one byte has been read or an error occurs.
+ * @param[in]  handle Socket handle
+ * @param[in]  data_length The maximum amount of bytes to read.
+ * @param[out]  data Buffer used for storing the data.
+ * @return  The amount of bytes read or -1 on failure or closed connection.
+ *****************************************************************************/
+int32_t tcp_rx_partial(void *handle, uint32_t data_length, uint8_t *data);
+
 /**************************************************************************//**
  * Return the number of bytes in the input buffer.
  * @param[in]  handle Socket handle
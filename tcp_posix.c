@@ -37,10 +37,25 @@
 #include <signal.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/ip.h>
 #include <pthread.h>
+#include <poll.h>
 #include "tcp.h"
 
+// Maximum number of buffers passed to one sendmsg call.
+#define TCP_TXV_MAX_IOV 64
+
+// Writing to a connection closed by the peer must fail instead of raising
+// SIGPIPE. Where MSG_NOSIGNAL is missing, SO_NOSIGPIPE is set on the socket.
+#ifdef MSG_NOSIGNAL
+#define TCP_SEND_FLAGS  MSG_NOSIGNAL
+#else
+#define TCP_SEND_FLAGS  0
+#endif
+
 // -----------------------------------------------------------------------------
 // Public Function Definitions
 
@@ -81,6 +96,107 @@ int32_t tcp_open(void *handle, char *ip, char *port)
   return ret;
 }
 
+int32_t tcp_connect_start(void *handle, char *ip, char *port)
+{
+  struct addrinfo *addr = NULL, hints = { 0 };
+  int socket_handle;
+  int ret;
+
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+
+  // Resolve the server address and port
+  ret = getaddrinfo(ip, port, &hints, &addr);
+  if (ret != 0) {
+    return -1;
+  }
+
+  socket_handle = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (socket_handle < 0) {
+    freeaddrinfo(addr);
+    return -1;
+  }
+  *(int32_t *)handle = socket_handle;
+#ifdef SO_NOSIGPIPE
+  {
+    int on = 1;
+    setsockopt(socket_handle, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+  }
+#endif
+  if (tcp_set_nonblocking(handle) < 0) {
+    freeaddrinfo(addr);
+    tcp_close(handle);
+    return -1;
+  }
+
+  ret = connect(socket_handle, addr->ai_addr, (int)addr->ai_addrlen);
+  freeaddrinfo(addr);
+  if (ret == 0) {
+    return 0;
+  }
+  if (errno == EINPROGRESS) {
+    return 1;
+  }
+  close(socket_handle);
+  *(int32_t *)handle = -1;
+  return -1;
+}
+
+int32_t tcp_connect_start_local(void *handle, char *path)
+{
+  struct sockaddr_un addr = { 0 };
+  int socket_handle;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  socket_handle = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_handle < 0) {
+    return -1;
+  }
+  *(int32_t *)handle = socket_handle;
+#ifdef SO_NOSIGPIPE
+  {
+    int on = 1;
+    setsockopt(socket_handle, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+  }
+#endif
+  if (tcp_set_nonblocking(handle) < 0) {
+    tcp_close(handle);
+    return -1;
+  }
+
+  if (connect(socket_handle, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    return 0;
+  }
+  // A full listen queue of a local socket reports EAGAIN.
+  if (errno == EINPROGRESS || errno == EAGAIN) {
+    return 1;
+  }
+  close(socket_handle);
+  *(int32_t *)handle = -1;
+  return -1;
+}
+
+int32_t tcp_connect_finish(void *handle)
+{
+  struct pollfd pfd = { .fd = *(int32_t *)handle, .events = POLLOUT };
+  int error = 0;
+  socklen_t len = sizeof(error);
+
+  if (poll(&pfd, 1, 0) == 0) {
+    return 1;
+  }
+  if (getsockopt(pfd.fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+    return -1;
+  }
+  return 0;
+}
+
 int32_t tcp_tx(void *handle, uint32_t data_length, uint8_t *data)
 {
   int32_t ret = -1;
@@ -94,6 +210,139 @@ int32_t tcp_tx(void *handle, uint32_t data_length, uint8_t *data)
   return ret;
 }
 
+int32_t tcp_txv(void *handle, tcp_buf_t *bufs, uint32_t count)
+{
+  struct iovec iov[TCP_TXV_MAX_IOV];
+  struct msghdr msg = { 0 };
+  uint32_t iov_count;
+  uint32_t i;
+  ssize_t size;
+  int32_t total = 0;
+
+  if (*(int32_t *)handle < 0) {
+    return -1;
+  }
+
+  while (count > 0) {
+    iov_count = (count < TCP_TXV_MAX_IOV) ? count : TCP_TXV_MAX_IOV;
+    for (i = 0; i < iov_count; i++) {
+      iov[i].iov_base = bufs[i].data;
+      iov[i].iov_len = bufs[i].len;
+    }
+    i = 0;
+    while (i < iov_count) {
+      msg.msg_iov = &iov[i];
+      msg.msg_iovlen = iov_count - i;
+      do {
+        size = sendmsg(*(int32_t *)handle, &msg, TCP_SEND_FLAGS);
+      } while (size < 0 && errno == EINTR);
+      if (size < 0) {
+        // The send buffer of a non-blocking socket is full.
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return total;
+        }
+        return -1;
+      }
+      total += (int32_t)size;
+      // Skip the buffers written, then continue with the rest of a buffer
+      // written partially.
+      while (i < iov_count && (size_t)size >= iov[i].iov_len) {
+        size -= (ssize_t)iov[i].iov_len;
+        i++;
+      }
+      if (i < iov_count) {
+        iov[i].iov_base = (uint8_t *)iov[i].iov_base + size;
+        iov[i].iov_len -= (size_t)size;
+      }
+    }
+    bufs += iov_count;
+    count -= iov_count;
+  }
+
+  return total;
+}
+
+int32_t tcp_set_nonblocking(void *handle)
+{
+  int flags;
+
+  flags = fcntl(*(int32_t *)handle, F_GETFL);
+  if (flags < 0 || fcntl(*(int32_t *)handle, F_SETFL, flags | O_NONBLOCK) < 0) {
+    perror("Failed to make the socket non-blocking");
+    return -1;
+  }
+
+  return 0;
+}
+
+int32_t udp_open(void *handle, char *ip, char *port)
+{
+  struct addrinfo *addr = NULL, hints = { 0 };
+  int socket_handle;
+  int ret;
+
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_protocol = IPPROTO_UDP;
+
+  ret = getaddrinfo(ip, port, &hints, &addr);
+  if (ret != 0) {
+    return -1;
+  }
+
+  socket_handle = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (socket_handle < 0) {
+    freeaddrinfo(addr);
+    return -1;
+  }
+  *(int32_t *)handle = socket_handle;
+
+  // Connecting a UDP socket only sets the destination.
+  ret = connect(socket_handle, addr->ai_addr, (int)addr->ai_addrlen);
+  freeaddrinfo(addr);
+  if (ret < 0 || tcp_set_nonblocking(handle) < 0) {
+    tcp_close(handle);
+    return -1;
+  }
+  return 0;
+}
+
+int32_t udp_txv(void *handle, tcp_buf_t *bufs, uint32_t count)
+{
+  struct iovec iov[UDP_TXV_MAX_BUFS];
+  struct msghdr msg = { 0 };
+  uint32_t i;
+  ssize_t size;
+  size_t len = 0;
+
+  if (*(int32_t *)handle < 0 || count > UDP_TXV_MAX_BUFS) {
+    return -1;
+  }
+
+  for (i = 0; i < count; i++) {
+    iov[i].iov_base = bufs[i].data;
+    iov[i].iov_len = bufs[i].len;
+    len += bufs[i].len;
+  }
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+  do {
+    size = sendmsg(*(int32_t *)handle, &msg, 0);
+  } while (size < 0 && errno == EINTR);
+  if (size < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    }
+    // Nobody listens at the destination, the datagram is lost like any
+    // other datagram.
+    if (errno == ECONNREFUSED) {
+      return (int32_t)len;
+    }
+    return -1;
+  }
+  return (int32_t)size;
+}
+
 int32_t tcp_rx(void *handle, uint32_t data_length, uint8_t *data)
 {
   // The amount of bytes still needed to be read.
@@ -126,6 +375,29 @@ int32_t tcp_rx(void *handle, uint32_t data_length, uint8_t *data)
   return (int32_t)data_length;
 }
 
+int32_t tcp_rx_partial(void *handle, uint32_t data_length, uint8_t *data)
+{
+  int32_t size;
+
+  if (*(int32_t *)handle < 0) {
+    return -1;
+  }
+
+  do {
+    size = read(*(int32_t *)handle, (void *) data, (size_t) data_length);
+  } while (size < 0 && errno == EINTR);
+
+  if (size < 0) {
+    perror("TCP receive failed");
+    return -1;
+  } else if (size == 0) {
+    fprintf(stderr, "TCP connection closed by peer\n");
+    return -1;
+  }
+
+  return size;
+}
+
 int32_t tcp_rx_peek(void *handle)
 {
   int32_t count;
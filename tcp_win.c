@@ -34,6 +34,9 @@
 #include <stdio.h>
 #include "tcp.h"
 
+// Maximum number of buffers passed to one WSASend call.
+#define TCP_TXV_MAX_BUF 64
+
 #define WINERRORLOG do {                                      \
     wchar_t *s = NULL;                                        \
     FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER             \
@@ -103,6 +106,82 @@ int32_t tcp_open(void *handle, char *ip, char *port)
   return 0;
 }
 
+int32_t tcp_connect_start(void *handle, char *ip, char *port)
+{
+  struct addrinfo *addr = NULL, hints;
+  WSADATA wsa_data;
+  SOCKET socket_handle;
+  int ret;
+
+  ret = WSAStartup(MAKEWORD(2, 2), &wsa_data);
+  if (ret != 0) {
+    return -1;
+  }
+
+  ZeroMemory(&hints, sizeof(hints) );
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+
+  // Resolve the server address and port
+  ret = getaddrinfo(ip, port, &hints, &addr);
+  if (ret != 0) {
+    WSACleanup();
+    return -1;
+  }
+
+  socket_handle = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (socket_handle == INVALID_SOCKET) {
+    freeaddrinfo(addr);
+    WSACleanup();
+    return -1;
+  }
+  *(SOCKET *)handle = socket_handle;
+  if (tcp_set_nonblocking(handle) < 0) {
+    freeaddrinfo(addr);
+    tcp_close(handle);
+    return -1;
+  }
+
+  ret = connect(socket_handle, addr->ai_addr, (int)addr->ai_addrlen);
+  freeaddrinfo(addr);
+  if (ret == 0) {
+    return 0;
+  }
+  if (WSAGetLastError() == WSAEWOULDBLOCK) {
+    return 1;
+  }
+  tcp_close(handle);
+  return -1;
+}
+
+int32_t tcp_connect_start_local(void *handle, char *path)
+{
+  (void)handle;
+  (void)path;
+  fprintf(stderr, "Local sockets are not supported on Windows\n");
+  return -1;
+}
+
+int32_t tcp_connect_finish(void *handle)
+{
+  fd_set write_fds, except_fds;
+  struct timeval timeout = { 0, 0 };
+
+  FD_ZERO(&write_fds);
+  FD_ZERO(&except_fds);
+  FD_SET(*(SOCKET *)handle, &write_fds);
+  FD_SET(*(SOCKET *)handle, &except_fds);
+  if (select(0, NULL, &write_fds, &except_fds, &timeout) == SOCKET_ERROR) {
+    return -1;
+  }
+  // A failed connection attempt is reported in the exception set.
+  if (FD_ISSET(*(SOCKET *)handle, &except_fds)) {
+    return -1;
+  }
+  return FD_ISSET(*(SOCKET *)handle, &write_fds) ? 0 : 1;
+}
+
 int32_t tcp_tx(void *handle, uint32_t data_length, uint8_t *data)
 {
   int ret;
@@ -121,6 +200,134 @@ int32_t tcp_tx(void *handle, uint32_t data_length, uint8_t *data)
   return ret;
 }
 
+int32_t tcp_txv(void *handle, tcp_buf_t *bufs, uint32_t count)
+{
+  WSABUF wsa_bufs[TCP_TXV_MAX_BUF];
+  DWORD buf_count;
+  DWORD sent;
+  DWORD len;
+  DWORD i;
+  int32_t total = 0;
+
+  if (*(SOCKET *)handle == INVALID_SOCKET) {
+    return -1;
+  }
+
+  while (count > 0) {
+    buf_count = (count < TCP_TXV_MAX_BUF) ? count : TCP_TXV_MAX_BUF;
+    len = 0;
+    for (i = 0; i < buf_count; i++) {
+      wsa_bufs[i].buf = (char *)bufs[i].data;
+      wsa_bufs[i].len = bufs[i].len;
+      len += bufs[i].len;
+    }
+    // A blocking WSASend returns when all the buffers are sent.
+    if (WSASend(*(SOCKET *)handle, wsa_bufs, buf_count, &sent, 0, NULL, NULL)
+        == SOCKET_ERROR) {
+      // The send buffer of a non-blocking socket is full.
+      if (WSAGetLastError() == WSAEWOULDBLOCK) {
+        return total;
+      }
+      WINERRORLOG;
+      return -1;
+    }
+    total += (int32_t)sent;
+    if (sent < len) {
+      break;
+    }
+    bufs += buf_count;
+    count -= buf_count;
+  }
+
+  return total;
+}
+
+int32_t tcp_set_nonblocking(void *handle)
+{
+  u_long mode = 1;
+
+  if (ioctlsocket(*(SOCKET *)handle, FIONBIO, &mode) == SOCKET_ERROR) {
+    WINERRORLOG;
+    return -1;
+  }
+
+  return 0;
+}
+
+int32_t udp_open(void *handle, char *ip, char *port)
+{
+  struct addrinfo *addr = NULL, hints;
+  WSADATA wsa_data;
+  SOCKET socket_handle;
+  int ret;
+
+  ret = WSAStartup(MAKEWORD(2, 2), &wsa_data);
+  if (ret != 0) {
+    return -1;
+  }
+
+  ZeroMemory(&hints, sizeof(hints) );
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_protocol = IPPROTO_UDP;
+
+  ret = getaddrinfo(ip, port, &hints, &addr);
+  if (ret != 0) {
+    WSACleanup();
+    return -1;
+  }
+
+  socket_handle = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (socket_handle == INVALID_SOCKET) {
+    freeaddrinfo(addr);
+    WSACleanup();
+    return -1;
+  }
+  *(SOCKET *)handle = socket_handle;
+
+  // Connecting a UDP socket only sets the destination.
+  ret = connect(socket_handle, addr->ai_addr, (int)addr->ai_addrlen);
+  freeaddrinfo(addr);
+  if (ret == SOCKET_ERROR || tcp_set_nonblocking(handle) < 0) {
+    tcp_close(handle);
+    return -1;
+  }
+  return 0;
+}
+
+int32_t udp_txv(void *handle, tcp_buf_t *bufs, uint32_t count)
+{
+  WSABUF wsa_bufs[UDP_TXV_MAX_BUFS];
+  DWORD sent;
+  DWORD len = 0;
+  DWORD i;
+
+  if (*(SOCKET *)handle == INVALID_SOCKET || count > UDP_TXV_MAX_BUFS) {
+    return -1;
+  }
+
+  for (i = 0; i < count; i++) {
+    wsa_bufs[i].buf = (char *)bufs[i].data;
+    wsa_bufs[i].len = bufs[i].len;
+    len += bufs[i].len;
+  }
+  if (WSASend(*(SOCKET *)handle, wsa_bufs, count, &sent, 0, NULL, NULL)
+      == SOCKET_ERROR) {
+    switch (WSAGetLastError()) {
+      case WSAEWOULDBLOCK:
+        return 0;
+      // Nobody listens at the destination, the datagram is lost like any
+      // other datagram.
+      case WSAECONNRESET:
+        return (int32_t)len;
+      default:
+        WINERRORLOG;
+        return -1;
+    }
+  }
+  return (int32_t)sent;
+}
+
 int32_t tcp_rx(void *handle, uint32_t data_length, uint8_t *data)
 {
   // Variable for storing function return values.
@@ -156,6 +363,28 @@ int32_t tcp_rx(void *handle, uint32_t data_length, uint8_t *data)
   return (int32_t)data_length;
 }
 
+int32_t tcp_rx_partial(void *handle, uint32_t data_length, uint8_t *data)
+{
+  int ret;
+
+  if (*(SOCKET *)handle == INVALID_SOCKET) {
+    return -1;
+  }
+
+  ret = recv(*(SOCKET *)handle, (char *) data, (int) data_length, 0);
+
+  if (ret == SOCKET_ERROR) {
+    fprintf(stderr, "TCP receive failed: %d\n", WSAGetLastError());
+    WINERRORLOG;
+    return -1;
+  } else if (ret == 0) {
+    fprintf(stderr, "TCP connection closed by peer\n");
+    return -1;
+  }
+
+  return (int32_t)ret;
+}
+
 int32_t tcp_rx_peek(void *handle)
 {
   u_long count = 0;
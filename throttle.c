@@ -0,0 +1,335 @@
+/***************************************************************************//**
+ * @file
+ * @brief Output rate limiting and deadband of the angle results
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "app_log.h"
+#include "aoa_util.h"
+#include "throttle.h"
+
+#define DEG_TO_RAD  (M_PI / 180.0)
+
+// Rate of a tag given with -T.
+typedef struct {
+  uint8_t address[ADR_LEN];
+  uint8_t address_type;
+  uint32_t period_us;
+  throttle_mode_t mode;
+} tag_rate_t;
+
+static uint32_t default_period_us;
+static throttle_mode_t default_mode = THROTTLE_LATEST;
+static tag_rate_t tag_rates[THROTTLE_MAX_TAG_RATES];
+static uint32_t tag_rate_count;
+static throttle_stats_t stats;
+
+// Deadband thresholds, negative: not checked.
+static bool deadband;
+static float deadband_azimuth;
+static float deadband_elevation;
+static float deadband_distance = -1.0f;
+static uint64_t heartbeat_us = (uint64_t)THROTTLE_HEARTBEAT_DEFAULT * 1000;
+
+static sl_status_t parse_rate(char *value, uint32_t *period_us);
+static sl_status_t parse_mode(char *value, throttle_mode_t *mode);
+static sl_status_t parse_tag_rate(char *value);
+static sl_status_t parse_deadband(char *value);
+static bool has_moved(const throttle_state_t *state, const aoa_angle_t *angle);
+static void accumulate(throttle_state_t *state, const aoa_angle_t *angle);
+static void take_mean(throttle_state_t *state, aoa_angle_t *angle);
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+sl_status_t throttle_set_option(char option, char *value)
+{
+  sl_status_t sc;
+
+  switch (option) {
+    // Default rate.
+    case 'F':
+      sc = parse_rate(value, &default_period_us);
+      break;
+    // Rate of a tag.
+    case 'T':
+      sc = parse_tag_rate(value);
+      break;
+    // Mode.
+    case 'A':
+      sc = parse_mode(value, &default_mode);
+      break;
+    // Deadband.
+    case 'Z':
+      sc = parse_deadband(value);
+      break;
+    // Heartbeat interval.
+    case 'H':
+    {
+      char *end;
+      unsigned long interval = strtoul(value, &end, 0);
+      if (*end != '\0') {
+        sc = SL_STATUS_INVALID_PARAMETER;
+      } else {
+        heartbeat_us = (uint64_t)interval * 1000;
+        sc = SL_STATUS_OK;
+      }
+      break;
+    }
+    // Unknown option.
+    default:
+      sc = SL_STATUS_NOT_FOUND;
+      break;
+  }
+  return sc;
+}
+
+void throttle_init(throttle_state_t *state,
+                   const uint8_t address[ADR_LEN],
+                   uint8_t address_type)
+{
+  memset(state, 0, sizeof(*state));
+  state->period_us = default_period_us;
+  state->mode = default_mode;
+  for (uint32_t i = 0; i < tag_rate_count; i++) {
+    if (tag_rates[i].address_type == address_type
+        && memcmp(tag_rates[i].address, address, ADR_LEN) == 0) {
+      state->period_us = tag_rates[i].period_us;
+      state->mode = tag_rates[i].mode;
+      break;
+    }
+  }
+}
+
+bool throttle_process(throttle_state_t *state, aoa_angle_t *angle)
+{
+  uint64_t now = 0;
+
+  stats.results++;
+  if (state->period_us != 0) {
+    if (state->mode != THROTTLE_LATEST) {
+      accumulate(state, angle);
+    }
+    now = aoa_time_us();
+    if (now < state->next_us) {
+      stats.rate_limited++;
+      return false;
+    }
+    if (state->mode == THROTTLE_MEAN) {
+      take_mean(state, angle);
+    } else if (state->mode == THROTTLE_BEST) {
+      *angle = state->best;
+    }
+    state->count = 0;
+    // Keep the cadence of the periods, unless the tag has been silent.
+    state->next_us += state->period_us;
+    if (state->next_us <= now) {
+      state->next_us = now + state->period_us;
+    }
+  }
+
+  if (deadband) {
+    if (now == 0) {
+      now = aoa_time_us();
+    }
+    if (state->has_output && !has_moved(state, angle)) {
+      if (heartbeat_us == 0 || now - state->output_us < heartbeat_us) {
+        stats.deadband++;
+        return false;
+      }
+      stats.heartbeats++;
+    }
+    state->has_output = true;
+    state->output = *angle;
+    state->output_us = now;
+  }
+  stats.output++;
+  return true;
+}
+
+void throttle_get_stats(throttle_stats_t *throttle_stats)
+{
+  *throttle_stats = stats;
+}
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+static sl_status_t parse_rate(char *value, uint32_t *period_us)
+{
+  char *end;
+  double rate = strtod(value, &end);
+
+  // The period must fit in 32 bits.
+  if (*end != '\0' || !(rate >= 0) || (rate > 0 && rate < 0.001)) {
+    app_log_error("Invalid output rate: %s" APP_LOG_NL, value);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  *period_us = (rate == 0) ? 0 : (uint32_t)(1000000.0 / rate + 0.5);
+  return SL_STATUS_OK;
+}
+
+static sl_status_t parse_mode(char *value, throttle_mode_t *mode)
+{
+  if (strcmp(value, "latest") == 0) {
+    *mode = THROTTLE_LATEST;
+  } else if (strcmp(value, "mean") == 0) {
+    *mode = THROTTLE_MEAN;
+  } else if (strcmp(value, "best") == 0) {
+    *mode = THROTTLE_BEST;
+  } else {
+    app_log_error("Unknown output rate mode: %s" APP_LOG_NL, value);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  return SL_STATUS_OK;
+}
+
+// Parse <tag>=<rate>[,<mode>].
+static sl_status_t parse_tag_rate(char *value)
+{
+  tag_rate_t *tag_rate;
+  char *rate;
+  char *mode;
+  sl_status_t sc;
+
+  if (tag_rate_count == THROTTLE_MAX_TAG_RATES) {
+    app_log_error("At most %d tag rates are supported." APP_LOG_NL,
+                  THROTTLE_MAX_TAG_RATES);
+    return SL_STATUS_FULL;
+  }
+  tag_rate = &tag_rates[tag_rate_count];
+  rate = strchr(value, '=');
+  if (rate == NULL) {
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  *rate++ = '\0';
+  mode = strchr(rate, ',');
+  if (mode != NULL) {
+    *mode++ = '\0';
+  }
+  if (strlen(value) >= AOA_ID_MAX_SIZE
+      || aoa_id_to_address(value, tag_rate->address, &tag_rate->address_type)
+      != SL_STATUS_OK) {
+    app_log_error("Invalid tag ID: %s" APP_LOG_NL, value);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  sc = parse_rate(rate, &tag_rate->period_us);
+  if (sc != SL_STATUS_OK) {
+    return sc;
+  }
+  tag_rate->mode = default_mode;
+  if (mode != NULL) {
+    sc = parse_mode(mode, &tag_rate->mode);
+    if (sc != SL_STATUS_OK) {
+      return sc;
+    }
+  }
+  tag_rate_count++;
+  return SL_STATUS_OK;
+}
+
+// Parse <azimuth>,<elevation>[,<distance>].
+static sl_status_t parse_deadband(char *value)
+{
+  float thresholds[3] = { 0.0f, 0.0f, -1.0f };
+  char *end = value;
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    thresholds[i] = strtof(value, &end);
+    if (end == value || !(thresholds[i] >= 0)) {
+      break;
+    }
+    if (*end != ',') {
+      i++;
+      break;
+    }
+    value = end + 1;
+  }
+  if (i < 2 || *end != '\0') {
+    app_log_error("Invalid deadband: expected <azimuth>,<elevation>[,<distance>]" APP_LOG_NL);
+    return SL_STATUS_INVALID_PARAMETER;
+  }
+  deadband_azimuth = thresholds[0];
+  deadband_elevation = thresholds[1];
+  deadband_distance = (i == 3) ? thresholds[2] : -1.0f;
+  deadband = true;
+  return SL_STATUS_OK;
+}
+
+// Check whether a result has moved past the deadband since the last output.
+static bool has_moved(const throttle_state_t *state, const aoa_angle_t *angle)
+{
+  float azimuth = fabsf(angle->azimuth - state->output.azimuth);
+
+  // The azimuth wraps around.
+  if (azimuth > 180.0f) {
+    azimuth = 360.0f - azimuth;
+  }
+  return azimuth > deadband_azimuth
+         || fabsf(angle->elevation - state->output.elevation) > deadband_elevation
+         || (deadband_distance >= 0
+             && fabsf(angle->distance - state->output.distance) > deadband_distance);
+}
+
+// Add a result to the period.
+static void accumulate(throttle_state_t *state, const aoa_angle_t *angle)
+{
+  if (state->count == 0) {
+    state->azimuth_x = 0;
+    state->azimuth_y = 0;
+    state->elevation = 0;
+    state->distance = 0;
+    state->quality = 0;
+    state->best = *angle;
+  } else if (__builtin_popcount(angle->quality)
+             <= __builtin_popcount(state->best.quality)) {
+    // The quality is a set of flags, not a score: fewer flags rank better.
+    state->best = *angle;
+  }
+  state->azimuth_x += cos(angle->azimuth * DEG_TO_RAD);
+  state->azimuth_y += sin(angle->azimuth * DEG_TO_RAD);
+  state->elevation += angle->elevation;
+  state->distance += angle->distance;
+  state->quality |= angle->quality;
+  state->count++;
+}
+
+// Replace the latest result by the mean of the period.
+static void take_mean(throttle_state_t *state, aoa_angle_t *angle)
+{
+  angle->azimuth = (float)(atan2(state->azimuth_y, state->azimuth_x)
+                           / DEG_TO_RAD);
+  angle->elevation = (float)(state->elevation / state->count);
+  angle->distance = (float)(state->distance / state->count);
+  angle->quality = state->quality;
+}
@@ -0,0 +1,164 @@
+/***************************************************************************//**
+ * @file
+ * @brief Output rate limiting and deadband of the angle results
+ *
+ * Every IQ report still goes through the angle estimation, but at most one
+ * result per tag and period is output. A result is output when it arrives
+ * at least a period after the previous output; the results in between are
+ * either dropped or folded into the output, depending on the mode:
+ *
+ *   latest  The result that closes the period
+ *   mean    The mean of the results since the previous output: circular
+ *           mean of the azimuth, arithmetic mean of the elevation and the
+ *           distance, the quality flags of all of them combined
+ *   best    The result with the fewest quality flags set since the
+ *           previous output, the later one on ties
+ *
+ * With a deadband, a result that passes the rate limit is only output if
+ * the azimuth, the elevation or the distance has moved past its threshold
+ * since the previous output of the tag, or if the heartbeat interval has
+ * passed since then. Stationary tags are then only reported at the
+ * heartbeat interval.
+ *
+ * Results are not held back by a timer: the results of a tag that stops
+ * after a suppressed result are not output.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aoa_types.h"
+#include "aoa_util.h"
+#include "sl_status.h"
+
+// Optstring argument for getopt.
+#define THROTTLE_OPTSTRING "F:T:A:Z:H:"
+
+// Usage info.
+#define THROTTLE_USAGE "[-F <rate>] [-T <tag>=<rate>[,<mode>]]... [-A <mode>] [-Z <deadband>] [-H <heartbeat>] "
+
+// Options info.
+#define THROTTLE_OPTIONS                                                                           \
+  "    -F  Maximum output rate of every tag.\n"                                                    \
+  "        <rate>           Results per second, 0: no limit (default)\n"                           \
+  "    -T  Maximum output rate of a tag, overrides -F. Can be repeated.\n"                         \
+  "        <tag>            Tag ID, e.g. ble-pd-000B57000001\n"                                    \
+  "        <rate>           Results per second, 0: no limit\n"                                     \
+  "        <mode>           As for -A, default: the mode of -A\n"                                  \
+  "    -A  Result output in every period of a limited rate.\n"                                     \
+  "        <mode>           latest: the latest result (default)\n"                                 \
+  "                         mean:   mean of the results of the period\n"                           \
+  "                         best:   the result of the best quality in the period\n"                \
+  "    -Z  Only output a result if it has moved past the deadband, default: disabled.\n"           \
+  "        <deadband>       <azimuth>,<elevation>[,<distance>] in degrees and meters,\n"           \
+  "                         the distance is not checked if omitted\n"                              \
+  "    -H  Output a result in the deadband anyway after this long without output.\n"               \
+  "        <heartbeat>      Milliseconds, 0: never (default: 10000)\n"
+
+// Maximum number of tags with their own rate.
+#define THROTTLE_MAX_TAG_RATES  64
+
+// Default heartbeat interval of the deadband in milliseconds.
+#define THROTTLE_HEARTBEAT_DEFAULT  10000
+
+typedef enum {
+  THROTTLE_LATEST,
+  THROTTLE_MEAN,
+  THROTTLE_BEST
+} throttle_mode_t;
+
+// Rate limiting state of a tag, as seen by a locator.
+typedef struct {
+  uint32_t period_us;       // Minimum time between outputs, 0: no limit
+  throttle_mode_t mode;
+  uint64_t next_us;         // Earliest time of the next output
+  uint32_t count;           // Results since the previous output
+  double azimuth_x;         // Sum of the azimuth unit vectors
+  double azimuth_y;
+  double elevation;         // Sum of the elevations
+  double distance;          // Sum of the distances
+  uint32_t quality;         // Quality flags of the results combined
+  aoa_angle_t best;         // Best result since the previous output
+  bool has_output;          // A result has been output
+  aoa_angle_t output;       // The previous result output
+  uint64_t output_us;       // Time of the previous output
+} throttle_state_t;
+
+typedef struct {
+  uint64_t results;         // Results processed
+  uint64_t output;          // Results output
+  uint64_t rate_limited;    // Results suppressed by the rate limit
+  uint64_t deadband;        // Results suppressed by the deadband
+  uint64_t heartbeats;      // Results in the deadband output anyway
+} throttle_stats_t;
+
+/**************************************************************************//**
+ * Set rate limiting options.
+ *
+ * @param[in] option Option to set.
+ * @param[in] value Value of the option.
+ *
+ * @retval SL_STATUS_OK Option set successfully.
+ * @retval SL_STATUS_NOT_FOUND Unknown option.
+ * @retval SL_STATUS_INVALID_PARAMETER Invalid value.
+ * @retval SL_STATUS_FULL Too many tag rates.
+ *****************************************************************************/
+sl_status_t throttle_set_option(char option, char *value);
+
+/**************************************************************************//**
+ * Initialize the rate limiting state of a new tag.
+ *
+ * @param[out] state State of the tag.
+ * @param[in] address Address of the tag.
+ * @param[in] address_type Address type of the tag.
+ *****************************************************************************/
+void throttle_init(throttle_state_t *state,
+                   const uint8_t address[ADR_LEN],
+                   uint8_t address_type);
+
+/**************************************************************************//**
+ * Decide whether to output a new result of a tag, with the rate limit and
+ * the deadband.
+ *
+ * @param[in] state State of the tag.
+ * @param[in,out] angle New result, replaced by the result to output.
+ *
+ * @return true if the result is to be output.
+ *****************************************************************************/
+bool throttle_process(throttle_state_t *state, aoa_angle_t *angle);
+
+/**************************************************************************//**
+ * Get the rate limiting and deadband statistics.
+ *
+ * @param[out] stats Statistics since the start of the application.
+ *****************************************************************************/
+void throttle_get_stats(throttle_stats_t *stats);
+
+#endif // THROTTLE_H
@@ -55,7 +55,8 @@
  * Open the serial port.
  * @param[out]  handle Descriptor handle
  * @param[in]  port Serial port to use.
- * @param[in]  baudRate Baud rate to use.
+ * @param[in]  baudRate Baud rate to use. Rates without a standard constant,
+ *                      e.g. 2000000, are set through the driver if supported.
  * @param[in]  rtsCts Enable/disable hardware flow control.
  * @param[in]  timeout Constant used to calculate the total time-out period fo
  *                     read operations, in milliseconds.
@@ -113,6 +114,18 @@ int32_t uartRxPeek(void *handle);
  *****************************************************************************/
 int32_t uartTx(void *handle, uint32_t dataLength, uint8_t *data);
 
+/**************************************************************************//**
+ * Tune an open serial port for low latency.
+ *
+ * On Linux, the driver is asked to pass received data on without delay
+ * (ASYNC_LOW_LATENCY, if supported), and reads are switched to block until
+ * the first byte arrives and then return all available data (VMIN=1,
+ * VTIME=0). On Windows, the driver input buffer is enlarged.
+ * @param[in]  handle Descriptor handle
+ * @return  0 on success, -1 on failure.
+ *****************************************************************************/
+int32_t uartSetLowLatency(void *handle);
+
 /** @} (end addtogroup uart) */
 /** @} (end addtogroup platform_hw) */
 
@@ -0,0 +1,286 @@
+/***************************************************************************//**
+ * @file
+ * @brief UART receive benchmark over a pseudo terminal.
+ *
+ * Feeds IQ report sized BGAPI frames into a pseudo terminal at the byte rate
+ * of the given baud rates and reads them back through the UART driver, once
+ * with the default settings of the NCP host and once in low latency mode.
+ * A pseudo terminal has no line rate, so the writer paces the frames itself;
+ * the unpaced row shows the ceiling of the receive path.
+ *
+ * Usage: uart_bench [-d <seconds>] [-s <frame_size>]
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "uart.h"
+
+// Timeout used by the NCP host when opening the serial port.
+#define DEFAULT_UART_TIMEOUT    100
+// Size of a silabs IQ report event with 4 snapshots of a 4x4 array.
+#define DEFAULT_FRAME_SIZE      164
+#define DEFAULT_DURATION        1
+// Frames sent in the unpaced case.
+#define UNPACED_FRAME_COUNT     100000
+// Read chunk size of the NCP host.
+#define READ_CHUNK_SIZE         4096
+// Bits on the line per byte: start bit, 8 data bits, stop bit.
+#define BITS_PER_BYTE           10
+
+typedef struct {
+  int master;
+  uint32_t baud_rate;  // 0: unpaced
+  uint32_t frame_size;
+  uint32_t frame_count;
+} writer_t;
+
+typedef struct {
+  double frames_per_sec;
+  double reads_per_frame;
+  double latency_mean_us;
+  double latency_max_us;
+  uint32_t frames;
+} result_t;
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**************************************************************************//**
+ * Write the frames with their send time in the payload, pacing them to the
+ * byte rate of the baud rate. Frames that are due are written together.
+ *****************************************************************************/
+static void *writer_thread(void *arg)
+{
+  writer_t *w = (writer_t *)arg;
+  uint8_t *buf;
+  uint64_t start = now_ns();
+  uint64_t frame_ns = 0;
+  uint32_t sent = 0;
+  uint32_t due;
+  uint32_t batch;
+  uint32_t max_batch = READ_CHUNK_SIZE / w->frame_size + 1;
+  uint64_t t;
+
+  buf = malloc((size_t)max_batch * w->frame_size);
+  if (w->baud_rate != 0) {
+    frame_ns = (uint64_t)w->frame_size * BITS_PER_BYTE * 1000000000ULL
+               / w->baud_rate;
+  }
+
+  while (sent < w->frame_count) {
+    if (frame_ns != 0) {
+      // Sleep until the next frame has been fully "transmitted".
+      struct timespec ts;
+      t = start + (uint64_t)(sent + 1) * frame_ns;
+      ts.tv_sec = (time_t)(t / 1000000000ULL);
+      ts.tv_nsec = (long)(t % 1000000000ULL);
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+      due = (uint32_t)((now_ns() - start) / frame_ns);
+    } else {
+      due = w->frame_count;
+    }
+    batch = due - sent;
+    if (batch > max_batch) {
+      batch = max_batch;
+    }
+    if (batch > w->frame_count - sent) {
+      batch = w->frame_count - sent;
+    }
+    t = now_ns();
+    for (uint32_t i = 0; i < batch; i++) {
+      uint8_t *frame = &buf[(size_t)i * w->frame_size];
+      memset(frame, 0x55, w->frame_size);
+      // BGAPI event header followed by the send time.
+      frame[0] = 0xa0;
+      frame[1] = (uint8_t)(w->frame_size - 4);
+      frame[2] = 0x45;
+      frame[3] = 0x00;
+      memcpy(&frame[4], &t, sizeof(t));
+    }
+    size_t len = (size_t)batch * w->frame_size;
+    size_t off = 0;
+    while (off < len) {
+      ssize_t n = write(w->master, &buf[off], len - off);
+      if (n < 0) {
+        free(buf);
+        return NULL;
+      }
+      off += (size_t)n;
+    }
+    sent += batch;
+  }
+  free(buf);
+  return NULL;
+}
+
+/**************************************************************************//**
+ * Run one case: open the slave side through the UART driver, then read until
+ * all frames have arrived.
+ *****************************************************************************/
+static bool run_case(uint32_t baud_rate, uint32_t frame_size, double duration,
+                     bool low_latency, result_t *result)
+{
+  int master;
+  int32_t handle;
+  pthread_t thread;
+  writer_t w;
+  uint8_t chunk[READ_CHUNK_SIZE];
+  uint64_t bytes_needed;
+  uint64_t bytes = 0;
+  uint64_t reads = 0;
+  uint64_t latency_sum = 0;
+  uint64_t latency_max = 0;
+  uint64_t start;
+  uint64_t end;
+  uint64_t sent_ns = 0;
+  uint32_t frame_pos = 0;
+  uint32_t frames = 0;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("pty");
+    return false;
+  }
+  if (uartOpen(&handle, (int8_t *)ptsname(master), baud_rate == 0 ? 115200
+               : baud_rate, 0, DEFAULT_UART_TIMEOUT) < 0) {
+    close(master);
+    return false;
+  }
+  if (low_latency && uartSetLowLatency(&handle) != 0) {
+    perror("uartSetLowLatency");
+  }
+
+  w.master = master;
+  w.baud_rate = baud_rate;
+  w.frame_size = frame_size;
+  if (baud_rate == 0) {
+    w.frame_count = UNPACED_FRAME_COUNT;
+  } else {
+    w.frame_count = (uint32_t)(duration * baud_rate
+                               / (BITS_PER_BYTE * frame_size));
+  }
+  bytes_needed = (uint64_t)w.frame_count * frame_size;
+
+  start = now_ns();
+  pthread_create(&thread, NULL, writer_thread, &w);
+  while (bytes < bytes_needed) {
+    int32_t n = uartRxNonBlocking(&handle, sizeof(chunk), chunk);
+    if (n < 0) {
+      break;
+    }
+    reads++;
+    end = now_ns();
+    for (int32_t i = 0; i < n; i++) {
+      // Collect the send time of the frame and account it at its last byte.
+      if (frame_pos >= 4 && frame_pos < 4 + sizeof(sent_ns)) {
+        ((uint8_t *)&sent_ns)[frame_pos - 4] = chunk[i];
+      }
+      if (++frame_pos == frame_size) {
+        uint64_t latency = end - sent_ns;
+        latency_sum += latency;
+        if (latency > latency_max) {
+          latency_max = latency;
+        }
+        frames++;
+        frame_pos = 0;
+      }
+    }
+    bytes += (uint64_t)n;
+  }
+  end = now_ns();
+  pthread_join(thread, NULL);
+  uartClose(&handle);
+  close(master);
+
+  result->frames = frames;
+  result->frames_per_sec = frames * 1e9 / (double)(end - start);
+  result->reads_per_frame = frames ? (double)reads / frames : 0;
+  result->latency_mean_us = frames ? latency_sum / 1e3 / frames : 0;
+  result->latency_max_us = latency_max / 1e3;
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  static const uint32_t baud_rates[] = { 115200, 921600, 2000000, 3000000, 0 };
+  uint32_t frame_size = DEFAULT_FRAME_SIZE;
+  double duration = DEFAULT_DURATION;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:s:h")) != -1) {
+    switch (opt) {
+      case 'd':
+        duration = atof(optarg);
+        break;
+      case 's':
+        frame_size = (uint32_t)atol(optarg);
+        break;
+      default:
+        printf("Usage: %s [-d <seconds>] [-s <frame_size>]\n", argv[0]);
+        return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (frame_size < 12 || frame_size > 259) {
+    fprintf(stderr, "Frame size must be between 12 and 259 bytes.\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("%-9s %-12s %10s %11s %14s %13s\n", "baud", "mode", "frames/s",
+         "reads/frame", "mean lat [us]", "max lat [us]");
+  for (size_t i = 0; i < sizeof(baud_rates) / sizeof(baud_rates[0]); i++) {
+    for (int low_latency = 0; low_latency <= 1; low_latency++) {
+      result_t r;
+      char baud[16];
+      if (!run_case(baud_rates[i], frame_size, duration, low_latency, &r)) {
+        return EXIT_FAILURE;
+      }
+      if (baud_rates[i] == 0) {
+        snprintf(baud, sizeof(baud), "unpaced");
+      } else {
+        snprintf(baud, sizeof(baud), "%u", baud_rates[i]);
+      }
+      printf("%-9s %-12s %10.0f %11.3f %14.1f %13.1f\n", baud,
+             low_latency ? "low-latency" : "default", r.frames_per_sec,
+             r.reads_per_frame, r.latency_mean_us, r.latency_max_us);
+    }
+  }
+  return EXIT_SUCCESS;
+}
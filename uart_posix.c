@@ -37,6 +37,12 @@
 #include <termios.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#if __linux == 1
+#include <linux/serial.h>
+#endif // __linux == 1
+#if __APPLE__ == 1
+#include <IOKit/serial/ioss.h>
+#endif // __APPLE__ == 1
 
 #include "uart.h"
 
@@ -60,9 +66,50 @@ static struct {
   { B38400, 38400  },
   { B57600, 57600  },
   { B115200, 115200 },
+#ifdef B230400
+  { B230400, 230400 },
+#endif // B230400
+#ifdef B460800
+  { B460800, 460800 },
+#endif // B460800
+#ifdef B921600
+  { B921600, 921600 },
+#endif // B921600
+#ifdef B1000000
+  { B1000000, 1000000 },
+#endif // B1000000
+#ifdef B2000000
+  { B2000000, 2000000 },
+#endif // B2000000
+#ifdef B3000000
+  { B3000000, 3000000 },
+#endif // B3000000
+#ifdef B4000000
+  { B4000000, 4000000 },
+#endif // B4000000
   { 0, 0 }
 };
 
+#if __linux == 1
+/* Arbitrary baud rates are set with the termios2 interface of the kernel.
+ * Its definition in <asm/termbits.h> clashes with <termios.h>, so it is
+ * repeated here. */
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif // BOTHER
+
+struct termios2 {
+  tcflag_t c_iflag;
+  tcflag_t c_oflag;
+  tcflag_t c_cflag;
+  tcflag_t c_lflag;
+  cc_t c_line;
+  cc_t c_cc[19];
+  speed_t c_ispeed;
+  speed_t c_ospeed;
+};
+#endif // __linux == 1
+
 // -----------------------------------------------------------------------------
 // Static Function Declarations
 
@@ -71,6 +118,7 @@ static int32_t uartOpenSerial(int8_t *device, uint32_t bps, uint32_t dataBits,
                               uint32_t rtsCts, uint32_t xOnXOff,
                               int32_t timeout);
 static int32_t uartCloseSerial(int32_t handle);
+static int32_t uartSetCustomSpeed(int32_t serial, uint32_t bps);
 
 // -----------------------------------------------------------------------------
 // Public Function Definitions
@@ -188,6 +236,43 @@ int32_t uartTx(void *handle, uint32_t dataLength, uint8_t *data)
   return (int32_t)dataLength;
 }
 
+int32_t uartSetLowLatency(void *handle)
+{
+  int32_t serial = *(int32_t *)handle;
+  struct termios ttyAttrs;
+#if __linux == 1
+  struct serial_struct serialInfo;
+#endif // __linux == 1
+
+  if (serial == -1) {
+    return -1;
+  }
+
+#if __linux == 1
+  /* Ask the driver to push received data to the tty layer right away instead
+   * of collecting it first. USB serial adapters, for example, shorten their
+   * latency timer. Not all devices support this, so failure is ignored. */
+  if (ioctl(serial, TIOCGSERIAL, &serialInfo) == 0) {
+    serialInfo.flags |= ASYNC_LOW_LATENCY;
+    (void)ioctl(serial, TIOCSSERIAL, &serialInfo);
+  }
+#endif // __linux == 1
+
+  /* VMIN=1, VTIME=0: read() blocks until the first byte arrives and then
+   * returns everything that is available, so no timer is involved and a
+   * reader never wakes up without data. */
+  if (tcgetattr(serial, &ttyAttrs) == -1) {
+    return -1;
+  }
+  ttyAttrs.c_cc[VMIN] = 1;
+  ttyAttrs.c_cc[VTIME] = 0;
+  if (tcsetattr(serial, TCSANOW, &ttyAttrs) == -1) {
+    return -1;
+  }
+
+  return 0;
+}
+
 // -----------------------------------------------------------------------------
 // Static Function Definitions
 
@@ -214,18 +299,20 @@ static int32_t uartOpenSerial(int8_t *device, uint32_t bps, uint32_t dataBits,
   int32_t serial = -1;
   struct termios ttyAttrs = { 0 };
 
-  // Check if baud rate is supported. Return -1 if not.
+  // Look up the standard baud rate. Other rates are set separately.
   for (i = 0; speedTab[i].nspeed != 0; i++) {
     if (bps == speedTab[i].nspeed) {
       break;
     }
   }
+#if __linux != 1 && __APPLE__ != 1
   if (speedTab[i].nspeed == 0) {
     fprintf(stderr, "Baud rate not supported %s - %s(%d).\n",
             (char*)device,
             strerror(errno), errno);
     goto error;
   }
+#endif // __linux != 1 && __APPLE__ != 1
 
   /* Open the serial port read/write, with no controlling terminal, and don't
    * wait for a connection. The O_NONBLOCK flag also causes subsequent I/O on
@@ -268,8 +355,8 @@ static int32_t uartOpenSerial(int8_t *device, uint32_t bps, uint32_t dataBits,
     goto error;
   }
 
-  // Configure baud rate.
-  if (cfsetspeed(&ttyAttrs, speedTab[i].cbaud) == -1) {
+  // Configure baud rate. A placeholder is used for non-standard rates.
+  if (cfsetspeed(&ttyAttrs, (speedTab[i].nspeed != 0) ? speedTab[i].cbaud : B38400) == -1) {
     fprintf(stderr, "Error setting baud rate %s - %s(%d).\n",
             (char *)device,
             strerror(errno), errno);
@@ -378,6 +465,15 @@ static int32_t uartOpenSerial(int8_t *device, uint32_t bps, uint32_t dataBits,
     goto error;
   }
 
+  if (speedTab[i].nspeed == 0) {
+    if (uartSetCustomSpeed(serial, bps) == -1) {
+      fprintf(stderr, "Baud rate not supported %s - %s(%d).\n",
+              (char*)device,
+              strerror(errno), errno);
+      goto error;
+    }
+  }
+
   // Success
   return serial;
 
@@ -402,3 +498,34 @@ static int32_t uartCloseSerial(int32_t handle)
 
   return ret;
 }
+
+/**************************************************************************//**
+ *  \brief  Set a baud rate that has no termios constant.
+ *  \param[in] serial Serial port handle.
+ *  \param[in] bps Baud Rate.
+ *  \return  0 on success, -1 on failure.
+ *****************************************************************************/
+static int32_t uartSetCustomSpeed(int32_t serial, uint32_t bps)
+{
+#if __linux == 1
+  struct termios2 ttyAttrs2;
+
+  if (ioctl(serial, TCGETS2, &ttyAttrs2) == -1) {
+    return -1;
+  }
+  ttyAttrs2.c_cflag &= ~CBAUD;
+  ttyAttrs2.c_cflag |= BOTHER;
+  ttyAttrs2.c_ispeed = bps;
+  ttyAttrs2.c_ospeed = bps;
+  return ioctl(serial, TCSETS2, &ttyAttrs2);
+#elif __APPLE__ == 1
+  speed_t speed = bps;
+
+  return ioctl(serial, IOSSIOSPEED, &speed);
+#else // __linux == 1
+  (void)serial;
+  (void)bps;
+  errno = EINVAL;
+  return -1;
+#endif // __linux == 1
+}
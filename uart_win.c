@@ -49,6 +49,10 @@
   #define CBR_921600 921600
 #endif // CBR_921600
 
+// Driver buffer sizes requested in low latency mode.
+#define UART_LOW_LATENCY_RX_BUFFER_SIZE 65536
+#define UART_LOW_LATENCY_TX_BUFFER_SIZE 4096
+
 // -----------------------------------------------------------------------------
 // Local Variables
 
@@ -211,6 +215,17 @@ int32_t uartTx(void *handle, uint32_t dataLength, uint8_t *data)
   return (int32_t)dataLength;
 }
 
+int32_t uartSetLowLatency(void *handle)
+{
+  /* Reads are non-blocking on Windows, so only the driver's input buffer is
+   * enlarged to ride out the time the application spends processing. */
+  if (!SetupComm(*(HANDLE *)handle, UART_LOW_LATENCY_RX_BUFFER_SIZE,
+                 UART_LOW_LATENCY_TX_BUFFER_SIZE)) {
+    return -1;
+  }
+  return 0;
+}
+
 // -----------------------------------------------------------------------------
 // Static Function Definitions
 
@@ -238,16 +253,13 @@ static HANDLE uartOpenSerial(int8_t* device, uint32_t bps, uint32_t dataBits,
   DCB settings = { 0 };
   COMMTIMEOUTS commTimeouts = { 0 };
 
-  // Check if baud rate is supported. Return -1 if not.
+  // Look up the standard baud rate. Other rates are passed to the driver as
+  // they are, and it fails if it does not support them.
   for (i = 0; speedTab[i].nspeed != 0; i++) {
     if (bps == speedTab[i].nspeed) {
       break;
     }
   }
-  if (speedTab[i].nspeed == 0) {
-    fprintf(stderr, "Baud rate not supported!\n");
-    goto error;
-  }
 
   /* Open the serial port for read/write with exclusive access, default
    * security attributes and not overlapped I/O. */
@@ -271,7 +283,7 @@ static HANDLE uartOpenSerial(int8_t* device, uint32_t bps, uint32_t dataBits,
   }
 
   // Configure baud rate.
-  settings.BaudRate = speedTab[i].cbaud;
+  settings.BaudRate = (speedTab[i].nspeed != 0) ? speedTab[i].cbaud : bps;
 
   /* The minimum number of free bytes allowed in the input buffer before flow
    * control is activated to inhibit the sender. Tune value if you experience
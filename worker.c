@@ -0,0 +1,398 @@
+/***************************************************************************//**
+ * @file
+ * @brief Angle estimation worker pool
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_log.h"
+#include "aoa_angle.h"
+#include "aoa_util.h"
+#include "worker.h"
+
+#if defined(POSIX) && POSIX == 1
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include "app_poll.h"
+#endif // defined(POSIX) && POSIX == 1
+
+#define WORKER_QUEUE_MASK     (WORKER_QUEUE_LEN - 1)
+
+// Number of workers set with -W.
+static uint32_t worker_count = 0;
+
+#if defined(POSIX) && POSIX == 1
+// A worker and its queue. The slot indices run freely and wrap around.
+// The head is written by the main loop only, the done index by the worker
+// only, so acquire/release ordering is sufficient to pass the slots back
+// and forth. The sleeping flag and the head are also accessed with
+// sequential consistency, so that either the worker sees the new head
+// before going to sleep or the main loop sees it sleeping and wakes it up.
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  worker_job_t *jobs;
+  uint32_t head;            // Next slot to fill, by the main loop
+  uint32_t done;            // Next slot to estimate, by the worker
+  uint32_t tail;            // Next estimate to hand over, by the main loop
+  bool sleeping;
+  bool stop;
+  bool started;
+  worker_stats_t stats;
+} worker_t;
+
+static worker_t workers[WORKER_MAX];
+static worker_handler_t worker_handler;
+
+// Pipe that becomes readable when a worker has finished a job. The flag is
+// set by the worker that writes the pipe and cleared by the main loop before
+// it collects the estimates, so that the pipe is written once per wakeup.
+static int worker_pipe[2] = { -1, -1 };
+static bool worker_signaled = false;
+
+static void *worker_thread(void *arg);
+static void worker_collect(void);
+static void on_wakeup(int fd, short revents, void *ctx);
+static void worker_stop(uint32_t count);
+#endif // defined(POSIX) && POSIX == 1
+
+// -----------------------------------------------------------------------------
+// Public Function Definitions
+
+sl_status_t worker_set_option(char option, char *value)
+{
+  char *end;
+  unsigned long number;
+
+  switch (option) {
+    // Number of workers.
+    case 'W':
+      number = strtoul(value, &end, 0);
+      if (*end != '\0' || number > WORKER_MAX) {
+        app_log_error("The number of workers must be between 0 and %u." APP_LOG_NL,
+                      WORKER_MAX);
+        return SL_STATUS_INVALID_PARAMETER;
+      }
+#if defined(POSIX) && POSIX == 1
+      worker_count = (uint32_t)number;
+#else // defined(POSIX) && POSIX == 1
+      if (number > 0) {
+        app_log_error("Workers are not supported on this platform." APP_LOG_NL);
+        return SL_STATUS_NOT_SUPPORTED;
+      }
+#endif // defined(POSIX) && POSIX == 1
+      return SL_STATUS_OK;
+    // Unknown option.
+    default:
+      return SL_STATUS_NOT_FOUND;
+  }
+}
+
+uint32_t worker_get_count(void)
+{
+  return worker_count;
+}
+
+#if defined(POSIX) && POSIX == 1
+sl_status_t worker_init(worker_handler_t handler)
+{
+  sigset_t all, old;
+  uint32_t i;
+  int rc = 0;
+
+  if (worker_count == 0) {
+    return SL_STATUS_OK;
+  }
+  worker_handler = handler;
+  for (i = 0; i < worker_count; i++) {
+    memset(&workers[i], 0, sizeof(workers[i]));
+    workers[i].stats.depth = WORKER_QUEUE_LEN;
+    workers[i].jobs = malloc(WORKER_QUEUE_LEN * sizeof(*workers[i].jobs));
+    if (workers[i].jobs == NULL) {
+      worker_stop(i + 1);
+      return SL_STATUS_ALLOCATION_FAILED;
+    }
+    pthread_mutex_init(&workers[i].mutex, NULL);
+    pthread_cond_init(&workers[i].cond, NULL);
+  }
+  if (pipe(worker_pipe) < 0) {
+    worker_stop(worker_count);
+    return SL_STATUS_FAIL;
+  }
+  fcntl(worker_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(worker_pipe[1], F_SETFL, O_NONBLOCK);
+  if (app_poll_add(worker_pipe[0], POLLIN, on_wakeup, NULL) != SL_STATUS_OK) {
+    worker_stop(worker_count);
+    return SL_STATUS_FAIL;
+  }
+
+  // Signals are left to the main loop, so that they interrupt its wait.
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for (i = 0; i < worker_count && rc == 0; i++) {
+    rc = pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]);
+    workers[i].started = (rc == 0);
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (rc != 0) {
+    // Stop the threads that were started.
+    worker_stop(worker_count);
+    return SL_STATUS_FAIL;
+  }
+  app_log_info("Estimating the angles in %u workers." APP_LOG_NL, worker_count);
+  return SL_STATUS_OK;
+}
+
+sl_status_t worker_submit(conn_properties_t *tag,
+                          const aoa_iq_report_t *iq_report,
+                          enum sl_rtl_aox_mode mode,
+                          uint64_t timestamp)
+{
+  uint64_t key = 0;
+  uint32_t queued;
+  worker_t *worker;
+  worker_job_t *job;
+
+  // The worker is chosen by the tag address, so that a tag always goes to
+  // the same one.
+  for (uint8_t i = 0; i < ADR_LEN; i++) {
+    key |= (uint64_t)tag->address.addr[i] << (8 * i);
+  }
+  worker = &workers[((key * 0x9e3779b97f4a7c15ULL) >> 32) % worker_count];
+
+  queued = worker->head - worker->tail;
+  if (queued == WORKER_QUEUE_LEN) {
+    worker->stats.dropped++;
+    return SL_STATUS_FULL;
+  }
+  job = &worker->jobs[worker->head & WORKER_QUEUE_MASK];
+  job->tag = tag;
+  job->iq_report = *iq_report;
+  memcpy(job->samples, iq_report->samples, iq_report->length);
+  job->iq_report.samples = job->samples;
+  job->timestamp = timestamp;
+  job->mode = mode;
+  if (queued + 1 > worker->stats.max_queued) {
+    worker->stats.max_queued = queued + 1;
+  }
+
+  __atomic_store_n(&worker->head, worker->head + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&worker->sleeping, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&worker->mutex);
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->mutex);
+  }
+  return SL_STATUS_OK;
+}
+
+uint32_t worker_get_backlog(void)
+{
+  uint32_t queued = 0;
+
+  for (uint32_t i = 0; i < worker_count; i++) {
+    if (workers[i].head - workers[i].tail > queued) {
+      queued = workers[i].head - workers[i].tail;
+    }
+  }
+  return queued * 100 / WORKER_QUEUE_LEN;
+}
+
+void worker_deinit(void)
+{
+  if (worker_count == 0) {
+    return;
+  }
+  // The workers finish their queues before they stop.
+  worker_stop(worker_count);
+  app_log_info("Workers stopped." APP_LOG_NL);
+}
+
+sl_status_t worker_get_stats(uint32_t worker, worker_stats_t *stats)
+{
+  if (worker >= worker_count) {
+    return SL_STATUS_INVALID_INDEX;
+  }
+  *stats = workers[worker].stats;
+  return SL_STATUS_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Static Function Definitions
+
+static void *worker_thread(void *arg)
+{
+  worker_t *worker = (worker_t *)arg;
+  uint32_t done = worker->done;
+  uint32_t head;
+  bool stop = false;
+  worker_job_t *job;
+  uint64_t start;
+  uint8_t byte = 0;
+
+  while (true) {
+    head = __atomic_load_n(&worker->head, __ATOMIC_ACQUIRE);
+    if (done == head) {
+      if (stop) {
+        break;
+      }
+      pthread_mutex_lock(&worker->mutex);
+      __atomic_store_n(&worker->sleeping, true, __ATOMIC_SEQ_CST);
+      while (__atomic_load_n(&worker->head, __ATOMIC_SEQ_CST) == done
+             && !worker->stop) {
+        pthread_cond_wait(&worker->cond, &worker->mutex);
+      }
+      __atomic_store_n(&worker->sleeping, false, __ATOMIC_RELAXED);
+      stop = worker->stop;
+      pthread_mutex_unlock(&worker->mutex);
+      continue;
+    }
+
+    job = &worker->jobs[done & WORKER_QUEUE_MASK];
+    start = aoa_time_us();
+    job->ec = aoa_set_mode(&job->tag->aoa_state, job->mode);
+    if (job->ec == SL_RTL_ERROR_SUCCESS) {
+      job->ec = aoa_calculate(&job->tag->aoa_state, &job->iq_report, &job->angle);
+    }
+    job->estimate_us = (uint32_t)(aoa_time_us() - start);
+    done++;
+    __atomic_store_n(&worker->done, done, __ATOMIC_RELEASE);
+    if (!__atomic_exchange_n(&worker_signaled, true, __ATOMIC_SEQ_CST)) {
+      // The flag only saves writes, so the pipe holds a few bytes at most
+      // and the write does not block.
+      (void)write(worker_pipe[1], &byte, sizeof(byte));
+    }
+  }
+  aoa_free_buffers();
+  return NULL;
+}
+
+// Hand the estimates over to the handler, in order for every worker.
+static void worker_collect(void)
+{
+  uint32_t done;
+
+  for (uint32_t i = 0; i < worker_count; i++) {
+    worker_t *worker = &workers[i];
+    done = __atomic_load_n(&worker->done, __ATOMIC_ACQUIRE);
+    while (worker->tail != done) {
+      worker_handler(&worker->jobs[worker->tail & WORKER_QUEUE_MASK]);
+      worker->stats.reports++;
+      worker->tail++;
+    }
+  }
+}
+
+static void on_wakeup(int fd, short revents, void *ctx)
+{
+  uint8_t bytes[16];
+
+  (void)revents;
+  (void)ctx;
+  // Clear the signal first, estimates finished from now on signal again.
+  // A worker sets the flag before it writes, so its byte may arrive after
+  // the flag was cleared. Drain the pipe whatever the flag says, a byte left
+  // in it would keep the fd readable.
+  __atomic_store_n(&worker_signaled, false, __ATOMIC_SEQ_CST);
+  while (read(fd, bytes, sizeof(bytes)) > 0) {
+  }
+  worker_collect();
+}
+
+// Stop the first count workers and release the pool. The statistics are
+// kept.
+static void worker_stop(uint32_t count)
+{
+  uint32_t i;
+
+  for (i = 0; i < count; i++) {
+    if (!workers[i].started) {
+      continue;
+    }
+    pthread_mutex_lock(&workers[i].mutex);
+    workers[i].stop = true;
+    pthread_cond_signal(&workers[i].cond);
+    pthread_mutex_unlock(&workers[i].mutex);
+    pthread_join(workers[i].thread, NULL);
+    workers[i].started = false;
+  }
+  // Hand over the last estimates.
+  if (worker_handler != NULL && worker_pipe[0] != -1) {
+    worker_collect();
+  }
+  if (worker_pipe[0] != -1) {
+    app_poll_remove(worker_pipe[0]);
+    close(worker_pipe[0]);
+    close(worker_pipe[1]);
+    worker_pipe[0] = -1;
+    worker_pipe[1] = -1;
+  }
+  for (i = 0; i < count; i++) {
+    free(workers[i].jobs);
+    workers[i].jobs = NULL;
+  }
+}
+#else // defined(POSIX) && POSIX == 1
+sl_status_t worker_init(worker_handler_t handler)
+{
+  (void)handler;
+  return SL_STATUS_OK;
+}
+
+sl_status_t worker_submit(conn_properties_t *tag,
+                          const aoa_iq_report_t *iq_report,
+                          enum sl_rtl_aox_mode mode,
+                          uint64_t timestamp)
+{
+  (void)tag;
+  (void)iq_report;
+  (void)mode;
+  (void)timestamp;
+  return SL_STATUS_NOT_SUPPORTED;
+}
+
+uint32_t worker_get_backlog(void)
+{
+  return 0;
+}
+
+void worker_deinit(void)
+{
+}
+
+sl_status_t worker_get_stats(uint32_t worker, worker_stats_t *stats)
+{
+  (void)worker;
+  (void)stats;
+  return SL_STATUS_INVALID_INDEX;
+}
+#endif // defined(POSIX) && POSIX == 1
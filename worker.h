@@ -0,0 +1,169 @@
+/***************************************************************************//**
+ * @file
+ * @brief Angle estimation worker pool header file
+ *
+ * With -W, the angles are estimated by worker threads instead of the NCP
+ * event handler. Every IQ report is copied into the queue of the worker that
+ * owns its tag, chosen by a hash of the tag address. A tag is then always
+ * estimated by the same thread, in the order of its reports, and its
+ * aoa_state_t is never shared. The estimates come back to the main loop in
+ * the same queue slots, which hands them to the output stage, so the rate
+ * limiting, the formatting and the sinks stay single threaded.
+ *
+ * The queues are single producer, single consumer rings. The main loop is
+ * woken up through a pipe watched by app_poll, like for the NCP receive
+ * threads. A report that finds the queue of its worker full is dropped.
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * SPDX-License-Identifier: Zlib
+ *
+ * The licensor of this software is Silicon Laboratories Inc.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ ******************************************************************************/
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aoa_types.h"
+#include "conn.h"
+#include "sl_rtl_clib_api.h"
+#include "sl_status.h"
+
+// Optstring argument for getopt.
+#define WORKER_OPTSTRING "W:"
+
+// Usage info.
+#define WORKER_USAGE "[-W <workers>] "
+
+// Options info.
+#define WORKER_OPTIONS                                                                             \
+  "    -W  Number of threads estimating the angles, each owns a share of the tags.\n"              \
+  "        <workers>        0: estimate in the main loop (default), at most 16\n"
+
+// Maximum number of workers.
+#define WORKER_MAX            16
+
+// Number of IQ reports that can wait for a worker, a power of two.
+#define WORKER_QUEUE_LEN      256
+
+// IQ report handed over to a worker and its estimate.
+typedef struct {
+  conn_properties_t *tag;
+  aoa_iq_report_t iq_report;            // The samples point to the copy below
+  int8_t samples[UINT8_MAX];
+  uint64_t timestamp;                   // Time of reception
+  enum sl_rtl_aox_mode mode;            // Estimator mode for the report
+  aoa_angle_t angle;                    // Estimate
+  enum sl_rtl_error_code ec;            // Result of the estimation
+  uint32_t estimate_us;                 // Time spent in the estimator
+} worker_job_t;
+
+/**************************************************************************//**
+ * Estimate handler, called by the main loop for every job in the order of
+ * the reports of the tag.
+ *
+ * @param[in] job Job with its estimate.
+ *****************************************************************************/
+typedef void (*worker_handler_t)(worker_job_t *job);
+
+typedef struct {
+  uint64_t reports;         // Reports estimated
+  uint32_t dropped;         // Reports dropped with the queue full
+  uint32_t max_queued;      // Most reports waiting for the worker
+  uint32_t depth;           // Queue depth
+} worker_stats_t;
+
+/**************************************************************************//**
+ * Set worker pool options.
+ *
+ * @param[in] option Option to set.
+ * @param[in] value Value of the option.
+ *
+ * @retval SL_STATUS_OK Option set successfully.
+ * @retval SL_STATUS_NOT_FOUND Unknown option.
+ * @retval SL_STATUS_INVALID_PARAMETER Invalid value.
+ * @retval SL_STATUS_NOT_SUPPORTED Workers are not supported on the platform.
+ *****************************************************************************/
+sl_status_t worker_set_option(char option, char *value);
+
+/**************************************************************************//**
+ * Start the workers set with -W. Without workers, nothing is started.
+ *
+ * @param[in] handler Estimate handler.
+ *
+ * @retval SL_STATUS_OK Workers started, or none configured.
+ * @retval SL_STATUS_ALLOCATION_FAILED Out of memory.
+ * @retval SL_STATUS_FAIL The threads or the wakeup pipe failed.
+ *****************************************************************************/
+sl_status_t worker_init(worker_handler_t handler);
+
+/**************************************************************************//**
+ * Get the number of running workers.
+ *
+ * @return 0 if the angles are estimated in the main loop.
+ *****************************************************************************/
+uint32_t worker_get_count(void);
+
+/**************************************************************************//**
+ * Queue an IQ report for the worker of its tag. The samples are copied.
+ *
+ * @param[in] tag Tag of the report.
+ * @param[in] iq_report IQ report.
+ * @param[in] mode Estimator mode, the estimator of the tag is switched to it.
+ * @param[in] timestamp Time of reception.
+ *
+ * @retval SL_STATUS_OK Report queued.
+ * @retval SL_STATUS_FULL Queue full, the report is dropped.
+ *****************************************************************************/
+sl_status_t worker_submit(conn_properties_t *tag,
+                          const aoa_iq_report_t *iq_report,
+                          enum sl_rtl_aox_mode mode,
+                          uint64_t timestamp);
+
+/**************************************************************************//**
+ * Get the fill of the fullest queue, counting the estimates not handed over
+ * yet.
+ *
+ * @return Percent of the queue length.
+ *****************************************************************************/
+uint32_t worker_get_backlog(void);
+
+/**************************************************************************//**
+ * Wait for the queued reports to be estimated, hand the estimates to the
+ * handler and stop the workers.
+ *****************************************************************************/
+void worker_deinit(void);
+
+/**************************************************************************//**
+ * Get the statistics of a worker.
+ *
+ * @param[in] worker Worker index, below worker_get_count().
+ * @param[out] stats Statistics since the start of the application.
+ *
+ * @retval SL_STATUS_OK Statistics returned.
+ * @retval SL_STATUS_INVALID_INDEX No such worker.
+ *****************************************************************************/
+sl_status_t worker_get_stats(uint32_t worker, worker_stats_t *stats);
+
+#endif // WORKER_H